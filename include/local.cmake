@@ -9,4 +9,15 @@
 set(
     INCLUDE_H
     include/moderndbs/algebra.h
+    include/moderndbs/execution.h
+    include/moderndbs/german_string.h
+    include/moderndbs/hash.h
+    include/moderndbs/logical_plan.h
+    include/moderndbs/plan_cache.h
+    include/moderndbs/planner.h
+    include/moderndbs/result_cache.h
+    include/moderndbs/sample.h
+    include/moderndbs/sketch.h
+    include/moderndbs/statistics.h
+    include/moderndbs/table.h
 )
@@ -1,26 +1,46 @@
 #ifndef INCLUDE_MODERNDBS_ALGEBRA_H
 #define INCLUDE_MODERNDBS_ALGEBRA_H
 
+#include <atomic>
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
+#include <istream>
+#include <memory>
 #include <ostream>
+#include <stdexcept>
 #include <string>
 #include <vector>
 #include <experimental/optional>
+#include "moderndbs/german_string.h"
 
 
 namespace moderndbs {
 namespace iterator_model {
 
 class Register {
+public:
+    /// The value types. INT32 and DATE take 4 bytes in compact storage, the
+    /// others 8 bytes; CHAR16 are fixed size strings of 16 characters and
+    /// VARCHAR variable-length `GermanString`s.
+    enum class Type { INT64, CHAR16, INT32, DOUBLE, DATE, DECIMAL, VARCHAR };
+
+    /// The number of fractional digits of DECIMAL values.
+    static constexpr int decimal_digits = 2;
+
 private:
-    std::experimental::optional<int64_t> intValue;
-    std::experimental::optional<std::string> stringValue;
+    Type type = Type::CHAR16;
+    /// The value of INT64, INT32, DATE and DECIMAL registers, of DOUBLE
+    /// registers or of VARCHAR registers.
+    union {
+        int64_t intValue;
+        double doubleValue;
+        GermanString varcharValue;
+    };
+    std::string stringValue;
 
 public:
-    enum class Type { INT64, CHAR16 };
-
-    Register() = default;
+    Register() : intValue(0) {}
     Register(const Register&) = default;
     Register(Register&&) = default;
 
@@ -30,25 +50,70 @@ public:
     /// Creates a `Register` from a given `int64_t`.
     static Register from_int(int64_t value);
 
+    /// Creates an INT32 `Register`.
+    static Register from_int32(int32_t value);
+
+    /// Creates a DOUBLE `Register`.
+    static Register from_double(double value);
+
+    /// Creates a DATE `Register` from the number of days since 1970-01-01.
+    static Register from_date(int32_t days);
+
+    /// Creates a DECIMAL `Register` from its value multiplied by
+    /// 10^`decimal_digits`, i.e. `from_decimal(1234)` is 12.34.
+    static Register from_decimal(int64_t unscaled_value);
+
+    /// Creates a register of a numeric type from the integer that `as_int()`
+    /// returns for it.
+    static Register from_integer(Type type, int64_t value);
+
     /// Creates a `Register` from a given `std::string`. The register must only
     /// be able to hold fixed size strings of size 16, so `value` must be at
     /// least 16 characters long.
     static Register from_string(const std::string& value);
 
+    /// Creates a VARCHAR `Register`. The characters of long strings are not
+    /// copied and must outlive the register.
+    static Register from_varchar(const GermanString& value);
+
+    /// Creates a VARCHAR `Register` whose characters are kept in `arena`.
+    static Register from_varchar(const std::string& value, StringArena& arena);
+
     /// Returns the type of the register.
     Type get_type() const;
 
-    /// Returns the `int64_t` value for this register. Must only be called when
-    /// this register really is an integer.
+    /// Returns the integer value of INT64 and INT32 registers, the days since
+    /// 1970-01-01 of DATE registers, the unscaled value of DECIMAL registers
+    /// and the truncated value of DOUBLE registers. Must only be called when
+    /// this register really is numeric.
     int64_t as_int() const;
 
+    /// Returns the value of a numeric register as a `double`.
+    double as_double() const;
+
     /// Returns the `std::string` value for this register. Must only be called
     /// when this register really is a string.
     std::string as_string() const;
 
-    /// Returns the hash value for this register.
+    /// Returns the value of a VARCHAR register.
+    GermanString as_varchar() const;
+
+    /// Returns the value formatted for output. Dates are written as
+    /// YYYY-MM-DD, decimals with `decimal_digits` fractional digits.
+    std::string to_string() const;
+
+    /// Formats a register of type `type` like `to_string()` without looking
+    /// at its type.
+    static std::string to_string(const Register& reg, Type type);
+
+    /// Returns the hash value for this register, see `hash_int()` and
+    /// `hash_bytes()`.
     uint64_t get_hash() const;
 
+    /// Returns the hash value of a register of type `type` without looking at
+    /// its type. Equals `reg.get_hash()`.
+    static uint64_t hash(const Register& reg, Type type);
+
     /// Compares two register for equality.
     friend bool operator==(const Register& r1, const Register& r2);
 
@@ -70,13 +135,154 @@ public:
     /// Compares two registers for `>=`. Must only be called when `r1` and `r2`
     /// have the same type.
     friend bool operator>=(const Register& r1, const Register& r2);
+
+    /// Compares two registers that both have type `type` without looking at
+    /// their types. Returns a negative value, zero, or a positive value when
+    /// `r1` is less than, equal to, or greater than `r2`.
+    static int compare(const Register& r1, const Register& r2, Type type);
+
+    /// Compares two registers that both have type `type` for equality without
+    /// looking at their types.
+    static bool equals(const Register& r1, const Register& r2, Type type);
+
+    /// Returns the number of bytes that `write_key()` writes for registers of
+    /// type `type`: 8 for INT64, INT32, DATE and DECIMAL, 16 for CHAR16 and
+    /// zero for the types without a fixed-width key.
+    static size_t get_key_size(Type type);
+
+    /// Writes the `get_key_size(type)` bytes of the binary key of a register
+    /// of type `type` to `key` without looking at its type. CHAR16 values are
+    /// padded with zeros, so registers are equal when their keys and their
+    /// lengths are. Returns the number of characters of CHAR16 values, which
+    /// are not written when there are more than 16 of them, and zero for the
+    /// other types.
+    static size_t write_key(const Register& reg, Type type, char* key);
+};
+
+
+/// The types of the attributes of the tuples of an operator.
+using Schema = std::vector<Register::Type>;
+
+
+/// Returns the hash value of the attributes `attrs` of `tuple`: the hash value
+/// of the first attribute, combined with those of the others by
+/// `combine_hashes()`. A single attribute hashes like its register. `types`
+/// are the types of the attributes, empty when they are unknown.
+uint64_t hash_attributes(
+    const std::vector<Register>& tuple,
+    const std::vector<size_t>& attrs,
+    const Schema& types = {}
+);
+
+
+/// Converts the integer or string constant `value` to `type` for comparisons
+/// with attributes of that type. The characters of a long VARCHAR constant are
+/// kept in `strings`. Throws `std::invalid_argument` when the constant cannot
+/// be compared with such attributes.
+Register coerce_constant(const Register& value, Register::Type type, StringArena& strings);
+
+
+/// Thrown by operators that notice that their query was cancelled or that
+/// its deadline has passed.
+class QueryInterrupted
+: public std::runtime_error {
+public:
+    explicit QueryInterrupted(const std::string& what) : std::runtime_error(what) {}
+};
+
+
+/// Cooperative cancellation flag and deadline of a query. The token may be
+/// cancelled from any thread; operators poll it in their materializing loops.
+class CancellationToken {
+private:
+    std::atomic<bool> cancelled{false};
+    /// The deadline in ticks of `std::chrono::steady_clock`, zero if there is
+    /// none.
+    std::atomic<std::chrono::steady_clock::rep> deadline{0};
+
+public:
+    /// Requests the cancellation of the query.
+    void cancel();
+
+    /// Sets the point in time after which the query is interrupted.
+    void set_deadline(std::chrono::steady_clock::time_point deadline);
+
+    /// Sets the deadline to `timeout` from now.
+    void set_timeout(std::chrono::steady_clock::duration timeout);
+
+    /// Was the query cancelled?
+    bool is_cancelled() const;
+
+    /// Has the deadline passed?
+    bool is_expired() const;
+
+    /// Throws `QueryInterrupted` when the query was cancelled or its deadline
+    /// has passed.
+    void check() const;
 };
 
 
 class Operator {
+protected:
+    /// Number of tuples an operator processes between two looks at its
+    /// cancellation token.
+    static constexpr size_t check_interval = 1024;
+
+    const CancellationToken* token = nullptr;
+    size_t tuples_since_check = 0;
+    /// The types of the output attributes, set by `open()`. Empty when the
+    /// types are unknown.
+    Schema schema;
+    /// The output attributes whose hash value is carried along with every
+    /// tuple, set by `open()`. Empty when the operator carries no hash.
+    std::vector<size_t> hash_attrs;
+    /// The `hash_attributes()` of the `hash_attrs` of the current tuple.
+    uint64_t output_hash = 0;
+
+    /// Must be called once per tuple in materializing loops. Every
+    /// `check_interval` calls this throws `QueryInterrupted` when the query
+    /// was cancelled or timed out.
+    void check_interrupted() {
+        if (++this->tuples_since_check == check_interval) {
+            this->tuples_since_check = 0;
+            if (this->token != nullptr) {
+                this->token->check();
+            }
+        }
+    }
+
 public:
     virtual ~Operator() = default;
 
+    /// Attaches a cancellation token to this operator and all of its inputs.
+    /// Interrupted operators release their materialized state in `close()`.
+    virtual void set_cancellation_token(const CancellationToken* token) {
+        this->token = token;
+    }
+
+    /// Returns the types of the output attributes. Only valid after `open()`.
+    /// Operators select type-specialized code paths from the schemas of their
+    /// inputs; an empty schema means that the types are unknown and have to be
+    /// checked per value.
+    const Schema& get_schema() const {
+        return this->schema;
+    }
+
+    /// Returns the output attributes whose hash value `get_output_hash()`
+    /// returns. Only valid after `open()`. Hash operators carry the hash values
+    /// of their keys with their output, so an operator that is keyed on the
+    /// same attributes does not hash them again.
+    const std::vector<size_t>& get_hash_attrs() const {
+        return this->hash_attrs;
+    }
+
+    /// Returns the `hash_attributes()` of the `get_hash_attrs()` of the
+    /// current tuple. Only valid when `next()` returned true and the hash
+    /// attributes are not empty.
+    uint64_t get_output_hash() const {
+        return this->output_hash;
+    }
+
     /// Initializes the operator.
     virtual void open() = 0;
 
@@ -104,6 +310,11 @@ public:
     explicit UnaryOperator(Operator& input) : input(&input) {}
 
     ~UnaryOperator() override = default;
+
+    void set_cancellation_token(const CancellationToken* token) override {
+        this->token = token;
+        this->input->set_cancellation_token(token);
+    }
 };
 
 
@@ -118,6 +329,12 @@ public:
     : input_left(&input_left), input_right(&input_right) {}
 
     ~BinaryOperator() override = default;
+
+    void set_cancellation_token(const CancellationToken* token) override {
+        this->token = token;
+        this->input_left->set_cancellation_token(token);
+        this->input_right->set_cancellation_token(token);
+    }
 };
 
 
@@ -141,7 +358,9 @@ public:
 };
 
 
-/// Generates tuples from the input with only a subset of their attributes.
+/// Generates tuples from the input with only a subset of their attributes. The
+/// hash value carried by the input is passed on when all of its attributes are
+/// kept.
 class Projection
 : public UnaryOperator {
 private:
@@ -159,11 +378,61 @@ public:
 };
 
 
-/// Filters tuples with the given predicate.
+/// Generates at most `limit` tuples of the input after skipping the first
+/// `offset` ones. Once the limit is reached, no further tuples are pulled and
+/// the input is closed right away, so that it releases its resources before
+/// the `Limit` itself is closed.
+class Limit
+: public UnaryOperator {
+private:
+    size_t limit;
+    size_t offset;
+    size_t skipped_count = 0;
+    size_t produced_count = 0;
+    bool input_open = false;
+public:
+    Limit(Operator& input, size_t limit, size_t offset = 0);
+
+    ~Limit() override;
+
+    void open() override;
+    bool next() override;
+    void close() override;
+    std::vector<Register*> get_output() override;
+};
+
+
+/// Filters tuples with the given predicate. The hash value carried by the input
+/// is passed on.
+///
+/// The input is filtered in batches of `batch_size` tuples: the predicate is
+/// evaluated for the whole batch, and the indexes of the matching tuples are
+/// collected in a selection vector, see `Mode`.
 class Select
 : public UnaryOperator {
 public:
-    enum class PrecidateAttribute { INT, CHAR, ATTRIBUTE };
+    enum class PrecidateAttribute { INT, CHAR, VALUE, ATTRIBUTE };
+
+    /// How the selection vector of a batch is written.
+    enum class Mode {
+        /// BRANCHING or PREDICATED, depending on the fraction of tuples the
+        /// previous batch selected.
+        ADAPTIVE,
+        /// Only matching tuples are written, behind a branch on the outcome
+        /// of the predicate. Cheap when the outcome is predictable, i.e. when
+        /// few or most tuples match.
+        BRANCHING,
+        /// Every tuple is written and the selection vector only advances on
+        /// a match, so there is no branch that can be mispredicted.
+        PREDICATED
+    };
+
+    /// The number of input tuples that are filtered at once.
+    static constexpr size_t batch_size = 1024;
+    /// ADAPTIVE predicates batches after batches that selected a fraction of
+    /// the tuples in this range.
+    static constexpr double min_predicated_selectivity = 0.1;
+    static constexpr double max_predicated_selectivity = 0.9;
 
     enum class PredicateType {
         EQ, // a == b
@@ -193,6 +462,16 @@ public:
         PredicateType predicate_type;
     };
 
+    /// Predicate of the form:
+    /// tuple[attr_index] P constant
+    /// where P is given by `predicate_type` and `constant` has the type of the
+    /// attribute, e.g. INT32, DOUBLE, DATE or DECIMAL.
+    struct PredicateAttributeValue {
+        size_t attr_index;
+        Register constant;
+        PredicateType predicate_type;
+    };
+
     /// tuple[attr_left_index] P tuple[attr_right_index]
     /// where P is given by `predicate_type`.
     struct PredicateAttributeAttribute {
@@ -204,16 +483,77 @@ public:
 private:
     PredicateAttributeInt64 intPredicate;
     PredicateAttributeChar16 charPredicate;
+    PredicateAttributeValue valuePredicate;
     PredicateAttributeAttribute attributePredicate;
     PrecidateAttribute predicateAttribute;
-    std::vector<Register> output_regs;
+    /// The constant of an INT, CHAR or VALUE predicate. `open()` converts it
+    /// to the type of the attribute.
+    Register constant;
+    /// Owns the characters of a constant converted to VARCHAR.
+    StringArena strings;
+    /// Do both sides of the predicate have the same type according to the
+    /// schema of the input? Then `open()` resolves the predicate to the
+    /// members below and values are compared without checking their types.
+    bool is_typed = false;
+    Register::Type compare_type = Register::Type::INT64;
+    PredicateType predicate_type = PredicateType::EQ;
+    size_t left_index = 0;
+    /// The right attribute of an ATTRIBUTE predicate. The other predicates
+    /// compare with `constant`.
+    size_t right_index = 0;
+    Mode mode = Mode::ADAPTIVE;
+    /// The tuples of the current batch, one after another, and the hash
+    /// values carried by the input.
+    std::vector<Register> batch;
+    std::vector<uint64_t> batch_hashes;
+    size_t arity = 0;
+    /// The outcome of the predicate for the tuples of the batch.
+    std::vector<uint8_t> matches;
+    /// The indexes of the matching tuples of the batch.
+    std::vector<uint32_t> selection;
+    size_t selected_count = 0;
+    size_t selected_index = 0;
+    /// The tuple of the batch that is the current output.
+    size_t output_index = 0;
+    /// The fraction of tuples the previous batch selected.
+    double selectivity = 0;
+    size_t batch_count = 0;
+    size_t predicated_count = 0;
+
+    /// Filters the next batch of input tuples. Returns false when the input
+    /// is exhausted.
+    bool filter_batch();
+
 public:
     Select(Operator& input, PredicateAttributeInt64 predicate);
     Select(Operator& input, PredicateAttributeChar16 predicate);
+    Select(Operator& input, PredicateAttributeValue predicate);
     Select(Operator& input, PredicateAttributeAttribute predicate);
 
     ~Select() override;
 
+    /// Replaces the constant of an INT, CHAR or VALUE predicate. `constant` must have
+    /// the type of the predicate. Must not be called while the operator is
+    /// open.
+    void set_constant(const Register& constant);
+
+    /// Sets how selection vectors are written. Must not be called while the
+    /// operator is open.
+    void set_mode(Mode mode) {
+        this->mode = mode;
+    }
+
+    /// Returns the number of batches since `open()`.
+    size_t get_batch_count() const {
+        return this->batch_count;
+    }
+
+    /// Returns the number of batches since `open()` whose selection vector
+    /// was written without branches.
+    size_t get_predicated_count() const {
+        return this->predicated_count;
+    }
+
     void open() override;
     bool next() override;
     void close() override;
@@ -253,27 +593,248 @@ public:
 };
 
 
-/// Computes the inner equi-join of the two inputs on one attribute.
+/// Computes window functions. The input is partitioned by the partition
+/// attributes and every partition is ordered by the order criteria. The output
+/// tuples consist of the input attributes followed by one attribute per window
+/// function and are ordered by partition and order criteria. Every partition is
+/// processed in a single pass; partitions are distributed over `thread_count`
+/// threads.
+class Window
+: public UnaryOperator {
+public:
+    /// The rows of a partition over which an aggregate is computed, relative
+    /// to the current row.
+    struct Frame {
+        /// Does the frame start at the first row of the partition?
+        bool unbounded_preceding = true;
+        /// The number of rows before the current row when the start is
+        /// bounded.
+        size_t preceding = 0;
+        /// Does the frame end at the last row of the partition?
+        bool unbounded_following = false;
+        /// The number of rows after the current row when the end is bounded.
+        size_t following = 0;
+
+        /// ROWS BETWEEN UNBOUNDED PRECEDING AND CURRENT ROW
+        static Frame running();
+        /// ROWS BETWEEN UNBOUNDED PRECEDING AND UNBOUNDED FOLLOWING
+        static Frame partition();
+        /// ROWS BETWEEN `preceding` PRECEDING AND `following` FOLLOWING
+        static Frame rows(size_t preceding, size_t following);
+    };
+
+    struct Function {
+        enum Kind { ROW_NUMBER, RANK, DENSE_RANK, LAG, LEAD, SUM, MIN, MAX, COUNT };
+
+        Kind kind;
+        /// The attribute of LAG, LEAD and the aggregates. For SUM the attribute
+        /// must be numeric; DOUBLE and DECIMAL sums keep their type, the other
+        /// types are summed as INT64.
+        size_t attr_index = 0;
+        /// The distance of the row that LAG and LEAD read.
+        size_t offset = 1;
+        /// The value of LAG and LEAD when that row is outside the partition.
+        Register default_value;
+        /// The frame of the aggregates.
+        Frame frame;
+
+        static Function row_number();
+        static Function rank();
+        static Function dense_rank();
+        static Function lag(size_t attr_index, size_t offset, Register default_value);
+        static Function lead(size_t attr_index, size_t offset, Register default_value);
+        static Function sum(size_t attr_index, Frame frame = Frame::running());
+        static Function min(size_t attr_index, Frame frame = Frame::running());
+        static Function max(size_t attr_index, Frame frame = Frame::running());
+        static Function count(Frame frame = Frame::running());
+    };
+
+private:
+    std::vector<size_t> partition_attrs;
+    std::vector<Sort::Criterion> order;
+    std::vector<Function> functions;
+    size_t thread_count;
+    /// The sorted input tuples extended by the values of the functions.
+    std::vector<std::vector<Register>> tuples;
+    std::vector<Register> output_regs;
+    bool isMaterialized = false;
+    size_t current_index = 0;
+
+    /// Computes the functions for the tuples in [begin, end).
+    void compute_partition(size_t begin, size_t end);
+
+public:
+    Window(
+        Operator& input,
+        std::vector<size_t> partition_attrs,
+        std::vector<Sort::Criterion> order,
+        std::vector<Function> functions,
+        size_t thread_count = 1
+    );
+
+    ~Window() override;
+
+    void open() override;
+    bool next() override;
+    void close() override;
+    std::vector<Register*> get_output() override;
+};
+
+
+class SpillFile;
+
+
+/// Computes the inner equi-join of the two inputs on one attribute. The left
+/// input is the build side. The right input is probed in groups of
+/// `probe_group_size` tuples: all bucket slots of a group are prefetched
+/// before the first chain is walked so that the cache misses of independent
+/// lookups overlap instead of stalling one after another. The output carries
+/// the hash value of the left join key.
+///
+/// The way the build side is indexed is chosen once it is materialized, see
+/// `Strategy`. When the build side exceeds the memory budget, both inputs are
+/// partitioned by their hash values into temporary files and the partitions
+/// are joined one after another.
 class HashJoin
 : public BinaryOperator {
+public:
+    /// The kind of the join. SEMI and ANTI only output the left tuples that
+    /// have (SEMI) or do not have (ANTI) a join partner in the right input,
+    /// each at most once.
+    enum class Type { INNER, SEMI, ANTI };
+
+    /// How the build side is indexed.
+    enum class Strategy {
+        /// The build side is so small that probes compare the hash values of
+        /// all build tuples, there is no hash directory.
+        SCAN,
+        /// A single hash directory with collision chains.
+        CHAINED,
+        /// The build tuples are partitioned by the high bits of their hash
+        /// values and each partition gets a directory of its own that fits
+        /// into the cache while it is built.
+        PARTITIONED
+    };
+
+    /// Number of probe tuples whose lookups are interleaved.
+    static constexpr size_t probe_group_size = 16;
+    /// The largest build side that is scanned.
+    static constexpr size_t max_scan_size = 16;
+    /// The largest build side with a single hash directory.
+    static constexpr size_t max_chained_size = 1U << 15U;
+    /// The number of build tuples per partition of a partitioned build side.
+    static constexpr size_t partition_size = 1U << 12U;
+    /// The number of bits of the hash values that select the partition of a
+    /// spilled tuple.
+    static constexpr size_t spill_bits = 4;
+
 private:
     size_t attr_index_left;
     size_t attr_index_right;
+    Type type;
+    Strategy strategy = Strategy::CHAINED;
+    /// The number of bytes the build side may take in memory, zero for no
+    /// limit.
+    size_t memory_budget = 0;
     bool isMaterialized = false;
+    /// Has the right input been probed completely? Only used by SEMI and
+    /// ANTI joins.
+    bool isProbed = false;
+    /// The materialized tuples of the build side.
+    std::vector<std::vector<Register>> build_tuples;
+    /// The hash values of the join keys of `build_tuples`.
+    std::vector<uint64_t> build_hashes;
+    /// The hash directory. Stores the index of the first build tuple of a
+    /// bucket plus one, zero marks an empty bucket.
+    std::vector<size_t> buckets;
+    /// The collision chains. `chain[i]` is the index of the next build tuple
+    /// in the bucket of build tuple `i` plus one.
+    std::vector<size_t> chain;
+    /// The shift that yields the partition of a hash value and the offsets of
+    /// the partition directories in `buckets`. Only used by PARTITIONED.
+    size_t partition_shift = 0;
+    std::vector<size_t> partition_offsets;
+    /// Did the build side exceed the memory budget?
+    bool spilled = false;
+    /// The spilled partitions of both inputs.
+    std::vector<std::unique_ptr<SpillFile>> spilled_build;
+    std::vector<std::unique_ptr<SpillFile>> spilled_probe;
+    /// The number of spilled partitions that were loaded, the last one is
+    /// being joined.
+    size_t spill_index = 0;
+    /// Owns the long strings of the spilled tuples.
+    StringArena spill_strings;
+    /// Marks the build tuples that found a join partner. Only used by SEMI
+    /// and ANTI joins.
+    std::vector<bool> matched;
+    /// Do the schemas of both inputs give the type of the join keys?
+    bool is_typed = false;
+    Register::Type key_type = Register::Type::INT64;
+    /// The tuples of the current probe group.
+    std::vector<std::vector<Register>> probe_tuples;
+    /// The joined tuples of the current probe group.
     std::vector<std::vector<Register>> registers;
-    int current_index = 0;
+    /// The hash values of the join keys of `registers`.
+    std::vector<uint64_t> register_hashes;
+    /// Do the inputs carry the hash values of their join keys?
+    bool reuse_left_hash = false;
+    bool reuse_right_hash = false;
+    size_t current_index = 0;
     std::vector<Register> output_regs;
 
+    /// Materializes the left input into the hash table.
+    void build();
+
+    /// Chooses the strategy for the materialized build tuples and indexes
+    /// them.
+    void index_build_side();
+
+    /// Returns the bucket of `hash` in `buckets`.
+    size_t get_bucket(uint64_t hash) const;
+
+    /// Writes the materialized build tuples to spilled partitions. Further
+    /// build tuples are spilled as they arrive.
+    void start_spilling();
+
+    /// Loads the next spilled partition of the build side. The right input
+    /// is spilled first. Returns false when all partitions are joined.
+    bool load_spilled_partition();
+
+    /// Joins a build and a probe tuple with equal hash values if their keys
+    /// are equal.
+    void join_tuples(size_t build_index, const std::vector<Register>& probe_tuple, uint64_t hash);
+
+    /// Probes the next group of right tuples, or of the spilled right tuples
+    /// of the current partition. Returns false when they are exhausted.
+    bool probe_group();
+
 public:
     HashJoin(
         Operator& input_left,
         Operator& input_right,
         size_t attr_index_left,
-        size_t attr_index_right
+        size_t attr_index_right,
+        Type type = Type::INNER
     );
 
     ~HashJoin() override;
 
+    /// Limits the number of bytes the materialized build side may take
+    /// before the join spills, zero for no limit.
+    void set_memory_budget(size_t bytes) {
+        this->memory_budget = bytes;
+    }
+
+    /// Returns how the current build side is indexed.
+    Strategy get_strategy() const {
+        return this->strategy;
+    }
+
+    /// Did the build side exceed the memory budget?
+    bool is_spilled() const {
+        return this->spilled;
+    }
+
     void open() override;
     bool next() override;
     void close() override;
@@ -281,38 +842,421 @@ public:
 };
 
 
-/// Groups and calculates (potentially multiple) aggregates on the input.
+class AggregationState;
+class ApproximateAggregate;
+
+
+/// Groups and calculates (potentially multiple) aggregates on the input. The
+/// output tuples consist of the group by attributes followed by one attribute
+/// per aggregate. Like `HashJoin`, input tuples are looked up in the group
+/// table in groups of `probe_group_size` with prefetched buckets. A single
+/// integer group key with a small range of values indexes an array of groups
+/// instead, see `AggregationState::set_key_range()`. The output carries the
+/// hash value of the group by attributes.
+///
+/// With more than one thread, the groups are partitioned by the high bits of
+/// their hash values. The input is pre-aggregated into the partitions as it
+/// is pulled, and the partitions are completed by `thread_count` threads.
+/// Pre-aggregation only pays off when many tuples fall into the same groups,
+/// so every `adaptation_interval` tuples the aggregation checks how many new
+/// groups they created. While that fraction is above `max_group_fraction`,
+/// tuples bypass the pre-aggregation and are only appended to their partition
+/// with their hash value; after `bypass_intervals` intervals the fraction is
+/// measured again.
 class HashAggregation
 : public UnaryOperator {
 public:
-    /// Represents an aggregation function. For MIN, MAX, and SUM `attr_index`
-    /// stands for the attribute which is being aggregated. For SUM the
-    /// attribute must be in an `INT64` register.
+    /// Represents an aggregation function. For all functions but COUNT
+    /// `attr_index` stands for the attribute which is being aggregated. For
+    /// SUM and APPROX_QUANTILE the attribute must be numeric. DOUBLE and
+    /// DECIMAL sums keep their type, the other types are summed as INT64.
+    ///
+    /// The APPROX_* functions are computed with mergeable sketches, see
+    /// `ApproximateAggregate`: APPROX_COUNT_DISTINCT estimates the number of
+    /// distinct values with a HyperLogLog sketch, APPROX_QUANTILE the
+    /// `parameter`-quantile with a KLL sketch, and APPROX_MOST_FREQUENT the
+    /// most frequent value with a Space-Saving sketch.
     struct AggrFunc {
-        enum Func { MIN, MAX, SUM, COUNT };
+        enum Func { MIN, MAX, SUM, COUNT, APPROX_COUNT_DISTINCT, APPROX_QUANTILE, APPROX_MOST_FREQUENT };
 
         Func func;
         size_t attr_index;
+        /// The quantile of APPROX_QUANTILE in [0, 1].
+        double parameter = 0;
+
+        /// Is the function computed with a sketch?
+        bool is_approximate() const {
+            return this->func >= APPROX_COUNT_DISTINCT;
+        }
     };
 
+    /// Number of input tuples whose lookups are interleaved.
+    static constexpr size_t probe_group_size = 16;
+    /// The number of hash bits that select the partition.
+    static constexpr size_t partition_bits = 6;
+    /// Number of tuples after which the pre-aggregation is reconsidered.
+    static constexpr size_t adaptation_interval = 4096;
+    /// The largest fraction of pre-aggregated tuples that may create new
+    /// groups before the pre-aggregation is bypassed.
+    static constexpr double max_group_fraction = 0.5;
+    /// Number of intervals that bypass the pre-aggregation before it is tried
+    /// again.
+    static constexpr size_t bypass_intervals = 4;
+
 private:
-    std::vector<size_t> group_by_attrs;
-    std::vector<AggrFunc> aggr_funcs;
     std::vector<Register> output_regs;
     bool isMaterialized = false;
-    int counter_index = 0;
-    int numberOfKeys = 0;
-    std::vector<std::vector<Register>> temp_sumcount_registers;
+    size_t counter_index = 0;
+    /// Does the input carry the hash value of the group by attributes?
+    bool reuse_hash = false;
+    std::unique_ptr<AggregationState> state;
+    size_t thread_count;
+    /// The groups of the partitions when aggregating with several threads.
+    std::vector<AggregationState> partitions;
+    /// The partition whose groups are generated.
+    size_t partition_index = 0;
+    /// The number of tuples that bypassed the pre-aggregation.
+    size_t bypassed_count = 0;
+
+    /// Aggregates the input into `state`.
+    void aggregate();
+
+    /// Aggregates the input into `partitions`.
+    void aggregate_partitioned();
 
 public:
     HashAggregation(
         Operator& input,
         std::vector<size_t> group_by_attrs,
-        std::vector<AggrFunc> aggr_funcs
+        std::vector<AggrFunc> aggr_funcs,
+        size_t thread_count = 1
     );
 
     ~HashAggregation() override;
 
+    /// See `AggregationState::set_key_range()`.
+    void set_key_range(int64_t min, int64_t max);
+
+    /// Returns the number of input tuples that bypassed the pre-aggregation.
+    size_t get_bypassed_count() const {
+        return this->bypassed_count;
+    }
+
+    void open() override;
+    bool next() override;
+    void close() override;
+    std::vector<Register*> get_output() override;
+};
+
+
+/// The group table of a hash aggregation. The state outlives the operators
+/// that feed it, so a materialized aggregation can be kept, saved and loaded,
+/// and maintained incrementally with delta inputs instead of being recomputed
+/// from the base data.
+class AggregationState {
+private:
+    std::vector<size_t> group_by_attrs;
+    std::vector<HashAggregation::AggrFunc> aggr_funcs;
+    /// The groups. Each entry holds the group by attributes followed by the
+    /// current aggregate values.
+    std::vector<std::vector<Register>> groups;
+    /// The number of input tuples of every group. Groups whose tuples were
+    /// all removed stay in the table with a count of zero.
+    std::vector<int64_t> tuple_counts;
+    /// The hash values of the group keys.
+    std::vector<uint64_t> group_hashes;
+    /// The hash directory, see `HashJoin::buckets`.
+    std::vector<size_t> buckets;
+    /// The collision chains, see `HashJoin::chain`.
+    std::vector<size_t> chain;
+    /// The types of the group keys, empty when they are unknown.
+    Schema key_types;
+    /// The schema of the input tuples, empty when it is unknown.
+    Schema input_schema;
+    /// The sketches of the approximate aggregates, `aggr_funcs.size()` entries
+    /// per group of which only those of approximate aggregates are set. The
+    /// aggregate values in `groups` are updated from them by `finalize()`.
+    std::vector<std::unique_ptr<ApproximateAggregate>> sketches;
+    /// The characters of the long VARCHAR values of the groups, so that the
+    /// state does not point into the storage of its inputs.
+    StringArena strings;
+
+    /// How the groups of inserted tuples are looked up. ARRAY indexes
+    /// `array_slots` with the value of a single integer group key instead of
+    /// hashing it. The hash directory is maintained in both cases, so that the
+    /// lookup can fall back to HASH when the keys turn out to be sparse.
+    enum class Lookup { UNDECIDED, ARRAY, HASH };
+    Lookup lookup = Lookup::UNDECIDED;
+    /// The index of the group of key `array_base + i` plus one at position
+    /// `i`, zero when there is no such group.
+    std::vector<size_t> array_slots;
+    int64_t array_base = 0;
+    /// The key range announced by `set_key_range()`.
+    bool has_key_range = false;
+    int64_t key_range_min = 0;
+    int64_t key_range_max = 0;
+
+    /// The number of 64 bit words of the normalized group keys, zero when the
+    /// keys are compared as registers. Keys of several attributes or of CHAR16
+    /// attributes with fixed-width types are packed into the `write_key()`
+    /// bytes of their attributes followed by a word with the lengths of the
+    /// CHAR16 values, if any. Groups are then found by comparing a few words.
+    size_t key_words = 0;
+    /// The normalized keys of the groups, `key_words` words per group.
+    std::vector<uint64_t> normalized_keys;
+    /// The normalized keys of the tuples that are inserted.
+    std::vector<uint64_t> probe_keys;
+
+    /// Returns the index of the group whose keys are the attributes
+    /// `key_attrs` of `tuple` plus one, or zero when there is none.
+    size_t find(const std::vector<Register>& tuple, const std::vector<size_t>& key_attrs, uint64_t hash) const;
+
+    /// Returns the index of the group of `tuple` plus one, or zero when there
+    /// is none.
+    size_t find(const std::vector<Register>& tuple, uint64_t hash) const;
+
+    /// Returns the index of the group with the normalized key `key` plus one,
+    /// or zero when there is none.
+    size_t find_normalized(const uint64_t* key, uint64_t hash) const;
+
+    /// Writes the normalized key of the attributes `key_attrs` of `tuple` to
+    /// `key`; `key_attrs` is nullptr when the keys are the first attributes,
+    /// as in groups. Returns false when a CHAR16 value is too long.
+    bool normalize_key(const std::vector<Register>& tuple, const std::vector<size_t>* key_attrs, uint64_t* key) const;
+
+    /// Returns the `hash_attributes()` of the key whose normalized key is
+    /// `key`.
+    uint64_t hash_normalized_key(const uint64_t* key) const;
+
+    /// Compares the group keys as registers from now on.
+    void disable_normalized_keys();
+
+    /// Copies the characters of a long VARCHAR value into `strings`.
+    void store_string(Register& value);
+
+    /// Appends a group and links it into the hash directory.
+    void append_group(std::vector<Register> group, int64_t tuple_count, uint64_t hash);
+
+    /// Adds a new group for `tuple` and returns its index.
+    size_t add_group(const std::vector<Register>& tuple, uint64_t hash);
+
+    /// Sets the aggregates of `group` to those of the single tuple `tuple`.
+    void initialize_aggregates(std::vector<Register>& group, const std::vector<Register>& tuple) const;
+
+    /// Updates the aggregates of group `index` with the tuple `tuple`.
+    void update_group(size_t index, const std::vector<Register>& tuple);
+
+    /// Rebuilds the hash directory with twice the number of buckets.
+    void grow();
+
+    /// Decides how groups are looked up, from the announced key range or the
+    /// keys of the first `count` tuples.
+    void choose_lookup(const std::vector<std::vector<Register>>& tuples, size_t count);
+
+    /// Returns the position of `key` in `array_slots`, which is at least
+    /// `array_slots.size()` when the key is not covered.
+    uint64_t get_array_offset(int64_t key) const {
+        return static_cast<uint64_t>(key) - static_cast<uint64_t>(this->array_base);
+    }
+
+    /// Rebuilds `array_slots` so that it covers the keys in [`low`, `high`]
+    /// and those of all groups. Falls back to HASH and returns false when
+    /// these are more than `max_array_range` keys.
+    bool cover_keys(int64_t low, int64_t high);
+
+    /// Aggregates the first `count` tuples with the ARRAY lookup. Returns
+    /// false without aggregating anything when it fell back to HASH.
+    bool insert_array(std::vector<std::vector<Register>>& tuples, size_t count);
+
+public:
+    /// The largest number of key values whose groups are looked up in an
+    /// array.
+    static constexpr uint64_t max_array_range = 1U << 16U;
+
+    AggregationState(std::vector<size_t> group_by_attrs, std::vector<HashAggregation::AggrFunc> aggr_funcs);
+
+    AggregationState(AggregationState&& other) noexcept;
+
+    AggregationState& operator=(AggregationState&& other) noexcept;
+
+    ~AggregationState();
+
+    /// Sets the schema of the tuples that are aggregated. With a schema, group
+    /// keys are compared without checking their types.
+    void set_input_schema(const Schema& schema);
+
+    /// Returns the schema of the groups, empty when the schema of the input is
+    /// unknown.
+    Schema get_schema() const;
+
+    /// Announces that the values of the single group key lie in [`min`, `max`],
+    /// e.g. from the statistics of the input. When the key is an integer and
+    /// the range has at most `max_array_range` values, groups are looked up in
+    /// an array from the first inserted tuple on. Without a range, the range
+    /// of the first tuples is used. Keys outside of the range are aggregated
+    /// correctly, but may make the lookup fall back to hashing.
+    void set_key_range(int64_t min, int64_t max);
+
+    /// Is the group of an inserted tuple looked up in an array?
+    bool is_array_lookup() const {
+        return this->lookup == Lookup::ARRAY;
+    }
+
+    /// Are the group keys compared in their normalized form?
+    bool has_normalized_keys() const {
+        return this->key_words != 0;
+    }
+
+    /// Returns an empty state with the same group by attributes, aggregates,
+    /// input schema and key range.
+    AggregationState create_empty() const;
+
+    /// Returns the group by attributes of the input tuples.
+    const std::vector<size_t>& get_group_by_attrs() const {
+        return this->group_by_attrs;
+    }
+
+    /// Removes all groups.
+    void clear();
+
+    /// Removes all groups and releases their memory.
+    void release();
+
+    /// Aggregates the first `count` tuples, at most
+    /// `HashAggregation::probe_group_size`. `hashes` are the hash values of
+    /// the group by attributes of the tuples, nullptr when they have to be
+    /// computed. The results of approximate aggregates are only updated by
+    /// `finalize()`.
+    void insert(std::vector<std::vector<Register>>& tuples, size_t count, const uint64_t* hashes = nullptr);
+
+    /// Computes the results of the approximate aggregates from their sketches.
+    void finalize();
+
+    /// Adds the groups of `other`, which must have the same group by
+    /// attributes and aggregates. States that were built on different threads
+    /// or partitions of the input are combined this way.
+    void merge(const AggregationState& other);
+
+    /// Removes a tuple that was aggregated before. Only supported when all
+    /// aggregates are invertible.
+    void remove(const std::vector<Register>& tuple);
+
+    /// Aggregates all tuples of `delta`.
+    void insert(Operator& delta);
+
+    /// Removes all tuples of `delta`, which must have been aggregated before.
+    /// Only supported when all aggregates are invertible.
+    void remove(Operator& delta);
+
+    /// Can tuples be removed, i.e. are all aggregates SUM or COUNT?
+    bool is_invertible() const;
+
+    /// Returns the number of groups including the empty ones.
+    size_t get_group_count() const;
+
+    /// Returns group `index`, nullptr when all its tuples were removed.
+    const std::vector<Register>* get_group(size_t index) const;
+
+    /// Returns the hash value of the group by attributes of group `index`.
+    uint64_t get_group_hash(size_t index) const;
+
+    /// Writes the state to `stream` in a binary format. States with
+    /// approximate aggregates cannot be saved.
+    void save(std::ostream& stream) const;
+
+    /// Reads a state written by `save()`.
+    static AggregationState load(std::istream& stream);
+};
+
+
+/// Generates the groups of an `AggregationState` like a `HashAggregation`.
+class AggregationStateScan
+: public Operator {
+private:
+    const AggregationState* state;
+    size_t current_index = 0;
+    std::vector<Register> output_regs;
+
+public:
+    explicit AggregationStateScan(const AggregationState& state);
+
+    ~AggregationStateScan() override;
+
+    void open() override;
+    bool next() override;
+    void close() override;
+    std::vector<Register*> get_output() override;
+};
+
+
+/// Computes `HashAggregation({attr_index_left}, aggr_funcs)` over
+/// `HashJoin(input_left, input_right, attr_index_left, attr_index_right)`
+/// without materializing the join result. The hash table holds one entry per
+/// distinct join key of the left input with the aggregates of its left tuples;
+/// the right tuples are aggregated into the entry of their key. The aggregate
+/// attributes refer to the join output, i.e. the left attributes followed by
+/// the right ones. Approximate aggregates are not supported. The output carries
+/// the hash value of the join key.
+class GroupJoin
+: public BinaryOperator {
+private:
+    size_t attr_index_left;
+    size_t attr_index_right;
+    std::vector<HashAggregation::AggrFunc> aggr_funcs;
+    /// The number of attributes of the left input.
+    size_t left_arity = 0;
+    bool isMaterialized = false;
+    /// The distinct join keys of the left input.
+    std::vector<Register> keys;
+    /// The hash values of `keys`.
+    std::vector<uint64_t> key_hashes;
+    /// The hash directory, see `HashJoin::buckets`.
+    std::vector<size_t> buckets;
+    /// The collision chains, see `HashJoin::chain`.
+    std::vector<size_t> chain;
+    /// The number of left and right tuples per key.
+    std::vector<int64_t> left_counts;
+    std::vector<int64_t> right_counts;
+    /// The aggregates of the left or the right tuples of every key,
+    /// `aggr_funcs.size()` entries per key. Entries of COUNT are unused.
+    std::vector<Register> aggregates;
+    /// Do the schemas of both inputs give the type of the join keys?
+    bool is_typed = false;
+    Register::Type key_type = Register::Type::INT64;
+    /// Do the inputs carry the hash values of their join keys?
+    bool reuse_left_hash = false;
+    bool reuse_right_hash = false;
+    size_t current_index = 0;
+    std::vector<Register> output_regs;
+
+    /// Returns the index of the entry of `key` plus one, or zero when there is
+    /// none.
+    size_t find(const Register& key, uint64_t hash) const;
+
+    /// Does aggregate `a` aggregate an attribute of the left input?
+    bool is_left_aggregate(size_t a) const;
+
+    /// Adds `value` to the aggregate at `slot`. `first` marks the first value
+    /// of the slot.
+    void update(size_t a, Register& slot, const Register& value, bool first) const;
+
+    /// Materializes the left input into the hash table.
+    void build();
+
+    /// Aggregates the right input into the hash table.
+    void probe();
+
+public:
+    GroupJoin(
+        Operator& input_left,
+        Operator& input_right,
+        size_t attr_index_left,
+        size_t attr_index_right,
+        std::vector<HashAggregation::AggrFunc> aggr_funcs
+    );
+
+    ~GroupJoin() override;
+
     void open() override;
     bool next() override;
     void close() override;
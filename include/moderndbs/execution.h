@@ -0,0 +1,143 @@
+#ifndef INCLUDE_MODERNDBS_EXECUTION_H
+#define INCLUDE_MODERNDBS_EXECUTION_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "moderndbs/algebra.h"
+
+
+namespace moderndbs {
+namespace iterator_model {
+
+/// A batch of result tuples.
+using Batch = std::vector<std::vector<Register>>;
+
+
+class Scheduler;
+
+
+/// A query that was submitted to a `Scheduler`. The query advances in steps
+/// on the worker threads of the scheduler; every step pulls one batch from the
+/// root operator. Finished batches are buffered in the query until they are
+/// fetched by the caller. When `max_pending_batches` batches are buffered, the
+/// query is suspended until the caller fetches one of them.
+class Query
+: public std::enable_shared_from_this<Query> {
+    friend class Scheduler;
+
+private:
+    Scheduler* scheduler;
+    Operator* root;
+    size_t batch_size;
+    size_t max_pending_batches;
+    /// The token that is attached to the operator tree of the query.
+    CancellationToken token;
+
+    mutable std::mutex mutex;
+    std::condition_variable batch_available;
+    std::deque<Batch> batches;
+    std::exception_ptr error;
+    bool opened = false;
+    bool cancelled = false;
+    bool finished = false;
+    /// Is the query neither running nor scheduled?
+    bool suspended = false;
+
+    /// Runs one step of the query on a worker thread.
+    void step();
+
+    /// Closes the root operator and marks the query as finished. Must be
+    /// called with `mutex` held.
+    void finish(std::exception_ptr step_error);
+
+    /// Schedules the next step when the query was suspended. Must be called
+    /// with `mutex` held.
+    void resume();
+
+public:
+    Query(Scheduler& scheduler, Operator& root, size_t batch_size, size_t max_pending_batches);
+
+    /// Fetches the next batch without blocking. Returns true when `batch` was
+    /// filled.
+    bool poll_batch(Batch& batch);
+
+    /// Fetches the next batch and blocks until one is available. Returns false
+    /// when the query has finished and all batches were fetched. Rethrows the
+    /// exception of a failed query.
+    bool wait_batch(Batch& batch);
+
+    /// Requests the cancellation of the query. Buffered batches are dropped
+    /// and the root operator is closed by the next step of the query. A step
+    /// that is currently running is interrupted by the operators'
+    /// cancellation checks.
+    void cancel();
+
+    /// Sets the deadline of the query. When it passes, the query fails with
+    /// `QueryInterrupted`, which is rethrown by `wait_batch()`.
+    void set_deadline(std::chrono::steady_clock::time_point deadline);
+
+    /// Was the query cancelled?
+    bool is_cancelled() const;
+
+    /// Has the query finished? A finished query might still have buffered
+    /// batches.
+    bool is_finished() const;
+};
+
+
+/// Runs queries on a fixed number of worker threads. Queries are executed
+/// step by step, so many concurrent queries can be multiplexed onto few
+/// threads. The operator trees of submitted queries must stay alive until the
+/// queries are finished.
+class Scheduler {
+    friend class Query;
+
+private:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable task_available;
+    std::deque<std::function<void()>> tasks;
+    std::vector<std::weak_ptr<Query>> queries;
+    bool stopping = false;
+
+    /// Enqueues a task for the worker threads.
+    void schedule(std::function<void()> task);
+
+    /// The loop of a worker thread.
+    void work();
+
+public:
+    /// Creates a scheduler with `thread_count` worker threads.
+    explicit Scheduler(size_t thread_count = std::thread::hardware_concurrency());
+
+    /// Cancels all unfinished queries and joins the worker threads.
+    ~Scheduler();
+
+    Scheduler(const Scheduler&) = delete;
+    Scheduler& operator=(const Scheduler&) = delete;
+
+    /// Submits a query with the root operator `root`. The operator is opened,
+    /// drained and closed on the worker threads. Every step of the query
+    /// produces at most `batch_size` tuples. The query attaches its own
+    /// cancellation token to the operator tree, with the given deadline
+    /// unless it is the default time point.
+    std::shared_ptr<Query> submit(
+        Operator& root,
+        size_t batch_size = 1024,
+        size_t max_pending_batches = 4,
+        std::chrono::steady_clock::time_point deadline = {}
+    );
+};
+
+}  // namespace iterator_model
+}  // namespace moderndbs
+
+#endif
@@ -0,0 +1,121 @@
+#ifndef INCLUDE_MODERNDBS_GERMAN_STRING_H
+#define INCLUDE_MODERNDBS_GERMAN_STRING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+namespace moderndbs {
+namespace iterator_model {
+
+/// A variable-length string in 16 bytes: its length, followed by all of its
+/// characters when there are at most `max_inline_size` of them, or by its
+/// first four characters and a pointer to all characters otherwise. Most
+/// comparisons are decided by the length and the first characters without
+/// following the pointer.
+///
+/// Long strings do not own their characters. They point into a `StringArena`
+/// or other storage that must outlive the string.
+class GermanString {
+public:
+    /// The length up to which the characters are stored in the string itself.
+    static constexpr size_t max_inline_size = 12;
+    /// The number of characters that long strings keep next to the pointer.
+    static constexpr size_t prefix_size = 4;
+
+private:
+    uint32_t length = 0;
+    /// All characters of inline strings, padded with zeros. Long strings
+    /// keep their prefix and the bytes of the pointer to their characters.
+    char chars[max_inline_size] = {};
+
+public:
+    /// Creates a string of `size` characters at `data`. The characters of
+    /// long strings are not copied.
+    static GermanString view(const char* data, size_t size);
+
+    /// Returns the number of characters.
+    size_t size() const {
+        return this->length;
+    }
+
+    /// Are the characters stored in the string itself?
+    bool is_inline() const {
+        return this->length <= max_inline_size;
+    }
+
+    /// Returns the characters, which are not null-terminated.
+    const char* data() const;
+
+    /// Copies the characters into a `std::string`.
+    std::string str() const;
+
+    /// Compares the characters lexicographically. Returns a negative value,
+    /// zero, or a positive value when this string is less than, equal to, or
+    /// greater than `other`.
+    int compare(const GermanString& other) const;
+
+    /// Returns the `hash_bytes()` of the characters.
+    uint64_t get_hash() const;
+
+    friend bool operator==(const GermanString& s1, const GermanString& s2);
+
+    friend bool operator!=(const GermanString& s1, const GermanString& s2) {
+        return !(s1 == s2);
+    }
+};
+
+static_assert(sizeof(GermanString) == 16, "german strings must fit into 16 bytes");
+
+
+/// Owns the characters of long `GermanString`s. Characters are copied into
+/// large chunks that are only freed with the arena, so the strings stay valid
+/// when the arena is moved.
+class StringArena {
+public:
+    /// The size of the chunks. Longer strings get a chunk of their own.
+    static constexpr size_t chunk_size = 64 * 1024;
+
+private:
+    std::vector<std::unique_ptr<char[]>> chunks;
+    /// The unused bytes of the last chunk.
+    char* next = nullptr;
+    size_t remaining = 0;
+    size_t allocated_bytes = 0;
+
+public:
+    StringArena() = default;
+    StringArena(const StringArena&) = delete;
+    StringArena(StringArena&&) = default;
+
+    StringArena& operator=(const StringArena&) = delete;
+    StringArena& operator=(StringArena&&) = default;
+
+    /// Returns a string of `size` characters at `data`. The characters of long
+    /// strings are copied into the arena.
+    GermanString store(const char* data, size_t size);
+
+    /// Returns a string with the characters of `value` whose characters are
+    /// owned by the arena when it is long.
+    GermanString store(const GermanString& value) {
+        return this->store(value.data(), value.size());
+    }
+
+    /// Returns a string with the characters of `value`.
+    GermanString store(const std::string& value) {
+        return this->store(value.data(), value.size());
+    }
+
+    /// Returns the number of bytes of the chunks.
+    size_t get_size_in_bytes() const {
+        return this->allocated_bytes;
+    }
+};
+
+}  // namespace iterator_model
+}  // namespace moderndbs
+
+#endif
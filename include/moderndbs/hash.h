@@ -0,0 +1,50 @@
+#ifndef INCLUDE_MODERNDBS_HASH_H
+#define INCLUDE_MODERNDBS_HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#if defined(__SSE4_2__)
+#include <nmmintrin.h>
+#endif
+
+
+namespace moderndbs {
+namespace iterator_model {
+
+/// Hashes a 64 bit integer. With SSE 4.2 these are two CRC32-C instructions
+/// over the value and over its swapped halves, joined to 64 bits, multiplied
+/// and folded back into the low bits; otherwise a multiply-xorshift mix. The
+/// low bits of the result, which select hash table buckets, are well
+/// distributed.
+inline uint64_t hash_int(uint64_t value) {
+#if defined(__SSE4_2__)
+    uint64_t low = _mm_crc32_u64(0, value);
+    uint64_t high = _mm_crc32_u64(0, value << 32U | value >> 32U);
+    uint64_t hash = (high << 32U | low) * 0x9e3779b97f4a7c15ULL;
+    return hash ^ (hash >> 32U);
+#else
+    value ^= value >> 32U;
+    value *= 0xd6e8feb86659fd93ULL;
+    value ^= value >> 32U;
+    value *= 0xd6e8feb86659fd93ULL;
+    value ^= value >> 32U;
+    return value;
+#endif
+}
+
+
+/// Hashes `size` bytes at `data`, eight bytes at a time. Strings of 16
+/// characters take two steps.
+uint64_t hash_bytes(const char* data, size_t size);
+
+
+/// Combines the hash of a further key attribute into `seed`. The order of the
+/// attributes matters.
+inline uint64_t combine_hashes(uint64_t seed, uint64_t hash) {
+    return ((seed << 27U | seed >> 37U) ^ hash) * 0x9e3779b97f4a7c15ULL;
+}
+
+}  // namespace iterator_model
+}  // namespace moderndbs
+
+#endif
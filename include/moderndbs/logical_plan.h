@@ -0,0 +1,187 @@
+#ifndef INCLUDE_MODERNDBS_LOGICAL_PLAN_H
+#define INCLUDE_MODERNDBS_LOGICAL_PLAN_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+#include <experimental/optional>
+#include "moderndbs/algebra.h"
+#include "moderndbs/planner.h"
+#include "moderndbs/statistics.h"
+
+
+namespace moderndbs {
+namespace iterator_model {
+
+/// Identifies an attribute of a logical plan independently of its position in
+/// the tuples.
+using ColumnId = size_t;
+
+
+/// A predicate of the form `column P constant` or `column P other_column`.
+struct LogicalPredicate {
+    ColumnId column;
+    Select::PredicateType predicate_type;
+    /// The constant, only used when `other_column` is unset. For parameters
+    /// this is a placeholder of the type of the parameter.
+    Register constant;
+    std::experimental::optional<ColumnId> other_column;
+    /// The index of the parameter whose value replaces `constant` at
+    /// execution time.
+    std::experimental::optional<size_t> parameter;
+
+    /// Returns the attributes that the predicate reads.
+    std::vector<ColumnId> get_columns() const;
+};
+
+
+struct LogicalSortCriterion {
+    ColumnId column;
+    bool desc;
+};
+
+
+struct LogicalAggregate {
+    HashAggregation::AggrFunc::Func func;
+    /// The aggregated attribute.
+    ColumnId column;
+    /// The attribute that holds the result.
+    ColumnId result;
+    /// See `HashAggregation::AggrFunc::parameter`.
+    double parameter = 0;
+};
+
+
+/// A node of a logical plan. Which members are used depends on `kind`.
+struct LogicalNode {
+    enum class Kind { SCAN, SELECT, PROJECTION, SORT, JOIN, AGGREGATION, SET_OPERATION };
+
+    Kind kind;
+    /// The inputs of the node. Binary nodes have the left input first.
+    std::vector<std::unique_ptr<LogicalNode>> inputs;
+    /// The output attributes in the order in which they appear in the tuples.
+    std::vector<ColumnId> columns;
+
+    /// SCAN: the source operator and the statistics of its output.
+    Operator* source = nullptr;
+    TableStatistics statistics;
+
+    /// SELECT: the conjunction of the predicates.
+    std::vector<LogicalPredicate> predicates;
+
+    /// SORT: the sort criteria.
+    std::vector<LogicalSortCriterion> criteria;
+
+    /// JOIN: the join keys of the left and right input and the kind of the
+    /// join. SEMI and ANTI joins only output the left attributes.
+    ColumnId left_key = 0;
+    ColumnId right_key = 0;
+    HashJoin::Type join_type = HashJoin::Type::INNER;
+
+    /// AGGREGATION: the group by attributes and the aggregates. The output
+    /// consists of the group by attributes followed by the aggregate results.
+    std::vector<ColumnId> group_by;
+    std::vector<LogicalAggregate> aggregates;
+
+    /// SET_OPERATION: the set operator. The output attributes are those of the
+    /// left input, the attributes of the right input correspond to them by
+    /// position.
+    Planner::SetOperation set_operation = Planner::SetOperation::UNION;
+
+    explicit LogicalNode(Kind kind) : kind(kind) {}
+};
+
+
+using LogicalNodePtr = std::unique_ptr<LogicalNode>;
+
+
+/// Builds logical plans and hands out the identifiers of their attributes.
+class LogicalPlanBuilder {
+private:
+    ColumnId next_column = 0;
+
+public:
+    /// Creates a scan of `source`. The output has one attribute per entry of
+    /// `statistics.columns`.
+    LogicalNodePtr scan(Operator& source, TableStatistics statistics);
+
+    /// Filters `input` with `column P constant`.
+    LogicalNodePtr select(LogicalNodePtr input, ColumnId column, Select::PredicateType predicate_type, Register constant);
+
+    /// Filters `input` with `column P other_column`.
+    LogicalNodePtr select(LogicalNodePtr input, ColumnId column, Select::PredicateType predicate_type, ColumnId other_column);
+
+    /// Filters `input` with `column P parameter` where the value of the
+    /// parameter with index `parameter` is bound at execution time.
+    LogicalNodePtr select_parameter(
+        LogicalNodePtr input,
+        ColumnId column,
+        Select::PredicateType predicate_type,
+        size_t parameter,
+        Register::Type parameter_type = Register::Type::INT64
+    );
+
+    LogicalNodePtr projection(LogicalNodePtr input, std::vector<ColumnId> columns);
+
+    LogicalNodePtr sort(LogicalNodePtr input, std::vector<LogicalSortCriterion> criteria);
+
+    LogicalNodePtr join(
+        LogicalNodePtr left,
+        LogicalNodePtr right,
+        ColumnId left_key,
+        ColumnId right_key,
+        HashJoin::Type join_type = HashJoin::Type::INNER
+    );
+
+    /// Groups `input` and computes the aggregates. Every aggregate gets a new
+    /// attribute for its result, which is written to `LogicalAggregate::result`.
+    LogicalNodePtr aggregation(
+        LogicalNodePtr input,
+        std::vector<ColumnId> group_by,
+        std::vector<LogicalAggregate> aggregates
+    );
+
+    /// Combines `left` and `right` with `set_operation`. Both inputs must have
+    /// a single attribute, otherwise `std::invalid_argument` is thrown.
+    LogicalNodePtr set_operation(Planner::SetOperation set_operation, LogicalNodePtr left, LogicalNodePtr right);
+};
+
+
+/// Rewrites a logical plan. The rewrites are:
+/// - `Intersect` and `Except` of single attributes become semi and anti joins
+///   on the distinct left input,
+/// - predicates are pushed down through projections, sorts, joins, group by
+///   attributes and set operators, and consecutive selections are merged,
+/// - sorts whose order is destroyed by an operator above them are removed,
+/// - trees of inner joins are reordered with dynamic programming over the
+///   connected subgraphs of their join graph to minimize the estimated sizes
+///   of the intermediate results, which may produce bushy trees,
+/// - unused aggregates are removed and the inputs of joins and sorts are
+///   pruned to the attributes that are used above them.
+/// The output attributes of the plan are not changed.
+LogicalNodePtr optimize(LogicalNodePtr plan);
+
+
+/// A `Select` of a lowered plan whose constant is a parameter.
+struct ParameterBinding {
+    Select* select;
+    size_t parameter;
+};
+
+
+/// Lowers a logical plan to physical operators that are owned by `planner`.
+/// The output tuples have the attributes of `plan.columns` in that order. The
+/// selections on parameters are appended to `bindings` when it is given.
+PlannedOperator lower(const LogicalNode& plan, Planner& planner, std::vector<ParameterBinding>* bindings = nullptr);
+
+
+/// Returns a string that identifies the shape of a plan: its operators, their
+/// sources, attributes and constants. Plans that only differ in the values of
+/// their parameters have the same fingerprint.
+std::string fingerprint(const LogicalNode& plan);
+
+}  // namespace iterator_model
+}  // namespace moderndbs
+
+#endif
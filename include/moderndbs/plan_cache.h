@@ -0,0 +1,101 @@
+#ifndef INCLUDE_MODERNDBS_PLAN_CACHE_H
+#define INCLUDE_MODERNDBS_PLAN_CACHE_H
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "moderndbs/algebra.h"
+#include "moderndbs/logical_plan.h"
+#include "moderndbs/planner.h"
+
+
+namespace moderndbs {
+namespace iterator_model {
+
+/// An optimized and lowered plan whose constants are parameters that are
+/// bound before every execution. The operators are created once and reused,
+/// so executions of the same prepared plan take turns, see `execute()`.
+class PreparedPlan {
+public:
+    /// An execution of a prepared plan. It holds the plan exclusively until
+    /// it is destroyed.
+    class Execution {
+    private:
+        std::unique_lock<std::mutex> lock;
+        Operator* root;
+
+    public:
+        Execution(std::unique_lock<std::mutex> lock, Operator& root);
+
+        /// Returns the root operator, which is ready to be opened.
+        Operator& get_root() const;
+    };
+
+private:
+    Planner planner;
+    PlannedOperator plan;
+    std::vector<ParameterBinding> bindings;
+    size_t parameter_count = 0;
+    /// Held by the current execution.
+    std::mutex mutex;
+
+public:
+    /// Optimizes and lowers `plan`.
+    explicit PreparedPlan(LogicalNodePtr plan);
+
+    /// Returns the number of parameters, which is one more than the largest
+    /// parameter index.
+    size_t get_parameter_count() const;
+
+    /// Returns the lowered plan.
+    const PlannedOperator& get_plan() const;
+
+    /// Waits until no other execution holds the plan, binds the parameters
+    /// and returns the new execution. `parameters` holds the values of the
+    /// parameters by index. A thread must not start an execution while it
+    /// still holds another one of the same plan.
+    Execution execute(const std::vector<Register>& parameters);
+};
+
+
+/// Caches prepared plans by the fingerprint of their logical plan, so queries
+/// that only differ in their parameters are optimized and lowered once. The
+/// sources of the cached plans must outlive the cache. The cache is safe to
+/// use from multiple threads.
+///
+/// Callers that prepare the same query share one prepared plan, whose
+/// operators and sources exist once. Their executions are therefore
+/// serialized by the plan rather than run on copies of it.
+class PlanCache {
+private:
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, std::shared_ptr<PreparedPlan>> plans;
+    size_t hit_count = 0;
+    size_t miss_count = 0;
+
+public:
+    /// Returns the prepared plan for `plan` and prepares it when it is not
+    /// cached yet.
+    std::shared_ptr<PreparedPlan> prepare(LogicalNodePtr plan);
+
+    /// Drops all cached plans, e.g. after the statistics of their tables
+    /// changed.
+    void clear();
+
+    /// Returns the number of plans in the cache.
+    size_t size() const;
+
+    /// Returns the number of calls of `prepare()` that found a cached plan.
+    size_t get_hit_count() const;
+
+    /// Returns the number of calls of `prepare()` that prepared a plan.
+    size_t get_miss_count() const;
+};
+
+}  // namespace iterator_model
+}  // namespace moderndbs
+
+#endif
@@ -0,0 +1,108 @@
+#ifndef INCLUDE_MODERNDBS_PLANNER_H
+#define INCLUDE_MODERNDBS_PLANNER_H
+
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "moderndbs/algebra.h"
+#include "moderndbs/statistics.h"
+
+
+namespace moderndbs {
+namespace iterator_model {
+
+/// A physical operator together with the estimated statistics of its output
+/// and the estimated cost of computing it.
+struct PlannedOperator {
+    Operator* op = nullptr;
+    TableStatistics statistics;
+    /// The estimated cost as the sum of the cardinalities of all tuples
+    /// produced or materialized by the operator tree.
+    double cost = 0;
+};
+
+
+/// Builds physical operator trees and uses cardinality estimates to choose
+/// between physical alternatives. The planner owns all operators it creates,
+/// so it must outlive the plans it returns.
+class Planner {
+public:
+    /// The set operators.
+    enum class SetOperation { UNION, UNION_ALL, INTERSECT, INTERSECT_ALL, EXCEPT, EXCEPT_ALL };
+
+private:
+    std::vector<std::unique_ptr<Operator>> operators;
+
+    /// Creates an operator that is owned by the planner.
+    template <typename T, typename... Args>
+    T& make(Args&&... args) {
+        auto op = std::make_unique<T>(std::forward<Args>(args)...);
+        T& result = *op;
+        this->operators.push_back(std::move(op));
+        return result;
+    }
+
+public:
+    /// Wraps a source operator whose output has the given statistics.
+    PlannedOperator scan(Operator& source, TableStatistics statistics);
+
+    PlannedOperator select(const PlannedOperator& input, const Select::PredicateAttributeInt64& predicate);
+    PlannedOperator select(const PlannedOperator& input, const Select::PredicateAttributeChar16& predicate);
+    PlannedOperator select(const PlannedOperator& input, const Select::PredicateAttributeValue& predicate);
+    PlannedOperator select(const PlannedOperator& input, const Select::PredicateAttributeAttribute& predicate);
+
+    PlannedOperator projection(const PlannedOperator& input, std::vector<size_t> attr_indexes);
+
+    /// Plans the inner equi-join of `left` and `right`. The output always
+    /// consists of the attributes of `left` followed by those of `right`.
+    /// The smaller input becomes the build side of the `HashJoin`; when that
+    /// is `right`, a `Projection` restores the attribute order.
+    PlannedOperator join(
+        const PlannedOperator& left,
+        const PlannedOperator& right,
+        size_t attr_index_left,
+        size_t attr_index_right
+    );
+
+    /// Plans a semi join (or an anti join when `anti` is set) that outputs the
+    /// tuples of `left` with (without) a join partner in `right`.
+    PlannedOperator semi_join(
+        const PlannedOperator& left,
+        const PlannedOperator& right,
+        size_t attr_index_left,
+        size_t attr_index_right,
+        bool anti = false
+    );
+
+    PlannedOperator aggregation(
+        const PlannedOperator& input,
+        std::vector<size_t> group_by_attrs,
+        std::vector<HashAggregation::AggrFunc> aggr_funcs
+    );
+
+    /// Plans an aggregation grouped by the join key over the inner equi-join
+    /// of `left` and `right` as a `GroupJoin`. The aggregate attributes refer to
+    /// the attributes of `left` followed by those of `right`. The smaller input
+    /// becomes the build side.
+    PlannedOperator group_join(
+        const PlannedOperator& left,
+        const PlannedOperator& right,
+        size_t attr_index_left,
+        size_t attr_index_right,
+        std::vector<HashAggregation::AggrFunc> aggr_funcs
+    );
+
+    PlannedOperator sort(const PlannedOperator& input, std::vector<Sort::Criterion> criteria);
+
+    PlannedOperator set_operation(SetOperation operation, const PlannedOperator& left, const PlannedOperator& right);
+
+    /// Estimates the number of bytes that materializing `statistics.row_count`
+    /// tuples takes.
+    static double estimate_size(const TableStatistics& statistics);
+};
+
+}  // namespace iterator_model
+}  // namespace moderndbs
+
+#endif
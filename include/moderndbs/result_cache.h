@@ -0,0 +1,157 @@
+#ifndef INCLUDE_MODERNDBS_RESULT_CACHE_H
+#define INCLUDE_MODERNDBS_RESULT_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "moderndbs/algebra.h"
+#include "moderndbs/logical_plan.h"
+#include "moderndbs/table.h"
+
+
+namespace moderndbs {
+namespace iterator_model {
+
+/// A materialized query result in a columnar layout. INT32 and DATE values
+/// take 4 bytes, the other numbers 8 bytes, strings their length plus a 4 byte
+/// offset. VARCHAR values that are read from the result point into it.
+class CompactResult {
+private:
+    struct Column {
+        Register::Type type = Register::Type::INT64;
+        /// The values of INT64 and DECIMAL columns.
+        std::vector<int64_t> ints;
+        /// The values of INT32 and DATE columns.
+        std::vector<int32_t> narrow_ints;
+        std::vector<double> doubles;
+        /// The concatenated strings of CHAR16 and VARCHAR columns and the end
+        /// offset of each of them.
+        std::string chars;
+        std::vector<uint32_t> ends;
+    };
+
+    size_t row_count = 0;
+    std::vector<Column> columns;
+
+public:
+    /// Appends a tuple. All tuples must have the same attribute types.
+    void append(const std::vector<Register*>& tuple);
+
+    /// Returns the number of tuples.
+    size_t get_row_count() const;
+
+    /// Returns the number of attributes.
+    size_t get_arity() const;
+
+    /// Returns the attribute types, empty while the result has no tuples.
+    Schema get_schema() const;
+
+    /// Returns the number of bytes that the result takes.
+    size_t get_size_in_bytes() const;
+
+    /// Returns the value of attribute `attr_index` of tuple `row`.
+    Register get(size_t row, size_t attr_index) const;
+};
+
+
+/// Generates the tuples of a `CompactResult`.
+class ResultScan
+: public Operator {
+private:
+    std::shared_ptr<const CompactResult> result;
+    size_t current_index = 0;
+    std::vector<Register> output_regs;
+
+public:
+    explicit ResultScan(std::shared_ptr<const CompactResult> result);
+
+    ~ResultScan() override;
+
+    void open() override;
+    bool next() override;
+    void close() override;
+    std::vector<Register*> get_output() override;
+};
+
+
+/// Caches query results by the fingerprint of their plan and the data
+/// versions of the tables that the plan reads. Results whose tables changed
+/// are dropped on their next lookup or by `invalidate()`. When the cached
+/// results exceed the byte budget, the least recently used ones are evicted.
+/// The cache is safe to use from multiple threads.
+class ResultCache {
+private:
+    struct Entry {
+        std::string key;
+        /// The tables read by the plan and their versions when the result was
+        /// computed.
+        std::vector<std::pair<const Table*, uint64_t>> versions;
+        std::shared_ptr<const CompactResult> result;
+        size_t size;
+    };
+
+    size_t byte_budget;
+    size_t used_bytes = 0;
+    mutable std::mutex mutex;
+    /// The entries, most recently used first.
+    std::list<Entry> entries;
+    std::unordered_map<std::string, std::list<Entry>::iterator> index;
+    size_t hit_count = 0;
+    size_t miss_count = 0;
+
+    /// Removes an entry. Must be called with `mutex` held.
+    void erase(std::list<Entry>::iterator entry);
+
+public:
+    explicit ResultCache(size_t byte_budget);
+
+    /// Returns the cached result for `key` when the tables still have the
+    /// given versions, nullptr otherwise.
+    std::shared_ptr<const CompactResult> lookup(
+        const std::string& key,
+        const std::vector<std::pair<const Table*, uint64_t>>& versions
+    );
+
+    /// Caches a result. Results larger than the byte budget are not cached.
+    void insert(
+        const std::string& key,
+        std::vector<std::pair<const Table*, uint64_t>> versions,
+        std::shared_ptr<const CompactResult> result
+    );
+
+    /// Returns the result of `plan`, either from the cache or by running
+    /// `root`, which must be the lowered `plan`. `parameters` are the values
+    /// bound to the parameters of the plan. Plans that do not only read from
+    /// `TableScan`s are run without caching.
+    std::shared_ptr<const CompactResult> execute(
+        const LogicalNode& plan,
+        Operator& root,
+        const std::vector<Register>& parameters = {}
+    );
+
+    /// Drops all results that read `table`.
+    void invalidate(const Table& table);
+
+    /// Returns the number of bytes of the cached results.
+    size_t get_used_bytes() const;
+
+    /// Returns the number of cached results.
+    size_t size() const;
+
+    /// Returns the number of lookups that found a valid result.
+    size_t get_hit_count() const;
+
+    /// Returns the number of lookups that found no valid result.
+    size_t get_miss_count() const;
+};
+
+}  // namespace iterator_model
+}  // namespace moderndbs
+
+#endif
@@ -0,0 +1,100 @@
+#ifndef INCLUDE_MODERNDBS_SAMPLE_H
+#define INCLUDE_MODERNDBS_SAMPLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+#include "moderndbs/algebra.h"
+#include "moderndbs/table.h"
+
+
+namespace moderndbs {
+namespace iterator_model {
+
+/// Generates a random sample of the input tuples. The sample only depends on
+/// the input and the seed, so it is the same every time the operator is
+/// opened.
+class Sample
+: public UnaryOperator {
+public:
+    /// Takes every tuple independently with probability `fraction`.
+    struct Bernoulli {
+        double fraction;
+    };
+
+    /// Takes a uniform random subset of `size` tuples, or all tuples when
+    /// there are fewer. The input is consumed completely before the first
+    /// tuple is generated.
+    struct Reservoir {
+        size_t size;
+    };
+
+private:
+    enum class Method { BERNOULLI, RESERVOIR };
+
+    Method method;
+    double fraction = 0;
+    size_t size = 0;
+    uint64_t seed;
+    std::mt19937_64 generator;
+    /// The sampled tuples of a reservoir sample.
+    std::vector<std::vector<Register>> tuples;
+    std::vector<Register> output_regs;
+    bool isMaterialized = false;
+    size_t current_index = 0;
+
+    bool next_bernoulli();
+    bool next_reservoir();
+
+public:
+    Sample(Operator& input, Bernoulli method, uint64_t seed = 0);
+    Sample(Operator& input, Reservoir method, uint64_t seed = 0);
+
+    ~Sample() override;
+
+    void open() override;
+    bool next() override;
+    void close() override;
+    std::vector<Register*> get_output() override;
+};
+
+
+/// Generates the tuples of a random subset of the blocks of a table. A table
+/// is split into blocks of `block_size` consecutive tuples and every block is
+/// taken independently with probability `fraction`. Blocks that are not taken
+/// are skipped without reading their tuples, so the scan costs about
+/// `fraction` of a full scan. The tuples of a block are correlated, so the
+/// sample is less accurate than a `Sample` with the same fraction.
+class BlockSampleScan
+: public Operator {
+public:
+    static constexpr size_t default_block_size = 1024;
+
+private:
+    const Table* table;
+    double fraction;
+    size_t block_size;
+    uint64_t seed;
+    std::mt19937_64 generator;
+    /// The block that follows the current one.
+    size_t next_block = 0;
+    size_t current_index = 0;
+    size_t block_end = 0;
+    std::vector<Register> output_regs;
+
+public:
+    BlockSampleScan(const Table& table, double fraction, uint64_t seed = 0, size_t block_size = default_block_size);
+
+    ~BlockSampleScan() override;
+
+    void open() override;
+    bool next() override;
+    void close() override;
+    std::vector<Register*> get_output() override;
+};
+
+}  // namespace iterator_model
+}  // namespace moderndbs
+
+#endif
@@ -0,0 +1,202 @@
+#ifndef INCLUDE_MODERNDBS_SKETCH_H
+#define INCLUDE_MODERNDBS_SKETCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "moderndbs/algebra.h"
+
+
+namespace moderndbs {
+namespace iterator_model {
+
+/// Estimates the number of distinct values of a stream in constant space.
+/// Sketches of different parts of a stream can be merged.
+class HyperLogLog {
+private:
+    /// The number of hash bits that select the register.
+    uint8_t precision;
+    /// The largest number of leading zeros plus one seen per register.
+    std::vector<uint8_t> registers;
+
+public:
+    /// Creates a sketch with `2^precision` registers. The relative error is
+    /// about `1.04 / sqrt(2^precision)`. `precision` must be in [4, 18].
+    explicit HyperLogLog(uint8_t precision = 12);
+
+    /// Adds a value by its hash. The hashes must be uniformly distributed
+    /// over all 64 bits.
+    void add(uint64_t hash);
+
+    /// Adds a value. It is hashed uniformly over all 64 bits, which
+    /// `Register::get_hash()` does not guarantee.
+    void add(const Register& value);
+
+    /// Adds all values of `other`, which must have the same precision.
+    void merge(const HyperLogLog& other);
+
+    /// Estimates the number of distinct values that were added.
+    uint64_t estimate() const;
+};
+
+
+/// A uniform random sample of fixed size from a stream of unknown length. Uses
+/// Algorithm L by Li, which only draws random numbers for the values that are
+/// taken into the sample, so skipped values cost a single comparison.
+class ReservoirSample {
+private:
+    size_t capacity;
+    /// The number of values seen so far.
+    uint64_t count = 0;
+    /// The number of values after which the next value is taken.
+    uint64_t next_taken = 0;
+    /// The largest of the random keys of the values in the sample.
+    double weight = 1.0;
+    std::mt19937_64 generator;
+    std::vector<Register> values;
+
+    /// Returns a random number in (0, 1).
+    double random();
+
+    /// Computes the next value that is taken once the sample is full.
+    void skip();
+
+public:
+    explicit ReservoirSample(size_t capacity = 10000, uint64_t seed = 0);
+
+    /// Counts the next value of the stream without storing it. Returns the
+    /// slot that the value takes in the sample, or nothing when it is skipped.
+    /// A slot equal to the current sample size means that the value is
+    /// appended. Lets callers keep the sampled values themselves; `get_values()`
+    /// and `merge()` only see values offered through `add()`.
+    std::experimental::optional<size_t> offer();
+
+    /// Offers the next value of the stream.
+    void add(const Register& value);
+
+    /// Merges the sample of another part of the stream. Every value of the
+    /// merged sample is drawn from one of both samples with a probability
+    /// proportional to the number of values that the sample stands for.
+    void merge(const ReservoirSample& other);
+
+    /// Returns the number of values that were offered.
+    uint64_t get_count() const;
+
+    /// Returns the sampled values in no particular order.
+    const std::vector<Register>& get_values() const;
+};
+
+
+/// Finds the most frequent values of a stream with a fixed number of counters
+/// (the Space-Saving algorithm by Metwally et al.). A value that is not
+/// counted yet replaces the value with the smallest count and inherits that
+/// count as its overestimation error. Every value that occurs more than
+/// `count / capacity` times is guaranteed to be counted.
+class SpaceSaving {
+public:
+    struct Counter {
+        Register value;
+        /// An upper bound of the number of occurrences of `value`.
+        uint64_t count;
+        /// By how much `count` may overestimate the occurrences.
+        uint64_t error;
+    };
+
+private:
+    struct RegisterHash {
+        size_t operator()(const Register& reg) const {
+            return reg.get_hash();
+        }
+    };
+
+    size_t capacity;
+    std::vector<Counter> counters;
+    /// The index of every counted value in `counters`.
+    std::unordered_map<Register, size_t, RegisterHash> index;
+
+    /// Replaces the counter with the smallest count by `value`.
+    void replace_minimum(const Register& value, uint64_t count);
+
+public:
+    explicit SpaceSaving(size_t capacity = 64);
+
+    /// Adds `count` occurrences of a value.
+    void add(const Register& value, uint64_t count = 1);
+
+    /// Adds the counters of another part of the stream. Values that only one
+    /// sketch counts are assumed to occur as often as the smallest count of the
+    /// other sketch, which keeps the error bounds of both sketches.
+    void merge(const SpaceSaving& other);
+
+    /// Returns up to `k` counters with the highest counts, highest first.
+    std::vector<Counter> get_top(size_t k) const;
+};
+
+
+/// Estimates quantiles of a stream of integers (the KLL sketch by Karnin, Lang
+/// and Liberty). Values are kept in compactors of increasing weight; a full
+/// compactor sorts its values and promotes every other one to the next level.
+/// The rank error is about `1.7 / k` with high probability.
+class KllSketch {
+private:
+    size_t k;
+    /// The compactors. The values of level `h` stand for `2^h` values each.
+    std::vector<std::vector<int64_t>> levels;
+    uint64_t count = 0;
+    std::mt19937_64 generator;
+
+    /// Returns the number of values that level `level` may hold.
+    size_t get_level_capacity(size_t level) const;
+
+    /// Compacts levels until all values fit.
+    void compress();
+
+public:
+    explicit KllSketch(size_t k = 200, uint64_t seed = 0);
+
+    /// Adds a value.
+    void add(int64_t value);
+
+    /// Adds all values of `other`.
+    void merge(const KllSketch& other);
+
+    /// Returns the number of values that were added.
+    uint64_t get_count() const;
+
+    /// Returns the approximate `quantile`-quantile, `quantile` in [0, 1]. Must
+    /// not be called on an empty sketch.
+    int64_t get_quantile(double quantile) const;
+};
+
+
+/// The state of an approximate aggregate of a `HashAggregation` for one group.
+/// States of the same aggregate can be merged, so groups that were aggregated
+/// on different threads or partitions can be combined.
+class ApproximateAggregate {
+public:
+    virtual ~ApproximateAggregate() = default;
+
+    /// Creates the state of an APPROX_* aggregate.
+    static std::unique_ptr<ApproximateAggregate> create(const HashAggregation::AggrFunc& func);
+
+    /// Returns a copy of the state.
+    virtual std::unique_ptr<ApproximateAggregate> clone() const = 0;
+
+    /// Adds a value of the aggregated attribute.
+    virtual void add(const Register& value) = 0;
+
+    /// Adds the values of `other`, which must be a state of the same aggregate.
+    virtual void merge(const ApproximateAggregate& other) = 0;
+
+    /// Returns the result of the aggregate.
+    virtual Register get_result() const = 0;
+};
+
+}  // namespace iterator_model
+}  // namespace moderndbs
+
+#endif
@@ -0,0 +1,149 @@
+#ifndef INCLUDE_MODERNDBS_STATISTICS_H
+#define INCLUDE_MODERNDBS_STATISTICS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <experimental/optional>
+#include "moderndbs/algebra.h"
+#include "moderndbs/sketch.h"
+
+
+namespace moderndbs {
+namespace iterator_model {
+
+/// Statistics of a single attribute.
+struct ColumnStatistics {
+    /// Number of distinct values.
+    uint64_t distinct_count = 0;
+    /// The smallest value, unset when unknown.
+    std::experimental::optional<Register> min;
+    /// The largest value, unset when unknown.
+    std::experimental::optional<Register> max;
+    /// The upper bounds of the buckets of an equi-depth histogram in ascending
+    /// order. Every bucket holds roughly the same number of tuples. Bucket `i`
+    /// contains the values in (`histogram_bounds[i - 1]`,
+    /// `histogram_bounds[i]`]. Empty when there is no histogram.
+    std::vector<Register> histogram_bounds;
+
+    /// Estimates the fraction of tuples for which `value P constant` holds
+    /// where P is given by `predicate_type`. The constant is converted to the
+    /// type of the attribute like the constants of `Select`, see
+    /// `coerce_constant()`.
+    double estimate_selectivity(Select::PredicateType predicate_type, const Register& constant) const;
+
+    /// Estimates the fraction of tuples whose value is smaller than
+    /// `constant`, which is converted like in `estimate_selectivity()`.
+    double estimate_fraction_below(const Register& constant) const;
+};
+
+
+/// Statistics of a table or of the output of an operator.
+struct TableStatistics {
+    /// Number of tuples.
+    uint64_t row_count = 0;
+    /// The statistics of every attribute, one entry per attribute. May be
+    /// empty when the arity is unknown.
+    std::vector<ColumnStatistics> columns;
+};
+
+
+/// The synopses of an attribute from which its statistics are derived.
+struct ColumnSynopsis {
+    HyperLogLog distinct_values;
+    ReservoirSample sample;
+    std::experimental::optional<Register> min;
+    std::experimental::optional<Register> max;
+
+    ColumnSynopsis(size_t sample_size, uint64_t seed) : sample(sample_size, seed) {}
+};
+
+
+/// Collects the statistics of a stream of tuples in a single pass: the exact
+/// number of tuples and the exact bounds, a HyperLogLog sketch and a
+/// reservoir sample per attribute. Collectors of disjoint parts of the stream
+/// can run in parallel and be merged afterwards.
+class StatisticsCollector {
+public:
+    static constexpr size_t default_sample_size = 10000;
+    static constexpr size_t default_histogram_buckets = 100;
+
+private:
+    uint64_t row_count = 0;
+    std::vector<ColumnSynopsis> columns;
+
+public:
+    /// Creates a collector for tuples with `arity` attributes. Collectors
+    /// that are merged should use different seeds.
+    explicit StatisticsCollector(size_t arity, size_t sample_size = default_sample_size, uint64_t seed = 0);
+
+    /// Adds a tuple.
+    void add(const std::vector<Register>& tuple);
+    void add(const std::vector<Register*>& tuple);
+
+    /// Adds the tuples that `other` has seen.
+    void merge(const StatisticsCollector& other);
+
+    /// Returns the synopses of all attributes.
+    const std::vector<ColumnSynopsis>& get_synopses() const;
+
+    /// Derives the statistics. The equi-depth histograms with up to
+    /// `histogram_buckets` buckets are built from the samples.
+    TableStatistics get_statistics(size_t histogram_buckets = default_histogram_buckets) const;
+};
+
+
+/// Scans the whole output of `input` once and collects its statistics.
+TableStatistics analyze(
+    Operator& input,
+    size_t histogram_buckets = StatisticsCollector::default_histogram_buckets,
+    size_t sample_size = StatisticsCollector::default_sample_size
+);
+
+
+/// Estimates the output statistics of a `Select` with the given predicate.
+TableStatistics estimate_select(const TableStatistics& input, const Select::PredicateAttributeInt64& predicate);
+TableStatistics estimate_select(const TableStatistics& input, const Select::PredicateAttributeChar16& predicate);
+TableStatistics estimate_select(const TableStatistics& input, const Select::PredicateAttributeValue& predicate);
+TableStatistics estimate_select(const TableStatistics& input, const Select::PredicateAttributeAttribute& predicate);
+
+/// Estimates the output statistics of a `Select` that compares an attribute
+/// with a constant that is only known at execution time.
+TableStatistics estimate_parameter_select(
+    const TableStatistics& input,
+    size_t attr_index,
+    Select::PredicateType predicate_type
+);
+
+/// Estimates the output statistics of a `Projection`.
+TableStatistics estimate_projection(const TableStatistics& input, const std::vector<size_t>& attr_indexes);
+
+/// Estimates the output statistics of an equi-join of `left` and `right`.
+TableStatistics estimate_join(
+    const TableStatistics& left,
+    const TableStatistics& right,
+    size_t attr_index_left,
+    size_t attr_index_right
+);
+
+/// Estimates the output statistics of a semi join (or an anti join when `anti`
+/// is set) of `left` and `right`.
+TableStatistics estimate_semi_join(
+    const TableStatistics& left,
+    const TableStatistics& right,
+    size_t attr_index_left,
+    size_t attr_index_right,
+    bool anti
+);
+
+/// Estimates the output statistics of a `HashAggregation`.
+TableStatistics estimate_aggregation(
+    const TableStatistics& input,
+    const std::vector<size_t>& group_by_attrs,
+    const std::vector<HashAggregation::AggrFunc>& aggr_funcs
+);
+
+}  // namespace iterator_model
+}  // namespace moderndbs
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef INCLUDE_MODERNDBS_TABLE_H
+#define INCLUDE_MODERNDBS_TABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "moderndbs/algebra.h"
+#include "moderndbs/statistics.h"
+
+
+namespace moderndbs {
+namespace iterator_model {
+
+/// An in-memory table. The statistics of the table are kept with it and are
+/// refreshed by `analyze()`. The characters of long VARCHAR values are copied
+/// into the table, so the registers of its tuples stay valid as long as the
+/// table.
+class Table {
+private:
+    size_t arity;
+    /// Changes with every modification of the tuples. Drawn from a counter
+    /// shared by all tables, so no two states of any tables have the same
+    /// version.
+    uint64_t version = 0;
+    std::vector<std::vector<Register>> tuples;
+    /// The attribute types, taken from the first tuple.
+    Schema schema;
+    StringArena strings;
+    TableStatistics statistics;
+    std::vector<ColumnSynopsis> synopses;
+
+public:
+    explicit Table(size_t arity);
+
+    /// Appends a tuple with `arity` attributes.
+    void insert(std::vector<Register> tuple);
+
+    /// Returns the number of attributes.
+    size_t get_arity() const;
+
+    /// Returns the attribute types, empty while the table has no tuples.
+    const Schema& get_schema() const;
+
+    /// Returns the data version, which changes whenever the tuples change and
+    /// is unique among all tables of the process.
+    uint64_t get_version() const;
+
+    /// Returns the tuples in insertion order.
+    const std::vector<std::vector<Register>>& get_tuples() const;
+
+    /// Scans all tuples once with `thread_count` threads and replaces the
+    /// statistics and synopses of the table.
+    void analyze(
+        size_t thread_count = 1,
+        size_t histogram_buckets = StatisticsCollector::default_histogram_buckets,
+        size_t sample_size = StatisticsCollector::default_sample_size
+    );
+
+    /// Returns the statistics of the last `analyze()`. Without one, only the
+    /// number of tuples is known.
+    TableStatistics get_statistics() const;
+
+    /// Returns the synopses of the last `analyze()`.
+    const std::vector<ColumnSynopsis>& get_synopses() const;
+};
+
+
+/// Generates all tuples of a table.
+class TableScan
+: public Operator {
+private:
+    const Table* table;
+    size_t current_index = 0;
+    std::vector<Register> output_regs;
+
+public:
+    explicit TableScan(const Table& table);
+
+    ~TableScan() override;
+
+    /// Returns the scanned table.
+    const Table& get_table() const;
+
+    void open() override;
+    bool next() override;
+    void close() override;
+    std::vector<Register*> get_output() override;
+};
+
+}  // namespace iterator_model
+}  // namespace moderndbs
+
+#endif
@@ -1,11 +1,23 @@
+#include <algorithm>
+#include <array>
 #include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <functional>
 #include <vector>
 #include <string>
 #include <iostream>
+#include <limits>
+#include <sstream>
+#include <thread>
 #include <unordered_map>
 #include <unordered_set>
+#include <unistd.h>
 #include "moderndbs/algebra.h"
+#include "moderndbs/hash.h"
+#include "moderndbs/sketch.h"
 
 namespace moderndbs {
     namespace iterator_model {
@@ -29,18 +41,543 @@ namespace moderndbs {
 /// std::unordered_set<std::vector<Register>, RegisterVectorHasher> set_of_tuples;
         struct RegisterVectorHasher {
             uint64_t operator()(const std::vector<Register>& registers) const {
-                std::string hash_values;
-                for (auto& reg : registers) {
-                    uint64_t hash = reg.get_hash();
-                    hash_values.append(reinterpret_cast<char*>(&hash), sizeof(hash));
+                if (registers.empty()) {
+                    return 0;
                 }
-                return std::hash<std::string>{}(hash_values);
+                uint64_t hash = registers[0].get_hash();
+                for (size_t i = 1; i < registers.size(); ++i) {
+                    hash = combine_hashes(hash, registers[i].get_hash());
+                }
+                return hash;
+            }
+        };
+
+
+        uint64_t hash_attributes(
+                const std::vector<Register>& tuple,
+                const std::vector<size_t>& attrs,
+                const Schema& types
+        ) {
+            uint64_t hash = 0;
+            for (size_t k = 0; k < attrs.size(); ++k) {
+                const Register& value = tuple[attrs[k]];
+                uint64_t value_hash = types.empty() ? value.get_hash() : Register::hash(value, types[k]);
+                hash = k == 0 ? value_hash : combine_hashes(hash, value_hash);
+            }
+            return hash;
+        }
+
+
+        namespace {
+
+/// Computes `hash_attributes()` for `count` tuples at once. The tuples are
+/// hashed one attribute at a time, so the type of each attribute is only
+/// looked at once.
+            void hash_attributes(
+                    const std::vector<std::vector<Register>>& tuples,
+                    size_t count,
+                    const std::vector<size_t>& attrs,
+                    const Schema& types,
+                    uint64_t* hashes
+            ) {
+                std::fill(hashes, hashes + count, 0);
+                for (size_t k = 0; k < attrs.size(); ++k) {
+                    size_t attr = attrs[k];
+                    if (types.empty()) {
+                        for (size_t i = 0; i < count; ++i) {
+                            uint64_t value_hash = tuples[i][attr].get_hash();
+                            hashes[i] = k == 0 ? value_hash : combine_hashes(hashes[i], value_hash);
+                        }
+                    } else {
+                        Register::Type type = types[k];
+                        for (size_t i = 0; i < count; ++i) {
+                            uint64_t value_hash = Register::hash(tuples[i][attr], type);
+                            hashes[i] = k == 0 ? value_hash : combine_hashes(hashes[i], value_hash);
+                        }
+                    }
+                }
+            }
+
+
+/// Returns 10^`digits`.
+            constexpr int64_t power_of_ten(int digits) {
+                int64_t result = 1;
+                for (int i = 0; i < digits; ++i) {
+                    result *= 10;
+                }
+                return result;
+            }
+
+
+/// The factor between DECIMAL values and their unscaled representation.
+            constexpr int64_t decimal_factor = power_of_ten(Register::decimal_digits);
+
+
+/// Formats a date given as days since 1970-01-01 as YYYY-MM-DD. Uses the
+/// proleptic Gregorian calendar, see
+/// http://howardhinnant.github.io/date_algorithms.html#civil_from_days
+            std::string format_date(int64_t days) {
+                days += 719468;
+                int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+                int64_t day_of_era = days - era * 146097;
+                int64_t year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+                int64_t day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+                int64_t shifted_month = (5 * day_of_year + 2) / 153;
+                int64_t day = day_of_year - (153 * shifted_month + 2) / 5 + 1;
+                int64_t month = shifted_month < 10 ? shifted_month + 3 : shifted_month - 9;
+                int64_t year = year_of_era + era * 400 + (month <= 2 ? 1 : 0);
+                char buffer[64];
+                std::snprintf(buffer, sizeof(buffer), "%04lld-%02lld-%02lld",
+                              static_cast<long long>(year), static_cast<long long>(month), static_cast<long long>(day));
+                return buffer;
+            }
+
+
+/// Formats an unscaled DECIMAL value with `Register::decimal_digits`
+/// fractional digits.
+            std::string format_decimal(int64_t value) {
+                uint64_t magnitude = value < 0 ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+                std::string fraction = std::to_string(magnitude % decimal_factor);
+                fraction.insert(0, Register::decimal_digits - fraction.size(), '0');
+                return (value < 0 ? "-" : "") + std::to_string(magnitude / decimal_factor) + "." + fraction;
+            }
+
+
+/// Returns the type of a SUM over values of type `type`. DOUBLE and DECIMAL
+/// sums keep their type, the other types are summed as INT64.
+            Register::Type get_sum_type(Register::Type type) {
+                return type == Register::Type::DOUBLE || type == Register::Type::DECIMAL ? type : Register::Type::INT64;
+            }
+
+
+/// Converts `value` to the type of a SUM over it and multiplies it by
+/// `factor`.
+            Register to_sum(const Register& value, int64_t factor = 1) {
+                if (value.get_type() == Register::Type::DOUBLE) {
+                    return Register::from_double(value.as_double() * static_cast<double>(factor));
+                }
+                return Register::from_integer(get_sum_type(value.get_type()), value.as_int() * factor);
+            }
+
+
+/// Adds two sums of the same type.
+            Register add_sums(const Register& left, const Register& right) {
+                if (left.get_type() == Register::Type::DOUBLE) {
+                    return Register::from_double(left.as_double() + right.as_double());
+                }
+                return Register::from_integer(left.get_type(), left.as_int() + right.as_int());
+            }
+
+
+/// Evaluates `left P right` where P is given by `predicate_type` and
+/// `comparison` is the result of `Register::compare(left, right, ...)`.
+            bool evaluate_comparison(int comparison, Select::PredicateType predicate_type) {
+                switch (predicate_type) {
+                    case Select::PredicateType::EQ :
+                        return comparison == 0;
+                    case Select::PredicateType::NE :
+                        return comparison != 0;
+                    case Select::PredicateType::LT :
+                        return comparison < 0;
+                    case Select::PredicateType::LE :
+                        return comparison <= 0;
+                    case Select::PredicateType::GT :
+                        return comparison > 0;
+                    case Select::PredicateType::GE :
+                        return comparison >= 0;
+                }
+                return false;
+            }
+
+
+/// Evaluates `left P right` where P is given by `predicate_type`.
+            bool evaluate_predicate(const Register& left, const Register& right, Select::PredicateType predicate_type) {
+                switch (predicate_type) {
+                    case Select::PredicateType::EQ :
+                        return left == right;
+                    case Select::PredicateType::NE :
+                        return left != right;
+                    case Select::PredicateType::LT :
+                        return left < right;
+                    case Select::PredicateType::LE :
+                        return left <= right;
+                    case Select::PredicateType::GT :
+                        return left > right;
+                    case Select::PredicateType::GE :
+                        return left >= right;
+                }
+                return false;
+            }
+
+
+/// Is `type` an integer type whose values compare by their integer value?
+            bool is_integer_type(Register::Type type) {
+                return type == Register::Type::INT64 || type == Register::Type::INT32 || type == Register::Type::DATE;
+            }
+
+
+/// Writes the indexes of the first `count` tuples whose entry in `matches` is
+/// set to `selection` and returns their number. Branches on every outcome.
+            size_t select_branching(const uint8_t* matches, size_t count, uint32_t* selection) {
+                size_t selected = 0;
+                for (size_t i = 0; i < count; ++i) {
+                    if (matches[i] != 0) {
+                        selection[selected++] = static_cast<uint32_t>(i);
+                    }
+                }
+                return selected;
+            }
+
+
+/// Like `select_branching()`, but writes every index and only advances past
+/// the matching ones, so the loop has no branch on the outcome.
+            size_t select_predicated(const uint8_t* matches, size_t count, uint32_t* selection) {
+                size_t selected = 0;
+                for (size_t i = 0; i < count; ++i) {
+                    selection[selected] = static_cast<uint32_t>(i);
+                    selected += matches[i];
+                }
+                return selected;
+            }
+
+
+/// Returns the number of buckets of a hash directory for `count` entries. This
+/// is always a power of two so that buckets can be selected with a mask.
+            size_t directory_size(size_t count) {
+                size_t size = 1;
+                while (size < 2 * count) {
+                    size <<= 1U;
+                }
+                return size;
+            }
+
+
+/// Writes a value in the binary format of `AggregationState::save()`.
+            template <typename T>
+            void write_value(std::ostream& stream, T value) {
+                stream.write(reinterpret_cast<const char*>(&value), sizeof(value));
+            }
+
+
+/// Reads a value written by `write_value()`.
+            template <typename T>
+            T read_value(std::istream& stream) {
+                T value{};
+                if (!stream.read(reinterpret_cast<char*>(&value), sizeof(value))) {
+                    throw std::runtime_error("unexpected end of the aggregation state");
+                }
+                return value;
+            }
+
+
+/// Writes a register with its type.
+            void write_register(std::ostream& stream, const Register& reg) {
+                write_value<uint8_t>(stream, static_cast<uint8_t>(reg.get_type()));
+                switch (reg.get_type()) {
+                    case Register::Type::CHAR16:
+                    case Register::Type::VARCHAR: {
+                        std::string value = reg.as_string();
+                        write_value<uint64_t>(stream, value.size());
+                        stream.write(value.data(), static_cast<std::streamsize>(value.size()));
+                        break;
+                    }
+                    case Register::Type::DOUBLE:
+                        write_value<double>(stream, reg.as_double());
+                        break;
+                    default:
+                        write_value<int64_t>(stream, reg.as_int());
+                        break;
+                }
+            }
+
+
+/// Reads a register written by `write_register()`. The characters of long
+/// VARCHAR values are kept in `strings`.
+            Register read_register(std::istream& stream, StringArena& strings) {
+                auto type = static_cast<Register::Type>(read_value<uint8_t>(stream));
+                switch (type) {
+                    case Register::Type::CHAR16:
+                    case Register::Type::VARCHAR:
+                        break;
+                    case Register::Type::DOUBLE:
+                        return Register::from_double(read_value<double>(stream));
+                    case Register::Type::INT64:
+                    case Register::Type::INT32:
+                    case Register::Type::DATE:
+                    case Register::Type::DECIMAL:
+                        return Register::from_integer(type, read_value<int64_t>(stream));
+                    default:
+                        throw std::runtime_error("invalid register type in the aggregation state");
+                }
+                std::string value(read_value<uint64_t>(stream), '\0');
+                if (!stream.read(&value[0], static_cast<std::streamsize>(value.size()))) {
+                    throw std::runtime_error("unexpected end of the aggregation state");
+                }
+                if (type == Register::Type::VARCHAR) {
+                    return Register::from_varchar(value, strings);
+                }
+                return Register::from_string(value);
+            }
+
+
+/// Does any of the aggregates need a sketch?
+            bool has_approximate_aggregates(const std::vector<HashAggregation::AggrFunc>& aggr_funcs) {
+                return std::any_of(aggr_funcs.begin(), aggr_funcs.end(), [](auto& func) { return func.is_approximate(); });
+            }
+
+
+/// Compares two tuples by the given sort criteria. Returns a negative value
+/// when `left` comes first, a positive value when `right` comes first, and 0
+/// when they are equal in all criteria. The attributes are compared with the
+/// types of `schema`, or by their own types when the schema is empty.
+            int compare_tuples(
+                    const std::vector<Register>& left,
+                    const std::vector<Register>& right,
+                    const std::vector<Sort::Criterion>& criteria,
+                    const Schema& schema
+            ) {
+                for (auto& criterion : criteria) {
+                    auto& l = left[criterion.attr_index];
+                    auto& r = right[criterion.attr_index];
+                    int comparison = 0;
+                    if (!schema.empty()) {
+                        comparison = Register::compare(l, r, schema[criterion.attr_index]);
+                    } else if (l != r) {
+                        comparison = l < r ? -1 : 1;
+                    }
+                    if (comparison != 0) {
+                        return criterion.desc ? -comparison : comparison;
+                    }
+                }
+                return 0;
+            }
+
+
+/// Returns the type of the result of an aggregate over an input with the
+/// given schema.
+            Register::Type get_aggregate_type(const HashAggregation::AggrFunc& func, const Schema& input) {
+                switch (func.func) {
+                    case HashAggregation::AggrFunc::MIN:
+                    case HashAggregation::AggrFunc::MAX:
+                    case HashAggregation::AggrFunc::APPROX_QUANTILE:
+                    case HashAggregation::AggrFunc::APPROX_MOST_FREQUENT:
+                        return input[func.attr_index];
+                    case HashAggregation::AggrFunc::SUM:
+                        return get_sum_type(input[func.attr_index]);
+                    default:
+                        return Register::Type::INT64;
+                }
+            }
+
+
+/// A segment tree over fixed values that answers range aggregates in
+/// logarithmic time. `Combine` must be associative and commutative.
+            template <typename T, typename Combine>
+            class SegmentTree {
+            private:
+                size_t size;
+                /// The inner nodes at [1, size), the leaves at [size, 2 * size).
+                std::vector<T> nodes;
+                Combine combine;
+
+            public:
+                SegmentTree(std::vector<T> values, Combine combine)
+                        : size(values.size()), nodes(2 * values.size()), combine(combine) {
+                    std::move(values.begin(), values.end(), this->nodes.begin() + this->size);
+                    for (size_t i = this->size - 1; i > 0; --i) {
+                        this->nodes[i] = this->combine(this->nodes[2 * i], this->nodes[2 * i + 1]);
+                    }
+                }
+
+                /// Aggregates the values in [begin, end), which must not be
+                /// empty.
+                T query(size_t begin, size_t end) const {
+                    assert(begin < end);
+                    T result = this->nodes[begin + this->size];
+                    for (begin += this->size + 1, end += this->size; begin < end; begin >>= 1U, end >>= 1U) {
+                        if ((begin & 1U) != 0) {
+                            result = this->combine(result, this->nodes[begin++]);
+                        }
+                        if ((end & 1U) != 0) {
+                            result = this->combine(result, this->nodes[--end]);
+                        }
+                    }
+                    return result;
+                }
+            };
+
+
+/// Builds a segment tree from `values`.
+            template <typename T, typename Combine>
+            SegmentTree<T, Combine> make_segment_tree(std::vector<T> values, Combine combine) {
+                return SegmentTree<T, Combine>(std::move(values), combine);
+            }
+
+
+/// Returns the schema of a set operation over inputs with the schema `left`.
+/// The set operations emit every register of their inputs on its own, so the
+/// output has a schema only if the input tuples have a single attribute.
+            Schema set_operation_schema(const Schema& left) {
+                if (left.size() == 1) {
+                    return left;
+                }
+                return {};
+            }
+
+        }  // namespace
+
+
+        Register coerce_constant(const Register& value, Register::Type type, StringArena& strings) {
+            bool is_string = value.get_type() == Register::Type::CHAR16 || value.get_type() == Register::Type::VARCHAR;
+            if (is_string && type == Register::Type::VARCHAR) {
+                return Register::from_varchar(value.as_string(), strings);
+            }
+            if (is_string && type == Register::Type::CHAR16 && value.as_string().size() <= 16) {
+                return Register::from_string(value.as_string());
+            }
+            if (is_integer_type(value.get_type())) {
+                if (is_integer_type(type)) {
+                    return Register::from_integer(type, value.as_int());
+                }
+                if (type == Register::Type::DECIMAL) {
+                    return Register::from_decimal(value.as_int() * decimal_factor);
+                }
+                if (type == Register::Type::DOUBLE) {
+                    return Register::from_double(static_cast<double>(value.as_int()));
+                }
+            }
+            throw std::invalid_argument("the constant of the predicate does not match the type of the attribute");
+        }
+
+
+/// A temporary file of spilled tuples and the hash values of their join keys.
+/// The file is unlinked right after it is created, so it disappears with the
+/// stream.
+        class SpillFile {
+        private:
+            std::fstream stream;
+
+        public:
+            SpillFile() {
+                const char* directory = std::getenv("TMPDIR");
+                std::string path = std::string(directory != nullptr ? directory : "/tmp") + "/moderndbs-spill-XXXXXX";
+                int descriptor = mkstemp(&path[0]);
+                if (descriptor < 0) {
+                    throw std::runtime_error("cannot create a spill file");
+                }
+                this->stream.open(path, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+                ::close(descriptor);
+                std::remove(path.c_str());
+                if (!this->stream) {
+                    throw std::runtime_error("cannot open the spill file " + path);
+                }
+            }
+
+            /// Appends a tuple.
+            void write(const std::vector<Register>& tuple, uint64_t hash) {
+                write_value<uint64_t>(this->stream, hash);
+                write_value<uint64_t>(this->stream, tuple.size());
+                for (auto& reg : tuple) {
+                    write_register(this->stream, reg);
+                }
+                if (!this->stream) {
+                    throw std::runtime_error("cannot write to a spill file");
+                }
+            }
+
+            /// Continues reading at the first tuple.
+            void rewind() {
+                this->stream.clear();
+                this->stream.seekg(0);
+            }
+
+            /// Reads the next tuple. The characters of long strings are kept
+            /// in `strings`. Returns false after the last tuple.
+            bool read(std::vector<Register>& tuple, uint64_t& hash, StringArena& strings) {
+                if (this->stream.peek() == std::char_traits<char>::eof()) {
+                    return false;
+                }
+                hash = read_value<uint64_t>(this->stream);
+                tuple.resize(read_value<uint64_t>(this->stream));
+                for (auto& reg : tuple) {
+                    reg = read_register(this->stream, strings);
+                }
+                return true;
             }
         };
 
 
+        void CancellationToken::cancel() {
+            this->cancelled = true;
+        }
+
+
+        void CancellationToken::set_deadline(std::chrono::steady_clock::time_point deadline) {
+            this->deadline = deadline.time_since_epoch().count();
+        }
+
+
+        void CancellationToken::set_timeout(std::chrono::steady_clock::duration timeout) {
+            this->set_deadline(std::chrono::steady_clock::now() + timeout);
+        }
+
+
+        bool CancellationToken::is_cancelled() const {
+            return this->cancelled;
+        }
+
+
+        bool CancellationToken::is_expired() const {
+            auto deadline = this->deadline.load();
+            return deadline != 0 && std::chrono::steady_clock::now().time_since_epoch().count() >= deadline;
+        }
+
+
+        void CancellationToken::check() const {
+            if (this->is_cancelled()) {
+                throw QueryInterrupted("query was cancelled");
+            }
+            if (this->is_expired()) {
+                throw QueryInterrupted("query deadline has passed");
+            }
+        }
+
+
         Register Register::from_int(int64_t value) {
+            return from_integer(Type::INT64, value);
+        }
+
+
+        Register Register::from_int32(int32_t value) {
+            return from_integer(Type::INT32, value);
+        }
+
+
+        Register Register::from_double(double value) {
+            Register reg{};
+            reg.type = Type::DOUBLE;
+            reg.doubleValue = value;
+            return reg;
+        }
+
+
+        Register Register::from_date(int32_t days) {
+            return from_integer(Type::DATE, days);
+        }
+
+
+        Register Register::from_decimal(int64_t unscaled_value) {
+            return from_integer(Type::DECIMAL, unscaled_value);
+        }
+
+
+        Register Register::from_integer(Type type, int64_t value) {
+            assert(type != Type::CHAR16 && type != Type::VARCHAR);
+            if (type == Type::DOUBLE) {
+                return from_double(static_cast<double>(value));
+            }
             Register reg{};
+            reg.type = type;
             reg.intValue = value;
             return reg;
         }
@@ -53,89 +590,209 @@ namespace moderndbs {
         }
 
 
+        Register Register::from_varchar(const GermanString& value) {
+            Register reg{};
+            reg.type = Type::VARCHAR;
+            reg.varcharValue = value;
+            return reg;
+        }
+
+
+        Register Register::from_varchar(const std::string& value, StringArena& arena) {
+            return from_varchar(arena.store(value));
+        }
+
+
         Register::Type Register::get_type() const {
-            if (this->intValue) {
-                return Type::INT64;
-            } else {
-                return  Type::CHAR16;
-            }
+            return this->type;
         }
 
 
         int64_t Register::as_int() const {
-            if (this->intValue) {
-                return *this->intValue;
-            } else {
-                return 0;
+            switch (this->type) {
+                case Type::CHAR16:
+                case Type::VARCHAR:
+                    return 0;
+                case Type::DOUBLE:
+                    return static_cast<int64_t>(this->doubleValue);
+                default:
+                    return this->intValue;
+            }
+        }
+
+
+        double Register::as_double() const {
+            switch (this->type) {
+                case Type::CHAR16:
+                case Type::VARCHAR:
+                    return 0;
+                case Type::DOUBLE:
+                    return this->doubleValue;
+                case Type::DECIMAL:
+                    return static_cast<double>(this->intValue) / decimal_factor;
+                default:
+                    return static_cast<double>(this->intValue);
             }
         }
 
 
         std::string Register::as_string() const {
-            if (this->stringValue) {
-                return *this->stringValue;
-            } else {
-                return std::string{};
+            if (this->type == Type::VARCHAR) {
+                return this->varcharValue.str();
+            }
+            return this->stringValue;
+        }
+
+
+        GermanString Register::as_varchar() const {
+            if (this->type == Type::VARCHAR) {
+                return this->varcharValue;
             }
+            return GermanString{};
+        }
+
+
+        std::string Register::to_string() const {
+            return to_string(*this, this->type);
+        }
+
+
+        std::string Register::to_string(const Register& reg, Type type) {
+            switch (type) {
+                case Type::INT64:
+                case Type::INT32:
+                    return std::to_string(reg.intValue);
+                case Type::CHAR16:
+                    return reg.stringValue;
+                case Type::VARCHAR:
+                    return reg.varcharValue.str();
+                case Type::DOUBLE: {
+                    std::ostringstream out;
+                    out << reg.doubleValue;
+                    return out.str();
+                }
+                case Type::DATE:
+                    return format_date(reg.intValue);
+                case Type::DECIMAL:
+                    return format_decimal(reg.intValue);
+            }
+            return {};
         }
 
 
         uint64_t Register::get_hash() const {
-            if (this->get_type() == Type::INT64) {
-                return std::hash<int64_t>{}(*this->intValue);
-            } else {
-                return std::hash<std::string>{}(*this->stringValue);
+            return hash(*this, this->type);
+        }
+
+
+        uint64_t Register::hash(const Register& reg, Type type) {
+            switch (type) {
+                case Type::CHAR16:
+                    return hash_bytes(reg.stringValue.data(), reg.stringValue.size());
+                case Type::VARCHAR:
+                    return reg.varcharValue.get_hash();
+                case Type::DOUBLE: {
+                    // 0.0 and -0.0 are equal.
+                    double value = reg.doubleValue == 0 ? 0.0 : reg.doubleValue;
+                    uint64_t bits = 0;
+                    std::memcpy(&bits, &value, sizeof(bits));
+                    return hash_int(bits);
+                }
+                default:
+                    return hash_int(static_cast<uint64_t>(reg.intValue));
             }
         }
 
 
         bool operator==(const Register& r1, const Register& r2) {
-            return r1.get_hash() == r2.get_hash();
+            if (r1.get_type() != r2.get_type()) {
+                return false;
+            }
+            return Register::equals(r1, r2, r1.get_type());
         }
 
 
         bool operator!=(const Register& r1, const Register& r2) {
-            return r1.get_hash() != r2.get_hash();
+            return !(r1 == r2);
         }
 
 
         bool operator<(const Register& r1, const Register& r2) {
             assert(r1.get_type() == r2.get_type());
-            if (r1.get_type() == Register::Type::INT64) {
-                return r1.as_int() < r2.as_int();
-            } else {
-                return r1.as_string().compare(r2.as_string()) < 0;
-            }
+            return Register::compare(r1, r2, r1.get_type()) < 0;
         }
 
 
         bool operator<=(const Register& r1, const Register& r2) {
             assert(r1.get_type() == r2.get_type());
-            if (r1.get_type() == Register::Type::INT64) {
-                return r1.as_int() <= r2.as_int();
-            } else {
-                return r1.as_string().compare(r2.as_string()) <= 0;
-            }
+            return Register::compare(r1, r2, r1.get_type()) <= 0;
         }
 
 
         bool operator>(const Register& r1, const Register& r2) {
             assert(r1.get_type() == r2.get_type());
-            if (r1.get_type() == Register::Type::INT64) {
-                return r1.as_int() > r2.as_int();
-            } else {
-                return r1.as_string().compare(r2.as_string()) > 0;
-            }
+            return Register::compare(r1, r2, r1.get_type()) > 0;
         }
 
 
         bool operator>=(const Register& r1, const Register& r2) {
             assert(r1.get_type() == r2.get_type());
-            if (r1.get_type() == Register::Type::INT64) {
-                return r1.as_int() >= r2.as_int();
-            } else {
-                return r1.as_string().compare(r2.as_string()) >= 0;
+            return Register::compare(r1, r2, r1.get_type()) >= 0;
+        }
+
+
+        int Register::compare(const Register& r1, const Register& r2, Type type) {
+            switch (type) {
+                case Type::CHAR16:
+                    return r1.stringValue.compare(r2.stringValue);
+                case Type::VARCHAR:
+                    return r1.varcharValue.compare(r2.varcharValue);
+                case Type::DOUBLE:
+                    return (r1.doubleValue > r2.doubleValue) - (r1.doubleValue < r2.doubleValue);
+                default:
+                    return (r1.intValue > r2.intValue) - (r1.intValue < r2.intValue);
+            }
+        }
+
+
+        bool Register::equals(const Register& r1, const Register& r2, Type type) {
+            switch (type) {
+                case Type::CHAR16:
+                    return r1.stringValue == r2.stringValue;
+                case Type::VARCHAR:
+                    return r1.varcharValue == r2.varcharValue;
+                case Type::DOUBLE:
+                    return r1.doubleValue == r2.doubleValue;
+                default:
+                    return r1.intValue == r2.intValue;
+            }
+        }
+
+
+        size_t Register::get_key_size(Type type) {
+            switch (type) {
+                case Type::CHAR16:
+                    return 16;
+                case Type::DOUBLE:
+                case Type::VARCHAR:
+                    return 0;
+                default:
+                    return sizeof(int64_t);
+            }
+        }
+
+
+        size_t Register::write_key(const Register& reg, Type type, char* key) {
+            if (type != Type::CHAR16) {
+                std::memcpy(key, &reg.intValue, sizeof(int64_t));
+                return 0;
             }
+            size_t length = reg.stringValue.size();
+            if (length <= 16) {
+                std::memcpy(key, reg.stringValue.data(), length);
+                std::memset(key + length, 0, 16 - length);
+            }
+            return length;
         }
 
 
@@ -154,12 +811,13 @@ namespace moderndbs {
         bool Print::next() {
             if (this->input->next()) {
                 std::vector<Register*> regs = this->input->get_output();
+                const Schema& types = this->input->get_schema();
                 std::string str = "";
-                for (auto& reg : regs) {
-                    if (reg->get_type() == Register::Type::INT64) {
-                        str += std::to_string(reg->as_int()) + ",";
+                for (size_t i = 0; i < regs.size(); ++i) {
+                    if (types.empty()) {
+                        str += regs[i]->to_string() + ",";
                     } else {
-                        str += reg->as_string() + ",";
+                        str += Register::to_string(*regs[i], types[i]) + ",";
                     }
                 }
                 if (regs.size() > 0) {
@@ -196,15 +854,34 @@ namespace moderndbs {
 
         void Projection::open() {
             this->input->open();
+            this->schema.clear();
+            const Schema& input_schema = this->input->get_schema();
+            if (!input_schema.empty()) {
+                for (auto attr_index : this->attr_indexes) {
+                    this->schema.push_back(input_schema[attr_index]);
+                }
+            }
+            // The carried hash stays valid when all its attributes are kept.
+            this->hash_attrs.clear();
+            for (size_t attr : this->input->get_hash_attrs()) {
+                auto position = std::find(this->attr_indexes.begin(), this->attr_indexes.end(), attr);
+                if (position == this->attr_indexes.end()) {
+                    this->hash_attrs.clear();
+                    break;
+                }
+                this->hash_attrs.push_back(position - this->attr_indexes.begin());
+            }
         }
 
 
         bool Projection::next() {
             if (this->input->next()) {
                 std::vector<Register*> regs = this->input->get_output();
+                this->output_regs.clear();
                 for (auto attr_index : this->attr_indexes) {
                     this->output_regs.push_back(*regs[attr_index]);
                 }
+                this->output_hash = this->input->get_output_hash();
                 return true;
             } else {
                 return false;
@@ -212,334 +889,2080 @@ namespace moderndbs {
         }
 
 
-        void Projection::close() {
-            this->input->close();
+        void Projection::close() {
+            this->input->close();
+        }
+
+
+        std::vector<Register*> Projection::get_output() {
+            std::vector<Register*> output;
+            for (auto& reg : this->output_regs) {
+                output.push_back(&reg);
+            }
+            return output;
+        }
+
+
+        Limit::Limit(Operator& input, size_t limit, size_t offset)
+                : UnaryOperator(input) {
+            this->limit = limit;
+            this->offset = offset;
+        }
+
+
+        Limit::~Limit() = default;
+
+
+        void Limit::open() {
+            this->input->open();
+            this->schema = this->input->get_schema();
+            this->hash_attrs = this->input->get_hash_attrs();
+            this->input_open = true;
+            this->skipped_count = 0;
+            this->produced_count = 0;
+        }
+
+
+        bool Limit::next() {
+            if (!this->input_open) {
+                return false;
+            }
+            if (this->produced_count == this->limit) {
+                // The output of the last tuple is no longer needed, so the
+                // input can stop early.
+                this->input->close();
+                this->input_open = false;
+                return false;
+            }
+            for (; this->skipped_count < this->offset; ++this->skipped_count) {
+                if (!this->input->next()) {
+                    return false;
+                }
+            }
+            if (!this->input->next()) {
+                return false;
+            }
+            this->output_hash = this->input->get_output_hash();
+            ++this->produced_count;
+            return true;
+        }
+
+
+        void Limit::close() {
+            if (this->input_open) {
+                this->input->close();
+                this->input_open = false;
+            }
+        }
+
+
+        std::vector<Register*> Limit::get_output() {
+            return this->input->get_output();
+        }
+
+
+        Select::Select(Operator& input, PredicateAttributeInt64 predicate)
+                : UnaryOperator(input) {
+            this->predicateAttribute = Select::PrecidateAttribute::INT;
+            this->intPredicate = predicate;
+            this->constant = Register::from_int(predicate.constant);
+        }
+
+
+        Select::Select(Operator& input, PredicateAttributeChar16 predicate)
+                : UnaryOperator(input) {
+            this->predicateAttribute = Select::PrecidateAttribute::CHAR;
+            this->constant = Register::from_string(predicate.constant);
+            this->charPredicate = std::move(predicate);
+        }
+
+
+        Select::Select(Operator& input, PredicateAttributeValue predicate)
+                : UnaryOperator(input) {
+            this->predicateAttribute = Select::PrecidateAttribute::VALUE;
+            this->constant = predicate.constant;
+            this->valuePredicate = std::move(predicate);
+        }
+
+
+        Select::Select(Operator& input, PredicateAttributeAttribute predicate)
+                : UnaryOperator(input) {
+            this->predicateAttribute = Select::PrecidateAttribute::ATTRIBUTE;
+            this->attributePredicate = predicate;
+        }
+
+
+        Select::~Select() = default;
+
+
+        void Select::set_constant(const Register& constant) {
+            switch (this->predicateAttribute) {
+                case PrecidateAttribute::INT :
+                    this->intPredicate.constant = constant.as_int();
+                    break;
+                case PrecidateAttribute::CHAR :
+                    this->charPredicate.constant = constant.as_string();
+                    break;
+                case PrecidateAttribute::VALUE :
+                    this->valuePredicate.constant = constant;
+                    break;
+                case PrecidateAttribute::ATTRIBUTE :
+                    assert(false);
+                    return;
+            }
+            this->constant = constant;
+        }
+
+
+        void Select::open() {
+            this->input->open();
+            this->schema = this->input->get_schema();
+            this->hash_attrs = this->input->get_hash_attrs();
+            this->batch.clear();
+            this->batch_hashes.resize(batch_size);
+            this->matches.resize(batch_size);
+            this->selection.resize(batch_size);
+            this->selected_count = 0;
+            this->selected_index = 0;
+            this->selectivity = 0;
+            this->batch_count = 0;
+            this->predicated_count = 0;
+            switch (this->predicateAttribute) {
+                case PrecidateAttribute::INT :
+                    this->left_index = this->intPredicate.attr_index;
+                    this->predicate_type = this->intPredicate.predicate_type;
+                    break;
+                case PrecidateAttribute::CHAR :
+                    this->left_index = this->charPredicate.attr_index;
+                    this->predicate_type = this->charPredicate.predicate_type;
+                    break;
+                case PrecidateAttribute::VALUE :
+                    this->left_index = this->valuePredicate.attr_index;
+                    this->predicate_type = this->valuePredicate.predicate_type;
+                    break;
+                case PrecidateAttribute::ATTRIBUTE :
+                    this->left_index = this->attributePredicate.attr_left_index;
+                    this->right_index = this->attributePredicate.attr_right_index;
+                    this->predicate_type = this->attributePredicate.predicate_type;
+                    break;
+            }
+            this->is_typed = false;
+            if (this->schema.empty()) {
+                return;
+            }
+            this->compare_type = this->schema[this->left_index];
+            if (this->predicateAttribute != PrecidateAttribute::ATTRIBUTE) {
+                // Integer constants are given as INT64 for attributes of any
+                // integer width, and string constants as CHAR16 or VARCHAR.
+                if (this->constant.get_type() != this->compare_type) {
+                    this->constant = coerce_constant(this->constant, this->compare_type, this->strings);
+                }
+                this->is_typed = true;
+                return;
+            }
+            Register::Type right_type = this->schema[this->right_index];
+            if (is_integer_type(this->compare_type) && is_integer_type(right_type)) {
+                this->compare_type = Register::Type::INT64;
+            } else if (this->compare_type != right_type) {
+                throw std::invalid_argument("the attributes of the predicate have different types");
+            }
+            this->is_typed = true;
+        }
+
+
+        bool Select::filter_batch() {
+            // Copy the batch, the input overwrites its output registers.
+            size_t count = 0;
+            while (count < batch_size && this->input->next()) {
+                this->check_interrupted();
+                std::vector<Register*> regs = this->input->get_output();
+                if (this->batch.empty()) {
+                    this->arity = regs.size();
+                    this->batch.resize(batch_size * this->arity);
+                }
+                Register* tuple = &this->batch[count * this->arity];
+                for (size_t i = 0; i < this->arity; ++i) {
+                    tuple[i] = *regs[i];
+                }
+                this->batch_hashes[count] = this->input->get_output_hash();
+                ++count;
+            }
+            if (count == 0) {
+                return false;
+            }
+
+            bool right_attribute = this->predicateAttribute == PrecidateAttribute::ATTRIBUTE;
+            for (size_t i = 0; i < count; ++i) {
+                const Register* tuple = &this->batch[i * this->arity];
+                const Register& left = tuple[this->left_index];
+                const Register& right = right_attribute ? tuple[this->right_index] : this->constant;
+                this->matches[i] = this->is_typed
+                    ? evaluate_comparison(Register::compare(left, right, this->compare_type), this->predicate_type)
+                    : evaluate_predicate(left, right, this->predicate_type);
+            }
+
+            // Around half of the tuples matching is when a branch on the
+            // outcome is mispredicted most often.
+            bool predicated = this->mode == Mode::PREDICATED
+                || (this->mode == Mode::ADAPTIVE
+                    && this->selectivity >= min_predicated_selectivity
+                    && this->selectivity <= max_predicated_selectivity);
+            this->selected_count = predicated
+                ? select_predicated(this->matches.data(), count, this->selection.data())
+                : select_branching(this->matches.data(), count, this->selection.data());
+            this->selected_index = 0;
+            this->selectivity = static_cast<double>(this->selected_count) / static_cast<double>(count);
+            ++this->batch_count;
+            if (predicated) {
+                ++this->predicated_count;
+            }
+            return true;
+        }
+
+
+        bool Select::next() {
+            while (this->selected_index == this->selected_count) {
+                if (!this->filter_batch()) {
+                    return false;
+                }
+            }
+            this->output_index = this->selection[this->selected_index++];
+            this->output_hash = this->batch_hashes[this->output_index];
+            return true;
+        }
+
+
+        void Select::close() {
+            this->input->close();
+            this->batch.clear();
+        }
+
+
+        std::vector<Register*> Select::get_output() {
+            std::vector<Register*> output;
+            Register* tuple = this->batch.data() + this->output_index * this->arity;
+            for (size_t i = 0; i < this->arity; ++i) {
+                output.push_back(&tuple[i]);
+            }
+            return output;
+        }
+
+
+        Sort::Sort(Operator& input, std::vector<Criterion> criteria)
+                : UnaryOperator(input) {
+            this->criteria = std::move(criteria);
+        }
+
+
+        Sort::~Sort() = default;
+
+
+        void Sort::open() {
+            this->input->open();
+            this->schema = this->input->get_schema();
+        }
+
+
+        bool Sort::next() {
+            this->output_regs.clear();
+            if (!this->isMaterialized) {
+                while (this->input->next()) {
+                    this->check_interrupted();
+                    std::vector<Register*> regs = this->input->get_output();
+                    std::vector<Register> output_regs;
+                    output_regs.reserve(regs.size());
+                    for (auto& reg : regs) {
+                        output_regs.push_back(*reg);
+                    }
+                    this->registers.push_back(output_regs);
+                }
+                if (this->token != nullptr) {
+                    this->token->check();
+                }
+                std::stable_sort(this->registers.begin(), this->registers.end(),
+                                 [this](const std::vector<Register>& regs1, const std::vector<Register>& regs2) {
+                                     return compare_tuples(regs1, regs2, this->criteria, this->schema) < 0;
+                                 });
+                this->isMaterialized = true;
+            }
+            if (this->current_index < this->registers.size()) {
+                auto regs = this->registers[this->current_index];
+                for (auto& r : regs) {
+                    this->output_regs.push_back(r);
+                }
+                ++this->current_index;
+                return true;
+            }
+            return false;
+        }
+
+
+        std::vector<Register*> Sort::get_output() {
+            std::vector<Register*> output;
+            output.reserve(this->output_regs.size());
+            for (auto& reg : this->output_regs) {
+                output.push_back(&reg);
+            }
+            return output;
+        }
+
+
+        void Sort::close() {
+            this->input->close();
+            this->registers.clear();
+            this->registers.shrink_to_fit();
+            this->isMaterialized = false;
+            this->current_index = 0;
+        }
+
+
+        Window::Frame Window::Frame::running() {
+            return Frame{};
+        }
+
+
+        Window::Frame Window::Frame::partition() {
+            Frame frame;
+            frame.unbounded_following = true;
+            return frame;
+        }
+
+
+        Window::Frame Window::Frame::rows(size_t preceding, size_t following) {
+            Frame frame;
+            frame.unbounded_preceding = false;
+            frame.preceding = preceding;
+            frame.following = following;
+            return frame;
+        }
+
+
+        Window::Function Window::Function::row_number() {
+            Function function;
+            function.kind = ROW_NUMBER;
+            return function;
+        }
+
+
+        Window::Function Window::Function::rank() {
+            Function function;
+            function.kind = RANK;
+            return function;
+        }
+
+
+        Window::Function Window::Function::dense_rank() {
+            Function function;
+            function.kind = DENSE_RANK;
+            return function;
+        }
+
+
+        Window::Function Window::Function::lag(size_t attr_index, size_t offset, Register default_value) {
+            Function function;
+            function.kind = LAG;
+            function.attr_index = attr_index;
+            function.offset = offset;
+            function.default_value = std::move(default_value);
+            return function;
+        }
+
+
+        Window::Function Window::Function::lead(size_t attr_index, size_t offset, Register default_value) {
+            Function function = lag(attr_index, offset, std::move(default_value));
+            function.kind = LEAD;
+            return function;
+        }
+
+
+        Window::Function Window::Function::sum(size_t attr_index, Frame frame) {
+            Function function;
+            function.kind = SUM;
+            function.attr_index = attr_index;
+            function.frame = frame;
+            return function;
+        }
+
+
+        Window::Function Window::Function::min(size_t attr_index, Frame frame) {
+            Function function = sum(attr_index, frame);
+            function.kind = MIN;
+            return function;
+        }
+
+
+        Window::Function Window::Function::max(size_t attr_index, Frame frame) {
+            Function function = sum(attr_index, frame);
+            function.kind = MAX;
+            return function;
+        }
+
+
+        Window::Function Window::Function::count(Frame frame) {
+            Function function;
+            function.kind = COUNT;
+            function.frame = frame;
+            return function;
+        }
+
+
+        Window::Window(
+                Operator& input,
+                std::vector<size_t> partition_attrs,
+                std::vector<Sort::Criterion> order,
+                std::vector<Function> functions,
+                size_t thread_count
+        ) : UnaryOperator(input) {
+            this->partition_attrs = std::move(partition_attrs);
+            this->order = std::move(order);
+            this->functions = std::move(functions);
+            this->thread_count = std::max<size_t>(thread_count, 1);
+        }
+
+
+        Window::~Window() = default;
+
+
+        void Window::open() {
+            this->input->open();
+            this->schema = this->input->get_schema();
+            if (this->schema.empty()) {
+                return;
+            }
+            for (auto& function : this->functions) {
+                switch (function.kind) {
+                    case Function::LAG:
+                    case Function::LEAD:
+                    case Function::MIN:
+                    case Function::MAX:
+                        this->schema.push_back(this->schema[function.attr_index]);
+                        break;
+                    case Function::SUM:
+                        this->schema.push_back(get_sum_type(this->schema[function.attr_index]));
+                        break;
+                    default:
+                        this->schema.push_back(Register::Type::INT64);
+                        break;
+                }
+            }
+        }
+
+
+        void Window::compute_partition(size_t begin, size_t end) {
+            size_t arity = this->tuples[begin].size() - this->functions.size();
+            for (size_t f = 0; f < this->functions.size(); ++f) {
+                auto& function = this->functions[f];
+                auto& frame = function.frame;
+                size_t output = arity + f;
+                switch (function.kind) {
+                    case Function::ROW_NUMBER:
+                    case Function::RANK:
+                    case Function::DENSE_RANK: {
+                        int64_t rank = 0;
+                        int64_t dense_rank = 0;
+                        for (size_t i = begin; i < end; ++i) {
+                            // Peers are rows that are equal in the order criteria.
+                            if (i == begin || compare_tuples(this->tuples[i - 1], this->tuples[i], this->order, this->schema) != 0) {
+                                rank = static_cast<int64_t>(i - begin) + 1;
+                                ++dense_rank;
+                            }
+                            int64_t value = function.kind == Function::ROW_NUMBER
+                                ? static_cast<int64_t>(i - begin) + 1
+                                : function.kind == Function::RANK ? rank : dense_rank;
+                            this->tuples[i][output] = Register::from_int(value);
+                        }
+                        break;
+                    }
+                    case Function::LAG:
+                    case Function::LEAD:
+                        for (size_t i = begin; i < end; ++i) {
+                            bool inside = function.kind == Function::LAG
+                                ? i - begin >= function.offset
+                                : end - i > function.offset;
+                            if (!inside) {
+                                this->tuples[i][output] = function.default_value;
+                            } else if (function.kind == Function::LAG) {
+                                this->tuples[i][output] = this->tuples[i - function.offset][function.attr_index];
+                            } else {
+                                this->tuples[i][output] = this->tuples[i + function.offset][function.attr_index];
+                            }
+                        }
+                        break;
+                    case Function::COUNT:
+                        for (size_t i = begin; i < end; ++i) {
+                            size_t first = frame.unbounded_preceding ? begin : std::max(begin, i - std::min(i, frame.preceding));
+                            size_t last = frame.unbounded_following ? end : std::min(end, i + frame.following + 1);
+                            this->tuples[i][output] = Register::from_int(static_cast<int64_t>(last - first));
+                        }
+                        break;
+                    case Function::SUM:
+                    case Function::MIN:
+                    case Function::MAX: {
+                        // SUM combines values that were converted with
+                        // `to_sum()`, so that the results have the sum type
+                        // even for frames of a single row.
+                        auto value = [&function](const Register& reg) {
+                            return function.kind == Function::SUM ? to_sum(reg) : reg;
+                        };
+                        auto combine = [&function](const Register& left, const Register& right) {
+                            switch (function.kind) {
+                                case Function::SUM:
+                                    return add_sums(left, right);
+                                case Function::MIN:
+                                    return right < left ? right : left;
+                                default:
+                                    return left < right ? right : left;
+                            }
+                        };
+                        if (frame.unbounded_preceding) {
+                            // The frame only grows, so the aggregate of the
+                            // previous row is extended by the new rows.
+                            Register aggregate = value(this->tuples[begin][function.attr_index]);
+                            size_t last = begin + 1;
+                            for (size_t i = begin; i < end; ++i) {
+                                size_t frame_end = frame.unbounded_following ? end : std::min(end, i + frame.following + 1);
+                                for (; last < frame_end; ++last) {
+                                    aggregate = combine(aggregate, value(this->tuples[last][function.attr_index]));
+                                }
+                                this->tuples[i][output] = aggregate;
+                            }
+                        } else {
+                            std::vector<Register> values;
+                            values.reserve(end - begin);
+                            for (size_t i = begin; i < end; ++i) {
+                                values.push_back(value(this->tuples[i][function.attr_index]));
+                            }
+                            auto tree = make_segment_tree(std::move(values), combine);
+                            for (size_t i = begin; i < end; ++i) {
+                                size_t first = i - begin - std::min(i - begin, frame.preceding);
+                                size_t last = frame.unbounded_following ? end - begin : std::min(end - begin, i - begin + frame.following + 1);
+                                this->tuples[i][output] = tree.query(first, last);
+                            }
+                        }
+                        break;
+                    }
+                }
+            }
+        }
+
+
+        bool Window::next() {
+            if (!this->isMaterialized) {
+                while (this->input->next()) {
+                    this->check_interrupted();
+                    std::vector<Register*> regs = this->input->get_output();
+                    std::vector<Register> tuple;
+                    tuple.reserve(regs.size() + this->functions.size());
+                    for (auto* reg : regs) {
+                        tuple.push_back(*reg);
+                    }
+                    tuple.resize(regs.size() + this->functions.size());
+                    this->tuples.push_back(std::move(tuple));
+                }
+                if (this->token != nullptr) {
+                    this->token->check();
+                }
+
+                std::vector<Sort::Criterion> criteria;
+                for (size_t attr : this->partition_attrs) {
+                    criteria.push_back(Sort::Criterion{attr, false});
+                }
+                criteria.insert(criteria.end(), this->order.begin(), this->order.end());
+                std::stable_sort(this->tuples.begin(), this->tuples.end(),
+                                 [this, &criteria](const std::vector<Register>& tuple1, const std::vector<Register>& tuple2) {
+                                     return compare_tuples(tuple1, tuple2, criteria, this->schema) < 0;
+                                 });
+
+                std::vector<Sort::Criterion> partition_criteria(criteria.begin(), criteria.begin() + this->partition_attrs.size());
+                std::vector<size_t> partition_begins;
+                for (size_t i = 0; i < this->tuples.size(); ++i) {
+                    if (i == 0 || compare_tuples(this->tuples[i - 1], this->tuples[i], partition_criteria, this->schema) != 0) {
+                        partition_begins.push_back(i);
+                    }
+                }
+                partition_begins.push_back(this->tuples.size());
+
+                // The threads take the next unprocessed partition until all are
+                // done. They stop early when the query is interrupted.
+                size_t partition_count = partition_begins.size() - 1;
+                std::atomic<size_t> next_partition{0};
+                auto work = [&]() {
+                    for (size_t p = next_partition++; p < partition_count; p = next_partition++) {
+                        if (this->token != nullptr && (this->token->is_cancelled() || this->token->is_expired())) {
+                            return;
+                        }
+                        this->compute_partition(partition_begins[p], partition_begins[p + 1]);
+                    }
+                };
+                size_t worker_count = std::min(this->thread_count, partition_count);
+                std::vector<std::thread> workers;
+                for (size_t i = 1; i < worker_count; ++i) {
+                    workers.emplace_back(work);
+                }
+                work();
+                for (auto& worker : workers) {
+                    worker.join();
+                }
+                if (this->token != nullptr) {
+                    this->token->check();
+                }
+                this->isMaterialized = true;
+            }
+            if (this->current_index < this->tuples.size()) {
+                this->output_regs = this->tuples[this->current_index];
+                ++this->current_index;
+                return true;
+            }
+            return false;
+        }
+
+
+        std::vector<Register*> Window::get_output() {
+            std::vector<Register*> output;
+            output.reserve(this->output_regs.size());
+            for (auto& reg : this->output_regs) {
+                output.push_back(&reg);
+            }
+            return output;
+        }
+
+
+        void Window::close() {
+            this->input->close();
+            this->tuples.clear();
+            this->tuples.shrink_to_fit();
+            this->output_regs.clear();
+            this->isMaterialized = false;
+            this->current_index = 0;
+        }
+
+
+        HashJoin::HashJoin(
+                Operator& input_left,
+                Operator& input_right,
+                size_t attr_index_left,
+                size_t attr_index_right,
+                Type type
+        ) : BinaryOperator(input_left, input_right) {
+            this->attr_index_left = attr_index_left;
+            this->attr_index_right = attr_index_right;
+            this->type = type;
+        }
+
+
+        HashJoin::~HashJoin() = default;
+
+
+        void HashJoin::open() {
+            this->input_left->open();
+            this->input_right->open();
+            this->isMaterialized = false;
+            this->isProbed = false;
+            this->probe_tuples.resize(probe_group_size);
+            this->registers.clear();
+            this->register_hashes.clear();
+            this->current_index = 0;
+            this->spilled = false;
+            this->spilled_build.clear();
+            this->spilled_probe.clear();
+            this->spill_index = 0;
+
+            const Schema& left_schema = this->input_left->get_schema();
+            const Schema& right_schema = this->input_right->get_schema();
+            this->is_typed = !left_schema.empty() && !right_schema.empty()
+                && left_schema[this->attr_index_left] == right_schema[this->attr_index_right];
+            if (this->is_typed) {
+                this->key_type = left_schema[this->attr_index_left];
+            }
+            this->reuse_left_hash = this->input_left->get_hash_attrs() == std::vector<size_t>{this->attr_index_left};
+            this->reuse_right_hash = this->input_right->get_hash_attrs() == std::vector<size_t>{this->attr_index_right};
+            this->hash_attrs = {this->attr_index_left};
+            this->schema.clear();
+            if (this->type != Type::INNER) {
+                this->schema = left_schema;
+            } else if (!left_schema.empty() && !right_schema.empty()) {
+                this->schema = left_schema;
+                this->schema.insert(this->schema.end(), right_schema.begin(), right_schema.end());
+            }
+        }
+
+
+        void HashJoin::build() {
+            this->build_tuples.clear();
+            this->build_hashes.clear();
+            // The estimated bytes of the build tuples with their hash values,
+            // chain entries and buckets.
+            size_t bytes = 0;
+            while (this->input_left->next()) {
+                this->check_interrupted();
+                std::vector<Register> regs;
+                for (auto& reg : this->input_left->get_output()) {
+                    regs.push_back(*reg);
+                }
+                const Register& key = regs[this->attr_index_left];
+                uint64_t hash = this->input_left->get_output_hash();
+                if (!this->reuse_left_hash) {
+                    hash = this->is_typed ? Register::hash(key, this->key_type) : key.get_hash();
+                }
+                if (this->is_spilled()) {
+                    this->spilled_build[(hash >> 32U) & ((1U << spill_bits) - 1)]->write(regs, hash);
+                    continue;
+                }
+                bytes += sizeof(regs) + regs.size() * sizeof(Register) + 4 * sizeof(size_t);
+                this->build_hashes.push_back(hash);
+                this->build_tuples.push_back(std::move(regs));
+                if (this->memory_budget != 0 && bytes > this->memory_budget) {
+                    this->start_spilling();
+                }
+            }
+            if (!this->is_spilled()) {
+                this->index_build_side();
+            }
+        }
+
+
+        void HashJoin::index_build_side() {
+            size_t count = this->build_tuples.size();
+            if (this->type != Type::INNER) {
+                this->matched.assign(count, false);
+            }
+            if (count <= max_scan_size) {
+                this->strategy = Strategy::SCAN;
+                this->buckets.clear();
+                this->chain.clear();
+                return;
+            }
+
+            this->partition_offsets.clear();
+            if (count <= max_chained_size) {
+                this->strategy = Strategy::CHAINED;
+                this->buckets.assign(directory_size(count), 0);
+            } else {
+                // Reorder the build tuples by partition, so that each directory
+                // is built from consecutive tuples.
+                this->strategy = Strategy::PARTITIONED;
+                size_t partition_bits = 1;
+                while ((count >> partition_bits) > partition_size) {
+                    ++partition_bits;
+                }
+                size_t partition_count = size_t{1} << partition_bits;
+                this->partition_shift = 64 - partition_bits;
+                std::vector<size_t> positions(partition_count + 1, 0);
+                for (uint64_t hash : this->build_hashes) {
+                    ++positions[(hash >> this->partition_shift) + 1];
+                }
+                this->partition_offsets.assign(partition_count + 1, 0);
+                for (size_t p = 0; p < partition_count; ++p) {
+                    this->partition_offsets[p + 1] = this->partition_offsets[p] + directory_size(positions[p + 1]);
+                    positions[p + 1] += positions[p];
+                }
+                std::vector<std::vector<Register>> tuples(count);
+                std::vector<uint64_t> hashes(count);
+                for (size_t i = 0; i < count; ++i) {
+                    size_t position = positions[this->build_hashes[i] >> this->partition_shift]++;
+                    tuples[position] = std::move(this->build_tuples[i]);
+                    hashes[position] = this->build_hashes[i];
+                }
+                this->build_tuples = std::move(tuples);
+                this->build_hashes = std::move(hashes);
+                this->buckets.assign(this->partition_offsets.back(), 0);
+            }
+
+            this->chain.assign(count, 0);
+            for (size_t i = 0; i < count; ++i) {
+                size_t& head = this->buckets[this->get_bucket(this->build_hashes[i])];
+                this->chain[i] = head;
+                head = i + 1;
+            }
+        }
+
+
+        size_t HashJoin::get_bucket(uint64_t hash) const {
+            if (this->strategy == Strategy::PARTITIONED) {
+                size_t partition = hash >> this->partition_shift;
+                size_t offset = this->partition_offsets[partition];
+                return offset + (hash & (this->partition_offsets[partition + 1] - offset - 1));
+            }
+            return hash & (this->buckets.size() - 1);
+        }
+
+
+        void HashJoin::start_spilling() {
+            this->spilled = true;
+            for (size_t i = 0; i < (size_t{1} << spill_bits); ++i) {
+                this->spilled_build.push_back(std::make_unique<SpillFile>());
+                this->spilled_probe.push_back(std::make_unique<SpillFile>());
+            }
+            for (size_t i = 0; i < this->build_tuples.size(); ++i) {
+                uint64_t hash = this->build_hashes[i];
+                this->spilled_build[(hash >> 32U) & ((1U << spill_bits) - 1)]->write(this->build_tuples[i], hash);
+            }
+            this->build_tuples.clear();
+            this->build_tuples.shrink_to_fit();
+            this->build_hashes.clear();
+            this->build_hashes.shrink_to_fit();
+        }
+
+
+        bool HashJoin::load_spilled_partition() {
+            if (!this->is_spilled()) {
+                return false;
+            }
+            if (this->spill_index == 0) {
+                std::vector<Register> tuple;
+                while (this->input_right->next()) {
+                    this->check_interrupted();
+                    std::vector<Register*> regs = this->input_right->get_output();
+                    tuple.resize(regs.size());
+                    for (size_t i = 0; i < regs.size(); ++i) {
+                        tuple[i] = *regs[i];
+                    }
+                    const Register& key = tuple[this->attr_index_right];
+                    uint64_t hash = this->input_right->get_output_hash();
+                    if (!this->reuse_right_hash) {
+                        hash = this->is_typed ? Register::hash(key, this->key_type) : key.get_hash();
+                    }
+                    this->spilled_probe[(hash >> 32U) & ((1U << spill_bits) - 1)]->write(tuple, hash);
+                }
+            } else {
+                // The previous partition is done.
+                this->spilled_build[this->spill_index - 1].reset();
+                this->spilled_probe[this->spill_index - 1].reset();
+            }
+            if (this->spill_index == this->spilled_build.size()) {
+                return false;
+            }
+
+            this->build_tuples.clear();
+            this->build_hashes.clear();
+            auto& file = *this->spilled_build[this->spill_index];
+            file.rewind();
+            std::vector<Register> tuple;
+            uint64_t hash = 0;
+            while (file.read(tuple, hash, this->spill_strings)) {
+                this->check_interrupted();
+                this->build_tuples.push_back(tuple);
+                this->build_hashes.push_back(hash);
+            }
+            this->spilled_probe[this->spill_index]->rewind();
+            ++this->spill_index;
+            this->index_build_side();
+            this->isProbed = false;
+            this->registers.clear();
+            this->register_hashes.clear();
+            this->current_index = 0;
+            return true;
+        }
+
+
+        void HashJoin::join_tuples(size_t build_index, const std::vector<Register>& probe_tuple, uint64_t hash) {
+            auto& build_tuple = this->build_tuples[build_index];
+            const Register& build_key = build_tuple[this->attr_index_left];
+            const Register& probe_key = probe_tuple[this->attr_index_right];
+            bool equal = this->is_typed
+                ? Register::equals(build_key, probe_key, this->key_type)
+                : build_key == probe_key;
+            if (!equal) {
+                return;
+            }
+            if (this->type != Type::INNER) {
+                this->matched[build_index] = true;
+                return;
+            }
+            std::vector<Register> joined;
+            joined.reserve(build_tuple.size() + probe_tuple.size());
+            joined.insert(joined.end(), build_tuple.begin(), build_tuple.end());
+            joined.insert(joined.end(), probe_tuple.begin(), probe_tuple.end());
+            this->registers.push_back(std::move(joined));
+            this->register_hashes.push_back(hash);
+        }
+
+
+        bool HashJoin::probe_group() {
+            std::array<uint64_t, probe_group_size> probe_hashes{};
+            std::array<size_t, probe_group_size> heads{};
+
+            // Stage 1: fetch the group, hash its keys and prefetch the buckets.
+            size_t count = 0;
+            if (this->is_spilled()) {
+                if (this->spill_index == 0) {
+                    return false;
+                }
+                auto& file = *this->spilled_probe[this->spill_index - 1];
+                while (count < probe_group_size
+                        && file.read(this->probe_tuples[count], probe_hashes[count], this->spill_strings)) {
+                    ++count;
+                }
+            } else {
+                while (count < probe_group_size && this->input_right->next()) {
+                    this->check_interrupted();
+                    std::vector<Register*> regs = this->input_right->get_output();
+                    auto& tuple = this->probe_tuples[count];
+                    tuple.resize(regs.size());
+                    for (size_t i = 0; i < regs.size(); ++i) {
+                        tuple[i] = *regs[i];
+                    }
+                    if (this->reuse_right_hash) {
+                        probe_hashes[count] = this->input_right->get_output_hash();
+                    } else {
+                        const Register& key = tuple[this->attr_index_right];
+                        probe_hashes[count] = this->is_typed ? Register::hash(key, this->key_type) : key.get_hash();
+                    }
+                    ++count;
+                }
+            }
+            if (count == 0) {
+                return false;
+            }
+
+            // A scanned build side fits into a few cache lines.
+            if (this->strategy == Strategy::SCAN) {
+                for (size_t i = 0; i < count; ++i) {
+                    for (size_t entry = 0; entry < this->build_tuples.size(); ++entry) {
+                        if (this->build_hashes[entry] == probe_hashes[i]) {
+                            this->join_tuples(entry, this->probe_tuples[i], probe_hashes[i]);
+                        }
+                    }
+                }
+                return true;
+            }
+
+            std::array<size_t, probe_group_size> slots{};
+            for (size_t i = 0; i < count; ++i) {
+                slots[i] = this->get_bucket(probe_hashes[i]);
+                __builtin_prefetch(&this->buckets[slots[i]]);
+            }
+
+            // Stage 2: load the bucket heads and prefetch the first entries.
+            for (size_t i = 0; i < count; ++i) {
+                heads[i] = this->buckets[slots[i]];
+                if (heads[i] != 0) {
+                    __builtin_prefetch(&this->build_hashes[heads[i] - 1]);
+                    __builtin_prefetch(&this->build_tuples[heads[i] - 1]);
+                }
+            }
+
+            // Stage 3: walk the chains, their first entries are cached by now.
+            for (size_t i = 0; i < count; ++i) {
+                for (size_t entry = heads[i]; entry != 0; entry = this->chain[entry - 1]) {
+                    if (this->build_hashes[entry - 1] == probe_hashes[i]) {
+                        this->join_tuples(entry - 1, this->probe_tuples[i], probe_hashes[i]);
+                    }
+                }
+            }
+            return true;
+        }
+
+
+        bool HashJoin::next() {
+            if (!this->isMaterialized) {
+                this->build();
+                this->isMaterialized = true;
+            }
+            // Without spilling, the loop joins the only build side. Otherwise
+            // it joins the spilled partitions one after another.
+            while (true) {
+                if (this->type != Type::INNER) {
+                    if (!this->isProbed) {
+                        while (this->probe_group()) {}
+                        this->isProbed = true;
+                    }
+                    // Emit the build tuples with (SEMI) or without (ANTI) partner.
+                    while (this->current_index < this->build_tuples.size()) {
+                        size_t index = this->current_index++;
+                        if (this->matched[index] == (this->type == Type::SEMI)) {
+                            this->output_regs = this->build_tuples[index];
+                            this->output_hash = this->build_hashes[index];
+                            return true;
+                        }
+                    }
+                } else {
+                    while (this->current_index >= this->registers.size()) {
+                        this->registers.clear();
+                        this->register_hashes.clear();
+                        this->current_index = 0;
+                        if (!this->probe_group()) {
+                            break;
+                        }
+                    }
+                    if (this->current_index < this->registers.size()) {
+                        this->output_regs = std::move(this->registers[this->current_index]);
+                        this->output_hash = this->register_hashes[this->current_index];
+                        ++this->current_index;
+                        return true;
+                    }
+                }
+                if (!this->load_spilled_partition()) {
+                    return false;
+                }
+            }
+        }
+
+
+        void HashJoin::close() {
+            this->input_left->close();
+            this->input_right->close();
+            this->build_tuples.clear();
+            this->build_tuples.shrink_to_fit();
+            this->build_hashes.clear();
+            this->build_hashes.shrink_to_fit();
+            this->buckets.clear();
+            this->buckets.shrink_to_fit();
+            this->chain.clear();
+            this->chain.shrink_to_fit();
+            this->partition_offsets.clear();
+            this->matched.clear();
+            this->matched.shrink_to_fit();
+            this->registers.clear();
+            this->register_hashes.clear();
+            this->spilled_build.clear();
+            this->spilled_probe.clear();
+            this->spill_strings = StringArena();
+        }
+
+
+        std::vector<Register*> HashJoin::get_output() {
+            std::vector<Register*> output;
+            for (auto& reg : this->output_regs) {
+                output.push_back(&reg);
+            }
+            return output;
+        }
+
+
+        HashAggregation::HashAggregation(
+                Operator& input,
+                std::vector<size_t> group_by_attrs,
+                std::vector<AggrFunc> aggr_funcs,
+                size_t thread_count
+        ) : UnaryOperator(input) {
+            this->state = std::make_unique<AggregationState>(std::move(group_by_attrs), std::move(aggr_funcs));
+            this->thread_count = std::max<size_t>(thread_count, 1);
+        }
+
+
+        HashAggregation::~HashAggregation() = default;
+
+
+        void HashAggregation::set_key_range(int64_t min, int64_t max) {
+            this->state->set_key_range(min, max);
+        }
+
+
+        void HashAggregation::open() {
+            this->input->open();
+            this->isMaterialized = false;
+            this->counter_index = 0;
+            this->partition_index = 0;
+            this->bypassed_count = 0;
+            this->state->clear();
+            this->state->set_input_schema(this->input->get_schema());
+            this->schema = this->state->get_schema();
+            const std::vector<size_t>& input_hash_attrs = this->input->get_hash_attrs();
+            this->reuse_hash = !input_hash_attrs.empty() && input_hash_attrs == this->state->get_group_by_attrs();
+            this->hash_attrs.clear();
+            for (size_t k = 0; k < this->state->get_group_by_attrs().size(); ++k) {
+                this->hash_attrs.push_back(k);
+            }
+        }
+
+
+        void HashAggregation::aggregate() {
+            std::vector<std::vector<Register>> tuples(probe_group_size);
+            std::array<uint64_t, probe_group_size> hashes{};
+            while (true) {
+                size_t count = 0;
+                while (count < probe_group_size && this->input->next()) {
+                    this->check_interrupted();
+                    std::vector<Register*> regs = this->input->get_output();
+                    auto& tuple = tuples[count];
+                    tuple.resize(regs.size());
+                    for (size_t i = 0; i < regs.size(); ++i) {
+                        tuple[i] = *regs[i];
+                    }
+                    hashes[count] = this->input->get_output_hash();
+                    ++count;
+                }
+                if (count == 0) {
+                    break;
+                }
+                this->state->insert(tuples, count, this->reuse_hash ? hashes.data() : nullptr);
+            }
+            this->state->finalize();
+        }
+
+
+        void HashAggregation::aggregate_partitioned() {
+            size_t partition_count = size_t{1} << partition_bits;
+            this->partitions.clear();
+            for (size_t p = 0; p < partition_count; ++p) {
+                this->partitions.push_back(this->state->create_empty());
+            }
+            const std::vector<size_t>& group_by_attrs = this->state->get_group_by_attrs();
+            Schema key_types;
+            if (!this->schema.empty()) {
+                key_types.assign(this->schema.begin(), this->schema.begin() + group_by_attrs.size());
+            }
+
+            // The pre-aggregated tuples of a partition are collected until
+            // they fill a probe group, the others are kept for the threads.
+            std::vector<std::vector<std::vector<Register>>> staged(
+                partition_count, std::vector<std::vector<Register>>(probe_group_size));
+            std::vector<std::array<uint64_t, probe_group_size>> staged_hashes(partition_count);
+            std::vector<size_t> staged_counts(partition_count, 0);
+            std::vector<std::vector<std::vector<Register>>> bypassed(partition_count);
+            std::vector<std::vector<uint64_t>> bypassed_hashes(partition_count);
+
+            bool preaggregate = true;
+            size_t interval_tuples = 0;
+            size_t interval_groups = 0;
+            size_t interval_count = 0;
+            std::vector<std::vector<Register>> tuples(probe_group_size);
+            std::array<uint64_t, probe_group_size> hashes{};
+            while (true) {
+                size_t count = 0;
+                while (count < probe_group_size && this->input->next()) {
+                    this->check_interrupted();
+                    std::vector<Register*> regs = this->input->get_output();
+                    auto& tuple = tuples[count];
+                    tuple.resize(regs.size());
+                    for (size_t i = 0; i < regs.size(); ++i) {
+                        tuple[i] = *regs[i];
+                    }
+                    hashes[count] = this->input->get_output_hash();
+                    ++count;
+                }
+                if (count == 0) {
+                    break;
+                }
+                if (!this->reuse_hash) {
+                    hash_attributes(tuples, count, group_by_attrs, key_types, hashes.data());
+                }
+
+                for (size_t i = 0; i < count; ++i) {
+                    size_t p = hashes[i] >> (64U - partition_bits);
+                    if (!preaggregate) {
+                        bypassed[p].push_back(std::move(tuples[i]));
+                        bypassed_hashes[p].push_back(hashes[i]);
+                        ++this->bypassed_count;
+                        ++interval_tuples;
+                        continue;
+                    }
+                    size_t& staged_count = staged_counts[p];
+                    std::swap(staged[p][staged_count], tuples[i]);
+                    staged_hashes[p][staged_count] = hashes[i];
+                    if (++staged_count == probe_group_size) {
+                        size_t group_count = this->partitions[p].get_group_count();
+                        this->partitions[p].insert(staged[p], probe_group_size, staged_hashes[p].data());
+                        interval_groups += this->partitions[p].get_group_count() - group_count;
+                        interval_tuples += probe_group_size;
+                        staged_count = 0;
+                    }
+                }
+
+                if (interval_tuples >= adaptation_interval) {
+                    if (preaggregate) {
+                        double group_fraction = static_cast<double>(interval_groups) / static_cast<double>(interval_tuples);
+                        preaggregate = group_fraction <= max_group_fraction;
+                    } else if (++interval_count == bypass_intervals) {
+                        preaggregate = true;
+                        interval_count = 0;
+                    }
+                    interval_tuples = 0;
+                    interval_groups = 0;
+                }
+            }
+
+            // The threads take the next partition and aggregate its remaining
+            // tuples with the hash values that were computed for partitioning.
+            std::atomic<size_t> next_partition{0};
+            auto work = [&]() {
+                std::vector<std::vector<Register>> group(probe_group_size);
+                for (size_t p = next_partition++; p < partition_count; p = next_partition++) {
+                    if (this->token != nullptr && (this->token->is_cancelled() || this->token->is_expired())) {
+                        return;
+                    }
+                    auto& partition = this->partitions[p];
+                    partition.insert(staged[p], staged_counts[p], staged_hashes[p].data());
+                    auto& partition_tuples = bypassed[p];
+                    for (size_t begin = 0; begin < partition_tuples.size(); begin += probe_group_size) {
+                        size_t count = std::min(probe_group_size, partition_tuples.size() - begin);
+                        for (size_t i = 0; i < count; ++i) {
+                            group[i] = std::move(partition_tuples[begin + i]);
+                        }
+                        partition.insert(group, count, &bypassed_hashes[p][begin]);
+                    }
+                    partition_tuples.clear();
+                    partition_tuples.shrink_to_fit();
+                    partition.finalize();
+                }
+            };
+            size_t worker_count = std::min(this->thread_count, partition_count);
+            std::vector<std::thread> workers;
+            for (size_t i = 1; i < worker_count; ++i) {
+                workers.emplace_back(work);
+            }
+            work();
+            for (auto& worker : workers) {
+                worker.join();
+            }
+            if (this->token != nullptr) {
+                this->token->check();
+            }
+        }
+
+
+        bool HashAggregation::next() {
+            if (!this->isMaterialized) {
+                if (this->thread_count > 1) {
+                    this->aggregate_partitioned();
+                } else {
+                    this->aggregate();
+                }
+                this->isMaterialized = true;
+            }
+            if (this->thread_count > 1) {
+                while (this->partition_index < this->partitions.size()) {
+                    auto& partition = this->partitions[this->partition_index];
+                    if (this->counter_index < partition.get_group_count()) {
+                        this->output_regs = *partition.get_group(this->counter_index);
+                        this->output_hash = partition.get_group_hash(this->counter_index);
+                        ++this->counter_index;
+                        return true;
+                    }
+                    ++this->partition_index;
+                    this->counter_index = 0;
+                }
+                return false;
+            }
+            if (this->counter_index < this->state->get_group_count()) {
+                this->output_regs = *this->state->get_group(this->counter_index);
+                this->output_hash = this->state->get_group_hash(this->counter_index);
+                ++this->counter_index;
+                return true;
+            }
+            return false;
+        }
+
+
+        void HashAggregation::close() {
+            this->input->close();
+            this->state->release();
+            this->partitions.clear();
+            this->partitions.shrink_to_fit();
+        }
+
+
+        std::vector<Register*> HashAggregation::get_output() {
+            std::vector<Register*> output;
+            for (auto& reg : this->output_regs) {
+                output.push_back(&reg);
+            }
+            return output;
+        }
+
+
+        AggregationState::AggregationState(
+                std::vector<size_t> group_by_attrs,
+                std::vector<HashAggregation::AggrFunc> aggr_funcs
+        ) {
+            this->group_by_attrs = std::move(group_by_attrs);
+            this->aggr_funcs = std::move(aggr_funcs);
+            this->clear();
+        }
+
+
+        AggregationState::AggregationState(AggregationState&& other) noexcept = default;
+
+
+        AggregationState& AggregationState::operator=(AggregationState&& other) noexcept = default;
+
+
+        AggregationState::~AggregationState() = default;
+
+
+        void AggregationState::set_input_schema(const Schema& schema) {
+            this->input_schema = schema;
+            this->key_types.clear();
+            if (!schema.empty()) {
+                for (size_t attr : this->group_by_attrs) {
+                    this->key_types.push_back(schema[attr]);
+                }
+            }
+
+            // Single integer keys are compared as cheaply as normalized ones.
+            // The lengths word has one byte per CHAR16 attribute.
+            this->disable_normalized_keys();
+            size_t key_bytes = 0;
+            size_t char16_count = 0;
+            for (Register::Type type : this->key_types) {
+                size_t size = Register::get_key_size(type);
+                if (size == 0) {
+                    return;
+                }
+                key_bytes += size;
+                char16_count += type == Register::Type::CHAR16 ? 1 : 0;
+            }
+            if (char16_count > sizeof(uint64_t) || (this->key_types.size() < 2 && char16_count == 0)) {
+                return;
+            }
+            this->key_words = key_bytes / sizeof(uint64_t) + (char16_count > 0 ? 1 : 0);
+            this->normalized_keys.resize(this->groups.size() * this->key_words);
+            for (size_t i = 0; i < this->groups.size(); ++i) {
+                if (!this->normalize_key(this->groups[i], nullptr, &this->normalized_keys[i * this->key_words])) {
+                    this->disable_normalized_keys();
+                    return;
+                }
+            }
+        }
+
+
+        Schema AggregationState::get_schema() const {
+            if (this->input_schema.empty()) {
+                return {};
+            }
+            Schema schema = this->key_types;
+            for (auto& func : this->aggr_funcs) {
+                schema.push_back(get_aggregate_type(func, this->input_schema));
+            }
+            return schema;
+        }
+
+
+        AggregationState AggregationState::create_empty() const {
+            AggregationState state{this->group_by_attrs, this->aggr_funcs};
+            state.set_input_schema(this->input_schema);
+            state.has_key_range = this->has_key_range;
+            state.key_range_min = this->key_range_min;
+            state.key_range_max = this->key_range_max;
+            return state;
+        }
+
+
+        void AggregationState::set_key_range(int64_t min, int64_t max) {
+            this->has_key_range = true;
+            this->key_range_min = min;
+            this->key_range_max = max;
+        }
+
+
+        void AggregationState::clear() {
+            this->groups.clear();
+            this->tuple_counts.clear();
+            this->group_hashes.clear();
+            this->chain.clear();
+            this->sketches.clear();
+            this->strings = StringArena{};
+            this->buckets.assign(directory_size(HashAggregation::probe_group_size), 0);
+            this->lookup = Lookup::UNDECIDED;
+            this->array_slots.clear();
+            this->normalized_keys.clear();
+        }
+
+
+        void AggregationState::release() {
+            this->clear();
+            this->groups.shrink_to_fit();
+            this->tuple_counts.shrink_to_fit();
+            this->group_hashes.shrink_to_fit();
+            this->chain.shrink_to_fit();
+            this->sketches.shrink_to_fit();
+            this->array_slots.shrink_to_fit();
+            this->normalized_keys.shrink_to_fit();
+            this->probe_keys.clear();
+            this->probe_keys.shrink_to_fit();
+        }
+
+
+        void AggregationState::grow() {
+            this->buckets.assign(this->buckets.size() * 2, 0);
+            size_t mask = this->buckets.size() - 1;
+            for (size_t i = 0; i < this->groups.size(); ++i) {
+                size_t& head = this->buckets[this->group_hashes[i] & mask];
+                this->chain[i] = head;
+                head = i + 1;
+            }
+        }
+
+
+        size_t AggregationState::find(
+                const std::vector<Register>& tuple,
+                const std::vector<size_t>& key_attrs,
+                uint64_t hash
+        ) const {
+            size_t key_count = key_attrs.size();
+            size_t entry = this->buckets[hash & (this->buckets.size() - 1)];
+            for (; entry != 0; entry = this->chain[entry - 1]) {
+                if (this->group_hashes[entry - 1] != hash) {
+                    continue;
+                }
+                auto& group = this->groups[entry - 1];
+                bool equal = true;
+                for (size_t k = 0; k < key_count && equal; ++k) {
+                    equal = this->key_types.empty()
+                        ? group[k] == tuple[key_attrs[k]]
+                        : Register::equals(group[k], tuple[key_attrs[k]], this->key_types[k]);
+                }
+                if (equal) {
+                    break;
+                }
+            }
+            return entry;
+        }
+
+
+        size_t AggregationState::find(const std::vector<Register>& tuple, uint64_t hash) const {
+            return this->find(tuple, this->group_by_attrs, hash);
+        }
+
+
+        size_t AggregationState::find_normalized(const uint64_t* key, uint64_t hash) const {
+            size_t entry = this->buckets[hash & (this->buckets.size() - 1)];
+            for (; entry != 0; entry = this->chain[entry - 1]) {
+                if (this->group_hashes[entry - 1] == hash
+                        && std::equal(key, key + this->key_words, &this->normalized_keys[(entry - 1) * this->key_words])) {
+                    break;
+                }
+            }
+            return entry;
+        }
+
+
+        bool AggregationState::normalize_key(
+                const std::vector<Register>& tuple,
+                const std::vector<size_t>* key_attrs,
+                uint64_t* key
+        ) const {
+            char* bytes = reinterpret_cast<char*>(key);
+            auto* lengths = reinterpret_cast<unsigned char*>(key + this->key_words - 1);
+            size_t offset = 0;
+            size_t char16_index = 0;
+            for (size_t k = 0; k < this->key_types.size(); ++k) {
+                Register::Type type = this->key_types[k];
+                const Register& value = tuple[key_attrs != nullptr ? (*key_attrs)[k] : k];
+                size_t length = Register::write_key(value, type, bytes + offset);
+                if (type == Register::Type::CHAR16) {
+                    if (length > 16) {
+                        return false;
+                    }
+                    lengths[char16_index++] = static_cast<unsigned char>(length);
+                }
+                offset += Register::get_key_size(type);
+            }
+            // The unused bytes of the lengths word must compare equal.
+            for (; char16_index > 0 && char16_index < sizeof(uint64_t); ++char16_index) {
+                lengths[char16_index] = 0;
+            }
+            return true;
+        }
+
+
+        uint64_t AggregationState::hash_normalized_key(const uint64_t* key) const {
+            const char* bytes = reinterpret_cast<const char*>(key);
+            const auto* lengths = reinterpret_cast<const unsigned char*>(key + this->key_words - 1);
+            size_t offset = 0;
+            size_t char16_index = 0;
+            uint64_t hash = 0;
+            for (size_t k = 0; k < this->key_types.size(); ++k) {
+                uint64_t value_hash;
+                if (this->key_types[k] == Register::Type::CHAR16) {
+                    value_hash = hash_bytes(bytes + offset, lengths[char16_index++]);
+                    offset += 16;
+                } else {
+                    uint64_t value;
+                    std::memcpy(&value, bytes + offset, sizeof(value));
+                    value_hash = hash_int(value);
+                    offset += sizeof(value);
+                }
+                hash = k == 0 ? value_hash : combine_hashes(hash, value_hash);
+            }
+            return hash;
+        }
+
+
+        void AggregationState::disable_normalized_keys() {
+            this->key_words = 0;
+            this->normalized_keys.clear();
+            this->normalized_keys.shrink_to_fit();
+        }
+
+
+        void AggregationState::store_string(Register& value) {
+            if (value.get_type() == Register::Type::VARCHAR && !value.as_varchar().is_inline()) {
+                value = Register::from_varchar(this->strings.store(value.as_varchar()));
+            }
+        }
+
+
+        void AggregationState::append_group(std::vector<Register> group, int64_t tuple_count, uint64_t hash) {
+            for (auto& value : group) {
+                this->store_string(value);
+            }
+            this->groups.push_back(std::move(group));
+            this->tuple_counts.push_back(tuple_count);
+            this->group_hashes.push_back(hash);
+            size_t& head = this->buckets[hash & (this->buckets.size() - 1)];
+            this->chain.push_back(head);
+            head = this->groups.size();
+            if (this->groups.size() * 2 > this->buckets.size()) {
+                this->grow();
+            }
+            if (this->key_words != 0) {
+                this->normalized_keys.resize(this->groups.size() * this->key_words);
+                uint64_t* key = &this->normalized_keys[(this->groups.size() - 1) * this->key_words];
+                if (!this->normalize_key(this->groups.back(), nullptr, key)) {
+                    this->disable_normalized_keys();
+                }
+            }
+            if (this->lookup == Lookup::ARRAY) {
+                int64_t key = this->groups.back()[0].as_int();
+                if (this->get_array_offset(key) < this->array_slots.size() || this->cover_keys(key, key)) {
+                    this->array_slots[this->get_array_offset(key)] = this->groups.size();
+                }
+            }
+        }
+
+
+        void AggregationState::choose_lookup(const std::vector<std::vector<Register>>& tuples, size_t count) {
+            this->lookup = Lookup::HASH;
+            if (this->key_types.size() != 1) {
+                return;
+            }
+            Register::Type type = this->key_types[0];
+            if (type != Register::Type::INT64 && type != Register::Type::INT32 && type != Register::Type::DATE) {
+                return;
+            }
+            int64_t low = this->key_range_min;
+            int64_t high = this->key_range_max;
+            if (!this->has_key_range) {
+                size_t attr = this->group_by_attrs[0];
+                low = high = tuples[0][attr].as_int();
+                for (size_t i = 1; i < count; ++i) {
+                    low = std::min(low, tuples[i][attr].as_int());
+                    high = std::max(high, tuples[i][attr].as_int());
+                }
+            }
+            if (low > high) {
+                return;
+            }
+            this->lookup = Lookup::ARRAY;
+            this->array_slots.clear();
+            this->cover_keys(low, high);
+        }
+
+
+        bool AggregationState::cover_keys(int64_t low, int64_t high) {
+            if (!this->array_slots.empty()
+                    && this->get_array_offset(low) < this->array_slots.size()
+                    && this->get_array_offset(high) < this->array_slots.size()) {
+                return true;
+            }
+            for (auto& group : this->groups) {
+                low = std::min(low, group[0].as_int());
+                high = std::max(high, group[0].as_int());
+            }
+            uint64_t range = static_cast<uint64_t>(high) - static_cast<uint64_t>(low);
+            if (range >= max_array_range) {
+                this->lookup = Lookup::HASH;
+                this->array_slots.clear();
+                this->array_slots.shrink_to_fit();
+                return false;
+            }
+
+            // The array grows at least by half its size, so that keys that
+            // trickle in at one end do not rebuild it every time. The extra
+            // slots are added at the end that grew.
+            uint64_t size = std::max(range + 1, std::min<uint64_t>(this->array_slots.size() * 3 / 2, max_array_range));
+            int64_t base = low;
+            uint64_t extra = size - (range + 1);
+            if (!this->array_slots.empty() && low < this->array_base
+                    && low >= std::numeric_limits<int64_t>::min() + static_cast<int64_t>(extra)) {
+                base = low - static_cast<int64_t>(extra);
+            }
+            this->array_base = base;
+            this->array_slots.assign(size, 0);
+            for (size_t i = 0; i < this->groups.size(); ++i) {
+                this->array_slots[this->get_array_offset(this->groups[i][0].as_int())] = i + 1;
+            }
+            return true;
+        }
+
+
+        void AggregationState::initialize_aggregates(std::vector<Register>& group, const std::vector<Register>& tuple) const {
+            group.resize(this->group_by_attrs.size());
+            for (auto& func : this->aggr_funcs) {
+                switch (func.func) {
+                    case HashAggregation::AggrFunc::MIN:
+                    case HashAggregation::AggrFunc::MAX:
+                        group.push_back(tuple[func.attr_index]);
+                        break;
+                    case HashAggregation::AggrFunc::SUM:
+                        group.push_back(to_sum(tuple[func.attr_index]));
+                        break;
+                    case HashAggregation::AggrFunc::COUNT:
+                        group.push_back(Register::from_int(1));
+                        break;
+                    case HashAggregation::AggrFunc::APPROX_COUNT_DISTINCT:
+                    case HashAggregation::AggrFunc::APPROX_QUANTILE:
+                    case HashAggregation::AggrFunc::APPROX_MOST_FREQUENT:
+                        // Set by `finalize()`.
+                        group.push_back(Register::from_int(0));
+                        break;
+                }
+            }
+        }
+
+
+        size_t AggregationState::add_group(const std::vector<Register>& tuple, uint64_t hash) {
+            std::vector<Register> group;
+            group.reserve(this->group_by_attrs.size() + this->aggr_funcs.size());
+            for (size_t attr : this->group_by_attrs) {
+                group.push_back(tuple[attr]);
+            }
+            this->initialize_aggregates(group, tuple);
+            this->append_group(std::move(group), 1, hash);
+            if (has_approximate_aggregates(this->aggr_funcs)) {
+                for (auto& func : this->aggr_funcs) {
+                    std::unique_ptr<ApproximateAggregate> sketch;
+                    if (func.is_approximate()) {
+                        sketch = ApproximateAggregate::create(func);
+                        sketch->add(tuple[func.attr_index]);
+                    }
+                    this->sketches.push_back(std::move(sketch));
+                }
+            }
+            return this->groups.size() - 1;
+        }
+
+
+        void AggregationState::insert(
+                std::vector<std::vector<Register>>& tuples,
+                size_t count,
+                const uint64_t* input_hashes
+        ) {
+            assert(count <= HashAggregation::probe_group_size);
+            if (this->lookup == Lookup::UNDECIDED && count > 0) {
+                this->choose_lookup(tuples, count);
+            }
+            if (this->lookup == Lookup::ARRAY && count > 0 && this->insert_array(tuples, count)) {
+                return;
+            }
+            std::array<uint64_t, HashAggregation::probe_group_size> hashes{};
+            size_t mask = this->buckets.size() - 1;
+
+            // Stage 1: normalize and hash the group keys and prefetch their
+            // buckets.
+            size_t words = this->key_words;
+            if (words != 0) {
+                this->probe_keys.resize(count * words);
+                for (size_t i = 0; i < count; ++i) {
+                    if (!this->normalize_key(tuples[i], &this->group_by_attrs, &this->probe_keys[i * words])) {
+                        this->disable_normalized_keys();
+                        words = 0;
+                        break;
+                    }
+                }
+            }
+            if (input_hashes != nullptr) {
+                std::copy(input_hashes, input_hashes + count, hashes.begin());
+            } else if (words != 0) {
+                for (size_t i = 0; i < count; ++i) {
+                    hashes[i] = this->hash_normalized_key(&this->probe_keys[i * words]);
+                }
+            } else {
+                hash_attributes(tuples, count, this->group_by_attrs, this->key_types, hashes.data());
+            }
+            for (size_t i = 0; i < count; ++i) {
+                __builtin_prefetch(&this->buckets[hashes[i] & mask]);
+            }
+
+            // Stage 2: prefetch the first group of every bucket.
+            for (size_t i = 0; i < count; ++i) {
+                size_t head = this->buckets[hashes[i] & mask];
+                if (head != 0) {
+                    __builtin_prefetch(&this->group_hashes[head - 1]);
+                    if (words != 0) {
+                        __builtin_prefetch(&this->normalized_keys[(head - 1) * words]);
+                    } else {
+                        __builtin_prefetch(&this->groups[head - 1]);
+                    }
+                }
+            }
+
+            // Stage 3: find or create the groups and update their aggregates.
+            // The buckets are read again because earlier tuples of this group
+            // may have inserted into them.
+            for (size_t i = 0; i < count; ++i) {
+                auto& tuple = tuples[i];
+                size_t entry = words != 0
+                    ? this->find_normalized(&this->probe_keys[i * words], hashes[i])
+                    : this->find(tuple, hashes[i]);
+                if (entry == 0) {
+                    this->add_group(tuple, hashes[i]);
+                } else {
+                    this->update_group(entry - 1, tuple);
+                }
+            }
+        }
+
+
+        bool AggregationState::insert_array(std::vector<std::vector<Register>>& tuples, size_t count) {
+            size_t attr = this->group_by_attrs[0];
+            int64_t low = tuples[0][attr].as_int();
+            int64_t high = low;
+            for (size_t i = 1; i < count; ++i) {
+                low = std::min(low, tuples[i][attr].as_int());
+                high = std::max(high, tuples[i][attr].as_int());
+            }
+            if (!this->cover_keys(low, high)) {
+                return false;
+            }
+
+            // The groups are found without hashing, only new groups hash their
+            // key for the hash directory.
+            Register::Type type = this->key_types[0];
+            for (size_t i = 0; i < count; ++i) {
+                auto& tuple = tuples[i];
+                size_t entry = this->array_slots[this->get_array_offset(tuple[attr].as_int())];
+                if (entry == 0) {
+                    this->add_group(tuple, Register::hash(tuple[attr], type));
+                } else {
+                    this->update_group(entry - 1, tuple);
+                }
+            }
+            return true;
+        }
+
+
+        void AggregationState::update_group(size_t index, const std::vector<Register>& tuple) {
+            auto& group = this->groups[index];
+            size_t key_count = this->group_by_attrs.size();
+            if (this->tuple_counts[index]++ == 0) {
+                this->initialize_aggregates(group, tuple);
+                for (size_t a = 0; a < this->aggr_funcs.size(); ++a) {
+                    this->store_string(group[key_count + a]);
+                }
+                return;
+            }
+            for (size_t a = 0; a < this->aggr_funcs.size(); ++a) {
+                auto& func = this->aggr_funcs[a];
+                Register& value = group[key_count + a];
+                switch (func.func) {
+                    case HashAggregation::AggrFunc::MIN:
+                        if (tuple[func.attr_index] < value) {
+                            value = tuple[func.attr_index];
+                            this->store_string(value);
+                        }
+                        break;
+                    case HashAggregation::AggrFunc::MAX:
+                        if (tuple[func.attr_index] > value) {
+                            value = tuple[func.attr_index];
+                            this->store_string(value);
+                        }
+                        break;
+                    case HashAggregation::AggrFunc::SUM:
+                        value = add_sums(value, to_sum(tuple[func.attr_index]));
+                        break;
+                    case HashAggregation::AggrFunc::COUNT:
+                        value = Register::from_int(value.as_int() + 1);
+                        break;
+                    case HashAggregation::AggrFunc::APPROX_COUNT_DISTINCT:
+                    case HashAggregation::AggrFunc::APPROX_QUANTILE:
+                    case HashAggregation::AggrFunc::APPROX_MOST_FREQUENT:
+                        this->sketches[index * this->aggr_funcs.size() + a]->add(tuple[func.attr_index]);
+                        break;
+                }
+            }
+        }
+
+
+        void AggregationState::finalize() {
+            if (this->sketches.empty()) {
+                return;
+            }
+            size_t key_count = this->group_by_attrs.size();
+            size_t width = this->aggr_funcs.size();
+            for (size_t g = 0; g < this->groups.size(); ++g) {
+                for (size_t a = 0; a < width; ++a) {
+                    if (auto& sketch = this->sketches[g * width + a]) {
+                        this->groups[g][key_count + a] = sketch->get_result();
+                        this->store_string(this->groups[g][key_count + a]);
+                    }
+                }
+            }
+        }
+
+
+        void AggregationState::merge(const AggregationState& other) {
+            assert(this->group_by_attrs.size() == other.group_by_attrs.size());
+            assert(this->aggr_funcs.size() == other.aggr_funcs.size());
+            size_t key_count = this->group_by_attrs.size();
+            size_t width = this->aggr_funcs.size();
+            // The groups of `other` hold their keys in front.
+            std::vector<size_t> key_attrs(key_count);
+            for (size_t k = 0; k < key_count; ++k) {
+                key_attrs[k] = k;
+            }
+
+            for (size_t i = 0; i < other.groups.size(); ++i) {
+                if (other.tuple_counts[i] == 0) {
+                    continue;
+                }
+                auto& source = other.groups[i];
+                size_t entry = this->find(source, key_attrs, other.group_hashes[i]);
+                if (entry == 0) {
+                    this->append_group(source, other.tuple_counts[i], other.group_hashes[i]);
+                    if (!other.sketches.empty()) {
+                        for (size_t a = 0; a < width; ++a) {
+                            auto& sketch = other.sketches[i * width + a];
+                            this->sketches.push_back(sketch ? sketch->clone() : nullptr);
+                        }
+                    }
+                    continue;
+                }
+
+                auto& group = this->groups[entry - 1];
+                if (this->tuple_counts[entry - 1] == 0) {
+                    // Only invertible aggregates have empty groups, so there
+                    // are no sketches to replace.
+                    group = source;
+                    for (auto& value : group) {
+                        this->store_string(value);
+                    }
+                    this->tuple_counts[entry - 1] = other.tuple_counts[i];
+                    continue;
+                }
+                this->tuple_counts[entry - 1] += other.tuple_counts[i];
+                for (size_t a = 0; a < width; ++a) {
+                    Register& value = group[key_count + a];
+                    const Register& other_value = source[key_count + a];
+                    switch (this->aggr_funcs[a].func) {
+                        case HashAggregation::AggrFunc::MIN:
+                            if (other_value < value) {
+                                value = other_value;
+                                this->store_string(value);
+                            }
+                            break;
+                        case HashAggregation::AggrFunc::MAX:
+                            if (other_value > value) {
+                                value = other_value;
+                                this->store_string(value);
+                            }
+                            break;
+                        case HashAggregation::AggrFunc::SUM:
+                        case HashAggregation::AggrFunc::COUNT:
+                            value = add_sums(value, other_value);
+                            break;
+                        case HashAggregation::AggrFunc::APPROX_COUNT_DISTINCT:
+                        case HashAggregation::AggrFunc::APPROX_QUANTILE:
+                        case HashAggregation::AggrFunc::APPROX_MOST_FREQUENT:
+                            this->sketches[(entry - 1) * width + a]->merge(*other.sketches[i * width + a]);
+                            break;
+                    }
+                }
+            }
+            this->finalize();
+        }
+
+
+        void AggregationState::remove(const std::vector<Register>& tuple) {
+            if (!this->is_invertible()) {
+                throw std::logic_error("only SUM and COUNT aggregates support removals");
+            }
+            uint64_t hash = hash_attributes(tuple, this->group_by_attrs, this->key_types);
+            size_t entry = this->find(tuple, hash);
+            if (entry == 0 || this->tuple_counts[entry - 1] == 0) {
+                throw std::invalid_argument("removed tuple was not aggregated");
+            }
+            --this->tuple_counts[entry - 1];
+            auto& group = this->groups[entry - 1];
+            size_t key_count = this->group_by_attrs.size();
+            for (size_t a = 0; a < this->aggr_funcs.size(); ++a) {
+                auto& func = this->aggr_funcs[a];
+                Register& value = group[key_count + a];
+                if (func.func == HashAggregation::AggrFunc::SUM) {
+                    value = add_sums(value, to_sum(tuple[func.attr_index], -1));
+                } else {
+                    value = Register::from_int(value.as_int() - 1);
+                }
+            }
         }
 
 
-        std::vector<Register*> Projection::get_output() {
-            std::vector<Register*> output;
-            for (auto& reg : this->output_regs) {
-                output.push_back(&reg);
+        void AggregationState::insert(Operator& delta) {
+            std::vector<std::vector<Register>> tuples(HashAggregation::probe_group_size);
+            delta.open();
+            while (true) {
+                size_t count = 0;
+                while (count < HashAggregation::probe_group_size && delta.next()) {
+                    std::vector<Register*> regs = delta.get_output();
+                    auto& tuple = tuples[count];
+                    tuple.resize(regs.size());
+                    for (size_t i = 0; i < regs.size(); ++i) {
+                        tuple[i] = *regs[i];
+                    }
+                    ++count;
+                }
+                if (count == 0) {
+                    break;
+                }
+                this->insert(tuples, count);
             }
-            this->output_regs.clear();
-            return output;
+            delta.close();
+            this->finalize();
         }
 
 
-        Select::Select(Operator& input, PredicateAttributeInt64 predicate)
-                : UnaryOperator(input) {
-            this->predicateAttribute = Select::PrecidateAttribute::INT;
-            this->intPredicate = predicate;
+        void AggregationState::remove(Operator& delta) {
+            std::vector<Register> tuple;
+            delta.open();
+            while (delta.next()) {
+                std::vector<Register*> regs = delta.get_output();
+                tuple.resize(regs.size());
+                for (size_t i = 0; i < regs.size(); ++i) {
+                    tuple[i] = *regs[i];
+                }
+                this->remove(tuple);
+            }
+            delta.close();
         }
 
 
-        Select::Select(Operator& input, PredicateAttributeChar16 predicate)
-                : UnaryOperator(input) {
-            this->predicateAttribute = Select::PrecidateAttribute::CHAR;
-            this->charPredicate = std::move(predicate);
+        bool AggregationState::is_invertible() const {
+            for (auto& func : this->aggr_funcs) {
+                if (func.func != HashAggregation::AggrFunc::SUM && func.func != HashAggregation::AggrFunc::COUNT) {
+                    return false;
+                }
+            }
+            return true;
         }
 
 
-        Select::Select(Operator& input, PredicateAttributeAttribute predicate)
-                : UnaryOperator(input) {
-            this->predicateAttribute = Select::PrecidateAttribute::ATTRIBUTE;
-            this->attributePredicate = predicate;
+        size_t AggregationState::get_group_count() const {
+            return this->groups.size();
         }
 
 
-        Select::~Select() = default;
+        const std::vector<Register>* AggregationState::get_group(size_t index) const {
+            if (this->tuple_counts[index] == 0) {
+                return nullptr;
+            }
+            return &this->groups[index];
+        }
 
 
-        void Select::open() {
-            this->input->open();
+        uint64_t AggregationState::get_group_hash(size_t index) const {
+            return this->group_hashes[index];
         }
 
 
-        bool Select::next() {
-            if (this->input->next()) {
-                this->output_regs.clear();
-                std::vector<Register*> regs = this->input->get_output();
-                switch (this->predicateAttribute) {
-                    case PrecidateAttribute::INT :
-                        switch (this->intPredicate.predicate_type) {
-                            case Select::PredicateType::EQ :
-                            {
-                                auto& intReg = regs[this->intPredicate.attr_index];
-                                Register int_reg = Register::from_int(this->intPredicate.constant);
-                                if (*intReg == int_reg) {
-                                    for (auto& r : regs) {
-                                        this->output_regs.push_back(*r);
-                                    }
-                                }
-                            }
-                                return true;
-                            case Select::PredicateType::NE :
-                            {
-                                auto& intReg = regs[this->intPredicate.attr_index];
-                                Register int_reg = Register::from_int(this->intPredicate.constant);
-                                if (*intReg != int_reg) {
-                                    for (auto& r : regs) {
-                                        this->output_regs.push_back(*r);
-                                    }
-                                }
-                            }
-                                return true;
-                            case Select::PredicateType::LT :
-                            {
-                                auto& intReg = regs[this->intPredicate.attr_index];
-                                Register int_reg = Register::from_int(this->intPredicate.constant);
-                                if (*intReg < int_reg) {
-                                    for (auto& r : regs) {
-                                        this->output_regs.push_back(*r);
-                                    }
-                                }
-                            }
-                                return true;
-                            case Select::PredicateType::LE :
-                            {
-                                auto& intReg = regs[this->intPredicate.attr_index];
-                                Register int_reg = Register::from_int(this->intPredicate.constant);
-                                if (*intReg <= int_reg) {
-                                    for (auto& r : regs) {
-                                        this->output_regs.push_back(*r);
-                                    }
-                                }
-                            }
-                                return true;
-                            case Select::PredicateType::GT :
-                            {
-                                auto& intReg = regs[this->intPredicate.attr_index];
-                                Register int_reg = Register::from_int(this->intPredicate.constant);
-                                if (*intReg > int_reg) {
-                                    for (auto& r : regs) {
-                                        this->output_regs.push_back(*r);
-                                    }
-                                }
-                            }
-                                return true;
-                            case Select::PredicateType::GE :
-                            {
-                                auto& intReg = regs[this->intPredicate.attr_index];
-                                Register int_reg = Register::from_int(this->intPredicate.constant);
-                                if (*intReg >= int_reg) {
-                                    for (auto& r : regs) {
-                                        this->output_regs.push_back(*r);
-                                    }
-                                }
-                            }
-                                return true;
-                        }
-                    case PrecidateAttribute::CHAR :
-                        switch (this->charPredicate.predicate_type) {
-                            case Select::PredicateType::EQ :
-                            {
-                                auto& stringReg = regs[this->charPredicate.attr_index];
-                                Register str_reg = Register::from_string(this->charPredicate.constant);
-                                if (*stringReg == str_reg) {
-                                    for (auto& r : regs) {
-                                        this->output_regs.push_back(*r);
-                                    }
-                                }
-                            }
-                                return true;
-                            case Select::PredicateType::NE :
-                            {
-                                auto& stringReg = regs[this->charPredicate.attr_index];
-                                Register str_reg = Register::from_string(this->charPredicate.constant);
-                                if (*stringReg != str_reg) {
-                                    for (auto& r : regs) {
-                                        this->output_regs.push_back(*r);
-                                    }
-                                }
-                            }
-                                return true;
-                            case Select::PredicateType::LT :
-                            {
-                                auto& stringReg = regs[this->charPredicate.attr_index];
-                                Register str_reg = Register::from_string(this->charPredicate.constant);
-                                if (*stringReg < str_reg) {
-                                    for (auto& r : regs) {
-                                        this->output_regs.push_back(*r);
-                                    }
-                                }
-                            }
-                                return true;
-                            case Select::PredicateType::LE :
-                            {
-                                auto& stringReg = regs[this->charPredicate.attr_index];
-                                Register str_reg = Register::from_string(this->charPredicate.constant);
-                                if (*stringReg <= str_reg) {
-                                    for (auto& r : regs) {
-                                        this->output_regs.push_back(*r);
-                                    }
-                                }
-                            }
-                                return true;
-                            case Select::PredicateType::GT :
-                            {
-                                auto& stringReg = regs[this->charPredicate.attr_index];
-                                Register str_reg = Register::from_string(this->charPredicate.constant);
-                                if (*stringReg > str_reg) {
-                                    for (auto& r : regs) {
-                                        this->output_regs.push_back(*r);
-                                    }
-                                }
-                            }
-                                return true;
-                            case Select::PredicateType::GE :
-                            {
-                                auto& stringReg = regs[this->charPredicate.attr_index];
-                                Register str_reg = Register::from_string(this->charPredicate.constant);
-                                if (*stringReg >= str_reg) {
-                                    for (auto& r : regs) {
-                                        this->output_regs.push_back(*r);
-                                    }
-                                }
-                            }
-                                return true;
-                        }
-                    case PrecidateAttribute::ATTRIBUTE :
-                        switch (this->attributePredicate.predicate_type) {
-                            case Select::PredicateType::EQ :
-                            {
-                                Register* leftReg = regs[this->attributePredicate.attr_left_index];
-                                Register* rightReg = regs[this->attributePredicate.attr_right_index];
-                                if (*leftReg == *rightReg) {
-                                    for (auto& r : regs) {
-                                        this->output_regs.push_back(*r);
-                                    }
-                                }
-                            }
-                                return true;
-                            case Select::PredicateType::NE :
-                            {
-                                Register* leftReg = regs[this->attributePredicate.attr_left_index];
-                                Register* rightReg = regs[this->attributePredicate.attr_right_index];
-                                if (*leftReg != *rightReg) {
-                                    for (auto& r : regs) {
-                                        this->output_regs.push_back(*r);
-                                    }
-                                }
-                            }
-                                return true;
-                            case Select::PredicateType::LT :
-                            {
-                                Register* leftReg = regs[this->attributePredicate.attr_left_index];
-                                Register* rightReg = regs[this->attributePredicate.attr_right_index];
-                                if (*leftReg < *rightReg) {
-                                    for (auto& r : regs) {
-                                        this->output_regs.push_back(*r);
-                                    }
-                                }
-                            }
-                                return true;
-                            case Select::PredicateType::LE :
-                            {
-                                Register* leftReg = regs[this->attributePredicate.attr_left_index];
-                                Register* rightReg = regs[this->attributePredicate.attr_right_index];
-                                if (*leftReg <= *rightReg) {
-                                    for (auto& r : regs) {
-                                        this->output_regs.push_back(*r);
-                                    }
-                                }
-                            }
-                                return true;
-                            case Select::PredicateType::GT :
-                            {
-                                Register* leftReg = regs[this->attributePredicate.attr_left_index];
-                                Register* rightReg = regs[this->attributePredicate.attr_right_index];
-                                if (*leftReg > *rightReg) {
-                                    for (auto& r : regs) {
-                                        this->output_regs.push_back(*r);
-                                    }
-                                }
-                            }
-                                return true;
-                            case Select::PredicateType::GE :
-                            {
-                                Register* leftReg = regs[this->attributePredicate.attr_left_index];
-                                Register* rightReg = regs[this->attributePredicate.attr_right_index];
-                                if (*leftReg >= *rightReg) {
-                                    for (auto& r : regs) {
-                                        this->output_regs.push_back(*r);
-                                    }
-                                }
-                            }
-                                return true;
-                        }
+        void AggregationState::save(std::ostream& stream) const {
+            if (has_approximate_aggregates(this->aggr_funcs)) {
+                throw std::logic_error("approximate aggregates cannot be saved");
+            }
+            write_value<uint64_t>(stream, this->group_by_attrs.size());
+            for (size_t attr : this->group_by_attrs) {
+                write_value<uint64_t>(stream, attr);
+            }
+            write_value<uint64_t>(stream, this->aggr_funcs.size());
+            for (auto& func : this->aggr_funcs) {
+                write_value<uint8_t>(stream, func.func);
+                write_value<uint64_t>(stream, func.attr_index);
+            }
+            uint64_t live_groups = std::count_if(
+                this->tuple_counts.begin(), this->tuple_counts.end(), [](int64_t count) { return count > 0; });
+            write_value<uint64_t>(stream, live_groups);
+            for (size_t i = 0; i < this->groups.size(); ++i) {
+                if (this->tuple_counts[i] == 0) {
+                    continue;
+                }
+                write_value<int64_t>(stream, this->tuple_counts[i]);
+                for (auto& reg : this->groups[i]) {
+                    write_register(stream, reg);
                 }
-            } else {
-                return false;
             }
         }
 
 
-        void Select::close() {
-            this->input->close();
-        }
-
+        AggregationState AggregationState::load(std::istream& stream) {
+            std::vector<size_t> group_by_attrs(read_value<uint64_t>(stream));
+            for (auto& attr : group_by_attrs) {
+                attr = read_value<uint64_t>(stream);
+            }
+            std::vector<HashAggregation::AggrFunc> aggr_funcs(read_value<uint64_t>(stream));
+            for (auto& func : aggr_funcs) {
+                func.func = static_cast<HashAggregation::AggrFunc::Func>(read_value<uint8_t>(stream));
+                func.attr_index = read_value<uint64_t>(stream);
+            }
 
-        std::vector<Register*> Select::get_output() {
-            std::vector<Register*> output;
-            for (auto& reg : this->output_regs) {
-                output.push_back(&reg);
+            AggregationState state{std::move(group_by_attrs), std::move(aggr_funcs)};
+            auto group_count = read_value<uint64_t>(stream);
+            size_t width = state.group_by_attrs.size() + state.aggr_funcs.size();
+            std::vector<size_t> key_attrs(state.group_by_attrs.size());
+            for (size_t k = 0; k < key_attrs.size(); ++k) {
+                key_attrs[k] = k;
             }
-            return output;
+            for (uint64_t g = 0; g < group_count; ++g) {
+                auto tuple_count = read_value<int64_t>(stream);
+                std::vector<Register> group(width);
+                for (auto& reg : group) {
+                    reg = read_register(stream, state.strings);
+                }
+                // The group keys are stored in front, so they hash like the
+                // group by attributes of an input tuple.
+                uint64_t hash = hash_attributes(group, key_attrs);
+                state.append_group(std::move(group), tuple_count, hash);
+            }
+            return state;
         }
 
 
-        Sort::Sort(Operator& input, std::vector<Criterion> criteria)
-                : UnaryOperator(input) {
-            this->criteria = std::move(criteria);
+        AggregationStateScan::AggregationStateScan(const AggregationState& state) {
+            this->state = &state;
         }
 
 
-        Sort::~Sort() = default;
-
-
-        void Sort::open() {
-            this->input->open();
-        }
+        AggregationStateScan::~AggregationStateScan() = default;
 
 
-        bool Sort::next() {
-            this->output_regs.clear();
-            if (!this->isMaterialized) {
-                while (this->input->next()) {
-                    std::vector<Register*> regs = this->input->get_output();
-                    std::vector<Register> output_regs;
-                    output_regs.reserve(regs.size());
-                    for (auto& reg : regs) {
-                        output_regs.push_back(*reg);
-                    }
-                    this->registers.push_back(output_regs);
-                }
-                for(Criterion c : this->criteria) {
-                    if (c.desc) {
-                        std::sort(this->registers.begin(), this->registers.end(),
-                                  [&c](const std::vector<Register>& regs1, const std::vector<Register>& regs2) {
-                                      return regs1[c.attr_index] > regs2[c.attr_index];
-                                  });
+        void AggregationStateScan::open() {
+            this->current_index = 0;
+            this->schema = this->state->get_schema();
+            if (!this->schema.empty()) {
+                return;
+            }
+            // Without the schema of the input, the types are taken from the
+            // first group.
+            for (size_t i = 0; i < this->state->get_group_count(); ++i) {
+                if (const auto* group = this->state->get_group(i)) {
+                    for (auto& reg : *group) {
+                        this->schema.push_back(reg.get_type());
                     }
+                    break;
                 }
-                this->isMaterialized = true;
             }
-            if (this->current_index < this->registers.size()) {
-                auto regs = this->registers[this->current_index];
-                for (auto& r : regs) {
-                    this->output_regs.push_back(r);
+        }
+
+
+        bool AggregationStateScan::next() {
+            while (this->current_index < this->state->get_group_count()) {
+                const auto* group = this->state->get_group(this->current_index++);
+                if (group != nullptr) {
+                    this->output_regs = *group;
+                    return true;
                 }
-                ++this->current_index;
-                return true;
             }
             return false;
         }
 
 
-        std::vector<Register*> Sort::get_output() {
+        void AggregationStateScan::close() {
+            this->output_regs.clear();
+        }
+
+
+        std::vector<Register*> AggregationStateScan::get_output() {
             std::vector<Register*> output;
-            output.reserve(this->output_regs.size());
             for (auto& reg : this->output_regs) {
                 output.push_back(&reg);
             }
@@ -547,246 +2970,279 @@ namespace moderndbs {
         }
 
 
-        void Sort::close() {
-            this->input->close();
-        }
-
-
-        HashJoin::HashJoin(
+        GroupJoin::GroupJoin(
                 Operator& input_left,
                 Operator& input_right,
                 size_t attr_index_left,
-                size_t attr_index_right
+                size_t attr_index_right,
+                std::vector<HashAggregation::AggrFunc> aggr_funcs
         ) : BinaryOperator(input_left, input_right) {
+            for (auto& func : aggr_funcs) {
+                if (func.is_approximate()) {
+                    throw std::invalid_argument("group joins do not support approximate aggregates");
+                }
+            }
             this->attr_index_left = attr_index_left;
             this->attr_index_right = attr_index_right;
+            this->aggr_funcs = std::move(aggr_funcs);
         }
 
 
-        HashJoin::~HashJoin() = default;
+        GroupJoin::~GroupJoin() = default;
 
 
-        void HashJoin::open() {
+        void GroupJoin::open() {
             this->input_left->open();
             this->input_right->open();
+            this->isMaterialized = false;
+            this->current_index = 0;
+
+            const Schema& left_schema = this->input_left->get_schema();
+            const Schema& right_schema = this->input_right->get_schema();
+            this->is_typed = !left_schema.empty() && !right_schema.empty()
+                && left_schema[this->attr_index_left] == right_schema[this->attr_index_right];
+            this->reuse_left_hash = this->input_left->get_hash_attrs() == std::vector<size_t>{this->attr_index_left};
+            this->reuse_right_hash = this->input_right->get_hash_attrs() == std::vector<size_t>{this->attr_index_right};
+            this->hash_attrs = {0};
+            this->schema.clear();
+            if (this->is_typed) {
+                this->key_type = left_schema[this->attr_index_left];
+                Schema joined = left_schema;
+                joined.insert(joined.end(), right_schema.begin(), right_schema.end());
+                this->schema.push_back(this->key_type);
+                for (auto& func : this->aggr_funcs) {
+                    this->schema.push_back(get_aggregate_type(func, joined));
+                }
+            }
         }
 
-        bool HashJoin::next() {
-            this->output_regs.clear();
-            if (!this->isMaterialized) {
-                std::unordered_map<Register, std::vector<Register>, RegisterVectorHasher> left_set;
-                std::unordered_set<Register, std::vector<Register>, RegisterVectorHasher> right_set;
-                while (this->input_left->next()) {
-                    std::vector<Register> regs;
-                    for (auto& reg : this->input_left->get_output()) {
-                        regs.push_back(*reg);
-                    }
-                    left_set.insert({regs[this->attr_index_left], regs});
-                }
-                /*std::cout << "left side" << std::endl;
-                for (auto it : left_set) {
-                    for (auto r : it) {
-                        std::cout << " " << r.get_hash() << ",";
-                    }
-                    std::cout << std::endl;
-                }
-                std::cout << '\n';
-                std::cout << '\n' << "left side end" << std::endl;*/
-                while (this->input_right->next()) {
-                    std::vector<Register> regs;
-                    for (auto& reg : this->input_right->get_output()) {
-                        regs.push_back(*reg);
-                    }
-                    left_set.insert({regs[this->attr_index_right], regs});
-                }
-                /*std::cout << "right side" << std::endl;
-                for (auto it : right_set) {
-                    for (auto r : it) {
-                        std::cout << " " << r.get_hash() << ",";
-                    }
-                    std::cout << std::endl;
-                }
-                std::cout << '\n';
-                std::cout << "right side end" << std::endl;*/
 
-                for (auto left_it : left_set) {
-                    auto got = right_set.find(left_it.first);
-                    if (got == right_set.end()) {
-                        registers_map.insert({*it, 1});
-                    } else {
-                        registers_map[*it] += 1;
-                    }
-                    if (left_it.first == right_se) {
-                        std::vector<Register> temp_vec;
-                        temp_vec.insert( temp_vec.end(), left_it.begin(), left_it.end() );
-                        temp_vec.insert( temp_vec.end(), right_it.begin(), right_it.end() );
-                        this->registers.push_back(temp_vec);
-                    }
+        size_t GroupJoin::find(const Register& key, uint64_t hash) const {
+            size_t entry = this->buckets[hash & (this->buckets.size() - 1)];
+            for (; entry != 0; entry = this->chain[entry - 1]) {
+                if (this->key_hashes[entry - 1] != hash) {
+                    continue;
                 }
-
-                std::sort(this->registers.begin(), this->registers.end(),
-                          [](const std::vector<Register>& regs1, const std::vector<Register>& regs2) {
-                              return regs1[0] < regs2[0];
-                          });
-                /*std::cout << "registers" << std::endl;
-                for (auto it : this->registers) {
-                    for (auto r : it) {
-                        if (r.get_type() == Register::Type::INT64) {
-                            std::cout << " " << r.as_int() << ",";
-                        } else {
-                            std::cout << " " << r.as_string() << ",";
-                        }
-                    }
-                    std::cout << std::endl;
+                const Register& candidate = this->keys[entry - 1];
+                if (this->is_typed ? Register::equals(candidate, key, this->key_type) : candidate == key) {
+                    break;
                 }
-                std::cout << '\n';
-                std::cout << '\n' << "registers end" << std::endl;*/
-
-                this->isMaterialized = true;
-            }
-            if (this->current_index < static_cast<int>(this->registers.size())) {
-                this->output_regs = this->registers[this->current_index];
-                ++this->current_index;
-                return true;
             }
-            return false;
-
+            return entry;
         }
 
-        void HashJoin::close() {
-            this->input_left->close();
-            this->input_right->close();
+
+        bool GroupJoin::is_left_aggregate(size_t a) const {
+            return this->aggr_funcs[a].attr_index < this->left_arity;
         }
 
 
-        std::vector<Register*> HashJoin::get_output() {
-            std::vector<Register*> output;
-            for (auto& reg : this->output_regs) {
-                output.push_back(&reg);
+        void GroupJoin::update(size_t a, Register& slot, const Register& value, bool first) const {
+            switch (this->aggr_funcs[a].func) {
+                case HashAggregation::AggrFunc::MIN:
+                    if (first || value < slot) {
+                        slot = value;
+                    }
+                    break;
+                case HashAggregation::AggrFunc::MAX:
+                    if (first || value > slot) {
+                        slot = value;
+                    }
+                    break;
+                case HashAggregation::AggrFunc::SUM:
+                    slot = first ? to_sum(value) : add_sums(slot, to_sum(value));
+                    break;
+                default:
+                    break;
             }
-            return output;
         }
 
 
-        HashAggregation::HashAggregation(
-                Operator& input,
-                std::vector<size_t> group_by_attrs,
-                std::vector<AggrFunc> aggr_funcs
-        ) : UnaryOperator(input) {
-            this->group_by_attrs = std::move(group_by_attrs);
-            this->aggr_funcs = std::move(aggr_funcs);
+        void GroupJoin::build() {
+            size_t width = this->aggr_funcs.size();
+            this->keys.clear();
+            this->key_hashes.clear();
+            this->chain.clear();
+            this->left_counts.clear();
+            this->right_counts.clear();
+            this->aggregates.clear();
+            this->buckets.assign(directory_size(HashJoin::probe_group_size), 0);
+            this->left_arity = 0;
+
+            while (this->input_left->next()) {
+                this->check_interrupted();
+                std::vector<Register*> regs = this->input_left->get_output();
+                this->left_arity = regs.size();
+                const Register& key = *regs[this->attr_index_left];
+                uint64_t hash;
+                if (this->reuse_left_hash) {
+                    hash = this->input_left->get_output_hash();
+                } else {
+                    hash = this->is_typed ? Register::hash(key, this->key_type) : key.get_hash();
+                }
+                size_t entry = this->find(key, hash);
+                if (entry == 0) {
+                    this->keys.push_back(key);
+                    this->key_hashes.push_back(hash);
+                    this->left_counts.push_back(0);
+                    this->right_counts.push_back(0);
+                    this->aggregates.resize(this->aggregates.size() + width);
+                    size_t& head = this->buckets[hash & (this->buckets.size() - 1)];
+                    this->chain.push_back(head);
+                    head = this->keys.size();
+                    entry = this->keys.size();
+                    if (this->keys.size() * 2 > this->buckets.size()) {
+                        // Rebuild the directory with twice the number of
+                        // buckets.
+                        this->buckets.assign(this->buckets.size() * 2, 0);
+                        size_t mask = this->buckets.size() - 1;
+                        for (size_t i = 0; i < this->keys.size(); ++i) {
+                            size_t& bucket = this->buckets[this->key_hashes[i] & mask];
+                            this->chain[i] = bucket;
+                            bucket = i + 1;
+                        }
+                    }
+                }
+
+                size_t index = entry - 1;
+                bool first = this->left_counts[index]++ == 0;
+                for (size_t a = 0; a < width; ++a) {
+                    auto& func = this->aggr_funcs[a];
+                    if (func.func != HashAggregation::AggrFunc::COUNT && this->is_left_aggregate(a)) {
+                        this->update(a, this->aggregates[index * width + a], *regs[func.attr_index], first);
+                    }
+                }
+            }
         }
 
 
-        HashAggregation::~HashAggregation() = default;
+        void GroupJoin::probe() {
+            size_t width = this->aggr_funcs.size();
+            size_t mask = this->buckets.size() - 1;
+            std::array<uint64_t, HashJoin::probe_group_size> hashes{};
+            std::vector<std::vector<Register>> tuples(HashJoin::probe_group_size);
 
+            while (true) {
+                // Stage 1: fetch a group of tuples, hash their keys and
+                // prefetch the buckets.
+                size_t count = 0;
+                while (count < HashJoin::probe_group_size && this->input_right->next()) {
+                    this->check_interrupted();
+                    std::vector<Register*> regs = this->input_right->get_output();
+                    auto& tuple = tuples[count];
+                    tuple.resize(regs.size());
+                    for (size_t i = 0; i < regs.size(); ++i) {
+                        tuple[i] = *regs[i];
+                    }
+                    if (this->reuse_right_hash) {
+                        hashes[count] = this->input_right->get_output_hash();
+                    }
+                    ++count;
+                }
+                if (count == 0) {
+                    break;
+                }
+                for (size_t i = 0; i < count; ++i) {
+                    if (!this->reuse_right_hash) {
+                        const Register& key = tuples[i][this->attr_index_right];
+                        hashes[i] = this->is_typed ? Register::hash(key, this->key_type) : key.get_hash();
+                    }
+                    __builtin_prefetch(&this->buckets[hashes[i] & mask]);
+                }
 
-        void HashAggregation::open() {
-            this->input->open();
+                // Stage 2: find the entries and aggregate into them.
+                for (size_t i = 0; i < count; ++i) {
+                    auto& tuple = tuples[i];
+                    size_t entry = this->find(tuple[this->attr_index_right], hashes[i]);
+                    if (entry == 0) {
+                        continue;
+                    }
+                    size_t index = entry - 1;
+                    bool first = this->right_counts[index]++ == 0;
+                    for (size_t a = 0; a < width; ++a) {
+                        auto& func = this->aggr_funcs[a];
+                        if (func.func != HashAggregation::AggrFunc::COUNT && !this->is_left_aggregate(a)) {
+                            this->update(
+                                a, this->aggregates[index * width + a], tuple[func.attr_index - this->left_arity], first);
+                        }
+                    }
+                }
+            }
         }
 
 
-        bool HashAggregation::next() {
-            this->output_regs.clear();
-            std::experimental::optional<Register> minRegister;
-            std::experimental::optional<Register> maxRegister;
-            std::unordered_map<Register, int, RegisterHasher> countMap;
-            std::unordered_map<Register, int, RegisterHasher> sumMap;
+        bool GroupJoin::next() {
             if (!this->isMaterialized) {
-                while (this->input->next()) {
-                    std::vector<Register *> regs = this->input->get_output();
-                    for (AggrFunc func : this->aggr_funcs) {
-                        switch (func.func) {
-                            case AggrFunc::MIN:
-                                if (!minRegister) {
-                                    minRegister = *regs[func.attr_index];
-                                } else {
-                                    if (*regs[func.attr_index] < *minRegister) {
-                                        minRegister = *regs[func.attr_index];
-                                    }
-                                }
-                                break;
-                            case AggrFunc::MAX:
-                                if (!maxRegister) {
-                                    maxRegister = *regs[func.attr_index];
-                                } else {
-                                    if (*regs[func.attr_index] > *maxRegister) {
-                                        maxRegister = *regs[func.attr_index];
-                                    }
-                                }
-                                break;
-                            case AggrFunc::COUNT:
-                                for (size_t attr : this->group_by_attrs) {
-                                    auto it = countMap.find(*regs[attr]);
-                                    if (it == countMap.end()) {
-                                        countMap.insert({*regs[attr], 1});
-                                    } else {
-                                        countMap[*regs[attr]] += 1;
-                                    }
-                                }
-                                break;
-                            case AggrFunc::SUM:
-                                for (size_t attr : this->group_by_attrs) {
-                                    Register myreg = *regs[attr];
-                                    auto it = sumMap.find(myreg);
-                                    Register r = *regs[func.attr_index];
-                                    if (it == sumMap.end()) {
-                                        sumMap.insert({myreg, static_cast<int>(r.as_int())});
-                                    } else {
-                                        sumMap[myreg] += static_cast<int>(r.as_int());
-                                    }
-                                }
-                                break;
-                        }
-                    }
-
+                this->build();
+                if (!this->keys.empty()) {
+                    this->probe();
                 }
-                if (sumMap.size() > 0) {
-                    std::vector<Register> keys;
-                    keys.reserve(sumMap.size());
-                    for (auto it : sumMap) {
-                        keys.push_back(it.first);
-                    }
-                    this->numberOfKeys = static_cast<int>(keys.size());
-                    std::sort(keys.begin(), keys.end());
-                    for (auto& it : keys) {
-                        std::vector<Register> reg_vector;
-                        reg_vector.push_back(it);
-                        auto sumRegister = Register::from_int(sumMap[it]);
-                        reg_vector.push_back(sumRegister);
-                        auto countRegister = Register::from_int(countMap[it]);
-                        reg_vector.push_back(countRegister);
-                        this->temp_sumcount_registers.push_back(reg_vector);
-                        /*std::cout << " " << it.as_int() << " sum: " << sumMap[it] <<
-                                  " count: " << countMap[it];
-                        std::cout << std::endl;*/
-                    }
+                if (this->token != nullptr) {
+                    this->token->check();
                 }
                 this->isMaterialized = true;
             }
-            if (minRegister) {
-                this->output_regs.push_back(*minRegister);
-                if (maxRegister) {
-                    this->output_regs.push_back(*maxRegister);
+
+            // Every left tuple of a key joins with every right tuple of it, so
+            // counts and sums of one side are multiplied by the number of
+            // tuples of the other side.
+            size_t width = this->aggr_funcs.size();
+            while (this->current_index < this->keys.size()) {
+                size_t index = this->current_index++;
+                int64_t right_count = this->right_counts[index];
+                if (right_count == 0) {
+                    continue;
+                }
+                int64_t left_count = this->left_counts[index];
+                this->output_regs.clear();
+                this->output_regs.push_back(this->keys[index]);
+                this->output_hash = this->key_hashes[index];
+                for (size_t a = 0; a < width; ++a) {
+                    const Register& value = this->aggregates[index * width + a];
+                    switch (this->aggr_funcs[a].func) {
+                        case HashAggregation::AggrFunc::COUNT:
+                            this->output_regs.push_back(Register::from_int(left_count * right_count));
+                            break;
+                        case HashAggregation::AggrFunc::SUM:
+                            this->output_regs.push_back(
+                                to_sum(value, this->is_left_aggregate(a) ? right_count : left_count));
+                            break;
+                        default:
+                            this->output_regs.push_back(value);
+                            break;
+                    }
                 }
-                return true;
-            }
-            if (this->counter_index < this->numberOfKeys) {
-                this->output_regs = this->temp_sumcount_registers[this->counter_index];
-                ++this->counter_index;
                 return true;
             }
             return false;
-        };
-
-
-        void HashAggregation::close() {
-            this->input->close();
         }
 
 
-        std::vector<Register*> HashAggregation::get_output() {
+        void GroupJoin::close() {
+            this->input_left->close();
+            this->input_right->close();
+            this->keys.clear();
+            this->keys.shrink_to_fit();
+            this->key_hashes.clear();
+            this->key_hashes.shrink_to_fit();
+            this->buckets.clear();
+            this->buckets.shrink_to_fit();
+            this->chain.clear();
+            this->chain.shrink_to_fit();
+            this->left_counts.clear();
+            this->left_counts.shrink_to_fit();
+            this->right_counts.clear();
+            this->right_counts.shrink_to_fit();
+            this->aggregates.clear();
+            this->aggregates.shrink_to_fit();
+            this->isMaterialized = false;
+            this->current_index = 0;
+        }
+
+
+        std::vector<Register*> GroupJoin::get_output() {
             std::vector<Register*> output;
+            output.reserve(this->output_regs.size());
             for (auto& reg : this->output_regs) {
                 output.push_back(&reg);
             }
@@ -803,8 +3259,9 @@ namespace moderndbs {
 
 
         void Union::open() {
-           this->input_left->open();
-           this->input_right->open();
+            this->input_left->open();
+            this->input_right->open();
+            this->schema = set_operation_schema(this->input_left->get_schema());
         }
 
 
@@ -812,6 +3269,7 @@ namespace moderndbs {
             if (!this->isMaterialized) {
                 std::unordered_map<Register, int, RegisterHasher> registers_map;
                 while (this->input_left->next()) {
+                    this->check_interrupted();
                     std::vector<Register*> regs = this->input_left->get_output();
                     for (auto it : regs) {
                         auto got = registers_map.find(*it);
@@ -824,6 +3282,7 @@ namespace moderndbs {
                 }
 
                 while (this->input_right->next()) {
+                    this->check_interrupted();
                     std::vector<Register*> regs = this->input_right->get_output();
                     for (auto it : regs) {
                         auto got = registers_map.find(*it);
@@ -873,6 +3332,10 @@ namespace moderndbs {
         void Union::close() {
             this->input_left->close();
             this->input_right->close();
+            this->registers.clear();
+            this->registers.shrink_to_fit();
+            this->isMaterialized = false;
+            this->counter_index = 0;
         }
 
 
@@ -887,6 +3350,7 @@ namespace moderndbs {
         void UnionAll::open() {
             this->input_left->open();
             this->input_right->open();
+            this->schema = set_operation_schema(this->input_left->get_schema());
         }
 
 
@@ -894,6 +3358,7 @@ namespace moderndbs {
             if (!this->isMaterialized) {
                 std::unordered_map<Register, int, RegisterHasher> registers_map;
                 while (this->input_left->next()) {
+                    this->check_interrupted();
                     std::vector<Register*> regs = this->input_left->get_output();
                     for (auto it : regs) {
                         auto got = registers_map.find(*it);
@@ -906,6 +3371,7 @@ namespace moderndbs {
                 }
 
                 while (this->input_right->next()) {
+                    this->check_interrupted();
                     std::vector<Register*> regs = this->input_right->get_output();
                     for (auto it : regs) {
                         auto got = registers_map.find(*it);
@@ -952,6 +3418,10 @@ namespace moderndbs {
         void UnionAll::close() {
             this->input_left->close();
             this->input_right->close();
+            this->registers.clear();
+            this->registers.shrink_to_fit();
+            this->isMaterialized = false;
+            this->counter_index = 0;
         }
 
 
@@ -967,6 +3437,7 @@ namespace moderndbs {
         void Intersect::open() {
             this->input_left->open();
             this->input_right->open();
+            this->schema = set_operation_schema(this->input_left->get_schema());
         }
 
 
@@ -975,6 +3446,7 @@ namespace moderndbs {
                 std::unordered_map<Register, int, RegisterHasher> left_registers;
                 std::unordered_map<Register, int, RegisterHasher> right_registers;
                 while (this->input_left->next()) {
+                    this->check_interrupted();
                     std::vector<Register*> regs = this->input_left->get_output();
                     for (auto it : regs) {
                         auto got = left_registers.find(*it);
@@ -992,6 +3464,7 @@ namespace moderndbs {
                 std::cout << '\n';
                 std::cout << '\n' << "left side end" << std::endl;*/
                 while (this->input_right->next()) {
+                    this->check_interrupted();
                     std::vector<Register*> regs = this->input_right->get_output();
                     for (auto it : regs) {
                         auto got = right_registers.find(*it);
@@ -1044,6 +3517,10 @@ namespace moderndbs {
         void Intersect::close() {
            this->input_left->close();
            this->input_right->close();
+            this->registers.clear();
+            this->registers.shrink_to_fit();
+            this->isMaterialized = false;
+            this->counter_index = 0;
         }
 
 
@@ -1056,8 +3533,9 @@ namespace moderndbs {
 
 
         void IntersectAll::open() {
-           this->input_left->open();
-           this->input_right->open();
+            this->input_left->open();
+            this->input_right->open();
+            this->schema = set_operation_schema(this->input_left->get_schema());
         }
 
 
@@ -1066,6 +3544,7 @@ namespace moderndbs {
                 std::unordered_map<Register, int, RegisterHasher> left_registers;
                 std::unordered_map<Register, int, RegisterHasher> right_registers;
                 while (this->input_left->next()) {
+                    this->check_interrupted();
                     std::vector<Register*> regs = this->input_left->get_output();
                     for (auto it : regs) {
                         auto got = left_registers.find(*it);
@@ -1078,6 +3557,7 @@ namespace moderndbs {
                 }
 
                 while (this->input_right->next()) {
+                    this->check_interrupted();
                     std::vector<Register*> regs = this->input_right->get_output();
                     for (auto it : regs) {
                         auto got = right_registers.find(*it);
@@ -1134,6 +3614,10 @@ namespace moderndbs {
         void IntersectAll::close() {
             this->input_left->close();
             this->input_right->close();
+            this->registers.clear();
+            this->registers.shrink_to_fit();
+            this->isMaterialized = false;
+            this->counter_index = 0;
         }
 
 
@@ -1148,6 +3632,7 @@ namespace moderndbs {
         void Except::open() {
             this->input_left->open();
             this->input_right->open();
+            this->schema = set_operation_schema(this->input_left->get_schema());
         }
 
 
@@ -1156,6 +3641,7 @@ namespace moderndbs {
                 std::unordered_map<Register, int, RegisterHasher> left_registers;
                 std::unordered_map<Register, int, RegisterHasher> right_registers;
                 while (this->input_left->next()) {
+                    this->check_interrupted();
                     std::vector<Register*> regs = this->input_left->get_output();
                     for (auto it : regs) {
                         auto got = left_registers.find(*it);
@@ -1168,6 +3654,7 @@ namespace moderndbs {
                 }
 
                 while (this->input_right->next()) {
+                    this->check_interrupted();
                     std::vector<Register*> regs = this->input_right->get_output();
                     for (auto it : regs) {
                         auto got = right_registers.find(*it);
@@ -1214,6 +3701,10 @@ namespace moderndbs {
         void Except::close() {
             this->input_left->close();
             this->input_right->close();
+            this->registers.clear();
+            this->registers.shrink_to_fit();
+            this->isMaterialized = false;
+            this->counter_index = 0;
         }
 
 
@@ -1228,6 +3719,7 @@ namespace moderndbs {
         void ExceptAll::open() {
             this->input_left->open();
             this->input_right->open();
+            this->schema = set_operation_schema(this->input_left->get_schema());
         }
 
 
@@ -1236,6 +3728,7 @@ namespace moderndbs {
                 std::unordered_map<Register, int, RegisterHasher> left_registers;
                 std::unordered_map<Register, int, RegisterHasher> right_registers;
                 while (this->input_left->next()) {
+                    this->check_interrupted();
                     std::vector<Register*> regs = this->input_left->get_output();
                     for (auto it : regs) {
                         auto got = left_registers.find(*it);
@@ -1248,6 +3741,7 @@ namespace moderndbs {
                 }
 
                 while (this->input_right->next()) {
+                    this->check_interrupted();
                     std::vector<Register*> regs = this->input_right->get_output();
                     for (auto it : regs) {
                         auto got = right_registers.find(*it);
@@ -1305,6 +3799,10 @@ namespace moderndbs {
         void ExceptAll::close() {
             this->input_left->close();
             this->input_right->close();
+            this->registers.clear();
+            this->registers.shrink_to_fit();
+            this->isMaterialized = false;
+            this->counter_index = 0;
         }
 
     }  // namespace iterator_model
@@ -0,0 +1,246 @@
+#include <algorithm>
+#include <utility>
+#include "moderndbs/execution.h"
+
+namespace moderndbs {
+    namespace iterator_model {
+
+        Query::Query(Scheduler& scheduler, Operator& root, size_t batch_size, size_t max_pending_batches) {
+            this->scheduler = &scheduler;
+            this->root = &root;
+            this->batch_size = std::max<size_t>(batch_size, 1);
+            this->max_pending_batches = std::max<size_t>(max_pending_batches, 1);
+        }
+
+
+        void Query::step() {
+            Batch batch;
+            bool exhausted = false;
+            std::exception_ptr step_error;
+            bool skip = false;
+            {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                skip = this->cancelled;
+            }
+            if (!skip) {
+                try {
+                    if (!this->opened) {
+                        this->opened = true;
+                        this->root->set_cancellation_token(&this->token);
+                        this->root->open();
+                    }
+                    // Streaming operators do not look at the token, so the
+                    // query does once per batch.
+                    this->token.check();
+                    while (batch.size() < this->batch_size) {
+                        if (!this->root->next()) {
+                            exhausted = true;
+                            break;
+                        }
+                        std::vector<Register> tuple;
+                        for (auto* reg : this->root->get_output()) {
+                            tuple.push_back(*reg);
+                        }
+                        batch.push_back(std::move(tuple));
+                    }
+                } catch (...) {
+                    step_error = std::current_exception();
+                }
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                if (!batch.empty() && !this->cancelled) {
+                    this->batches.push_back(std::move(batch));
+                    this->batch_available.notify_all();
+                }
+                if (!exhausted && !step_error && !this->cancelled) {
+                    if (this->batches.size() >= this->max_pending_batches) {
+                        this->suspended = true;
+                    } else {
+                        auto self = this->shared_from_this();
+                        this->scheduler->schedule([self] { self->step(); });
+                    }
+                    return;
+                }
+            }
+            this->finish(step_error);
+        }
+
+
+        void Query::finish(std::exception_ptr step_error) {
+            if (this->opened) {
+                try {
+                    this->root->close();
+                } catch (...) {
+                    if (!step_error) {
+                        step_error = std::current_exception();
+                    }
+                }
+            }
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->finished = true;
+            if (this->cancelled) {
+                // The error of a cancelled query is the interruption itself.
+                this->batches.clear();
+            } else {
+                this->error = std::move(step_error);
+            }
+            this->batch_available.notify_all();
+        }
+
+
+        void Query::resume() {
+            if (this->suspended) {
+                this->suspended = false;
+                auto self = this->shared_from_this();
+                this->scheduler->schedule([self] { self->step(); });
+            }
+        }
+
+
+        bool Query::poll_batch(Batch& batch) {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            if (this->batches.empty()) {
+                return false;
+            }
+            batch = std::move(this->batches.front());
+            this->batches.pop_front();
+            this->resume();
+            return true;
+        }
+
+
+        bool Query::wait_batch(Batch& batch) {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->batch_available.wait(lock, [this] {
+                return !this->batches.empty() || this->finished;
+            });
+            if (!this->batches.empty()) {
+                batch = std::move(this->batches.front());
+                this->batches.pop_front();
+                this->resume();
+                return true;
+            }
+            if (this->error) {
+                std::rethrow_exception(this->error);
+            }
+            return false;
+        }
+
+
+        void Query::cancel() {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->cancelled = true;
+            this->token.cancel();
+            this->batches.clear();
+            this->batch_available.notify_all();
+            if (!this->finished) {
+                this->resume();
+            }
+        }
+
+
+        void Query::set_deadline(std::chrono::steady_clock::time_point deadline) {
+            this->token.set_deadline(deadline);
+        }
+
+
+        bool Query::is_cancelled() const {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            return this->cancelled;
+        }
+
+
+        bool Query::is_finished() const {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            return this->finished;
+        }
+
+
+        Scheduler::Scheduler(size_t thread_count) {
+            thread_count = std::max<size_t>(thread_count, 1);
+            for (size_t i = 0; i < thread_count; ++i) {
+                this->workers.emplace_back([this] { this->work(); });
+            }
+        }
+
+
+        Scheduler::~Scheduler() {
+            std::vector<std::shared_ptr<Query>> live_queries;
+            {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                for (auto& query : this->queries) {
+                    if (auto live_query = query.lock()) {
+                        live_queries.push_back(std::move(live_query));
+                    }
+                }
+            }
+            for (auto& query : live_queries) {
+                query->cancel();
+            }
+            {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                this->stopping = true;
+            }
+            this->task_available.notify_all();
+            for (auto& worker : this->workers) {
+                worker.join();
+            }
+        }
+
+
+        void Scheduler::schedule(std::function<void()> task) {
+            {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                this->tasks.push_back(std::move(task));
+            }
+            this->task_available.notify_one();
+        }
+
+
+        void Scheduler::work() {
+            while (true) {
+                std::function<void()> task;
+                {
+                    std::unique_lock<std::mutex> lock(this->mutex);
+                    this->task_available.wait(lock, [this] {
+                        return this->stopping || !this->tasks.empty();
+                    });
+                    // Remaining tasks are drained before stopping so that
+                    // cancelled queries still close their operators.
+                    if (this->tasks.empty()) {
+                        return;
+                    }
+                    task = std::move(this->tasks.front());
+                    this->tasks.pop_front();
+                }
+                task();
+            }
+        }
+
+
+        std::shared_ptr<Query> Scheduler::submit(
+                Operator& root,
+                size_t batch_size,
+                size_t max_pending_batches,
+                std::chrono::steady_clock::time_point deadline
+        ) {
+            auto query = std::make_shared<Query>(*this, root, batch_size, max_pending_batches);
+            if (deadline != std::chrono::steady_clock::time_point{}) {
+                query->set_deadline(deadline);
+            }
+            {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                this->queries.erase(
+                    std::remove_if(this->queries.begin(), this->queries.end(),
+                                   [](const std::weak_ptr<Query>& q) { return q.expired(); }),
+                    this->queries.end());
+                this->queries.push_back(query);
+            }
+            this->schedule([query] { query->step(); });
+            return query;
+        }
+
+    }  // namespace iterator_model
+}  // namespace moderndbs
@@ -0,0 +1,105 @@
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <limits>
+#include "moderndbs/german_string.h"
+#include "moderndbs/hash.h"
+
+namespace moderndbs {
+    namespace iterator_model {
+
+        GermanString GermanString::view(const char* data, size_t size) {
+            assert(size <= std::numeric_limits<uint32_t>::max());
+            GermanString string;
+            string.length = static_cast<uint32_t>(size);
+            if (size <= max_inline_size) {
+                std::memcpy(string.chars, data, size);
+            } else {
+                std::memcpy(string.chars, data, prefix_size);
+                std::memcpy(string.chars + prefix_size, &data, sizeof(data));
+            }
+            return string;
+        }
+
+
+        const char* GermanString::data() const {
+            if (this->is_inline()) {
+                return this->chars;
+            }
+            const char* data = nullptr;
+            std::memcpy(&data, this->chars + prefix_size, sizeof(data));
+            return data;
+        }
+
+
+        std::string GermanString::str() const {
+            return std::string(this->data(), this->size());
+        }
+
+
+        int GermanString::compare(const GermanString& other) const {
+            size_t common = std::min(this->size(), other.size());
+            // The prefixes are stored in both layouts.
+            int comparison = std::memcmp(this->chars, other.chars, std::min(common, prefix_size));
+            if (comparison == 0 && common > prefix_size) {
+                comparison = std::memcmp(this->data() + prefix_size, other.data() + prefix_size, common - prefix_size);
+            }
+            if (comparison != 0) {
+                return comparison;
+            }
+            return (this->size() > other.size()) - (this->size() < other.size());
+        }
+
+
+        uint64_t GermanString::get_hash() const {
+            return hash_bytes(this->data(), this->size());
+        }
+
+
+        bool operator==(const GermanString& s1, const GermanString& s2) {
+            // The length and the prefix are compared at once. Inline strings
+            // are padded with zeros, so their remaining bytes can be compared
+            // the same way.
+            uint64_t head1 = 0;
+            uint64_t head2 = 0;
+            std::memcpy(&head1, &s1, sizeof(head1));
+            std::memcpy(&head2, &s2, sizeof(head2));
+            if (head1 != head2) {
+                return false;
+            }
+            if (s1.is_inline()) {
+                return std::memcmp(s1.chars + GermanString::prefix_size, s2.chars + GermanString::prefix_size,
+                                   GermanString::max_inline_size - GermanString::prefix_size) == 0;
+            }
+            return std::memcmp(s1.data() + GermanString::prefix_size, s2.data() + GermanString::prefix_size,
+                               s1.size() - GermanString::prefix_size) == 0;
+        }
+
+
+        GermanString StringArena::store(const char* data, size_t size) {
+            if (size <= GermanString::max_inline_size) {
+                return GermanString::view(data, size);
+            }
+            if (size >= chunk_size) {
+                // Long strings get a chunk of their own and leave the current
+                // chunk in use.
+                this->chunks.emplace_back(new char[size]);
+                this->allocated_bytes += size;
+                std::memcpy(this->chunks.back().get(), data, size);
+                return GermanString::view(this->chunks.back().get(), size);
+            }
+            if (size > this->remaining) {
+                this->chunks.emplace_back(new char[chunk_size]);
+                this->allocated_bytes += chunk_size;
+                this->next = this->chunks.back().get();
+                this->remaining = chunk_size;
+            }
+            char* copy = this->next;
+            std::memcpy(copy, data, size);
+            this->next += size;
+            this->remaining -= size;
+            return GermanString::view(copy, size);
+        }
+
+    }  // namespace iterator_model
+}  // namespace moderndbs
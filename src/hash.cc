@@ -0,0 +1,44 @@
+#include <cstring>
+#include "moderndbs/hash.h"
+
+namespace moderndbs {
+    namespace iterator_model {
+
+        namespace {
+
+/// Loads up to eight bytes as an integer, padded with zeros.
+            uint64_t load_word(const char* data, size_t size) {
+                uint64_t word = 0;
+                std::memcpy(&word, data, size);
+                return word;
+            }
+
+
+/// Mixes the next eight bytes into `hash`.
+            uint64_t hash_step(uint64_t hash, uint64_t word) {
+#if defined(__SSE4_2__)
+                return _mm_crc32_u64(hash, word);
+#else
+                return (hash ^ word) * 0xc6a4a7935bd1e995ULL;
+#endif
+            }
+
+        }  // namespace
+
+
+        uint64_t hash_bytes(const char* data, size_t size) {
+            // The length is hashed as well, so zero padding does not collide
+            // with zero characters.
+            uint64_t hash = size;
+            size_t i = 0;
+            for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+                hash = hash_step(hash, load_word(data + i, sizeof(uint64_t)));
+            }
+            if (i < size) {
+                hash = hash_step(hash, load_word(data + i, size - i));
+            }
+            return hash_int(hash);
+        }
+
+    }  // namespace iterator_model
+}  // namespace moderndbs
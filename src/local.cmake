@@ -18,6 +18,17 @@ set(
 set(
     SRC_CC
     src/algebra.cc
+    src/execution.cc
+    src/german_string.cc
+    src/hash.cc
+    src/logical_plan.cc
+    src/plan_cache.cc
+    src/planner.cc
+    src/result_cache.cc
+    src/sample.cc
+    src/sketch.cc
+    src/statistics.cc
+    src/table.cc
 )
 
 # Gather lintable files
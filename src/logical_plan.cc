@@ -0,0 +1,1052 @@
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include "moderndbs/logical_plan.h"
+
+namespace moderndbs {
+    namespace iterator_model {
+
+        namespace {
+
+/// Returns true when `columns` contains `column`.
+            bool contains(const std::vector<ColumnId>& columns, ColumnId column) {
+                return std::find(columns.begin(), columns.end(), column) != columns.end();
+            }
+
+
+/// Returns true when `columns` contains all attributes of `needed`.
+            bool contains_all(const std::vector<ColumnId>& columns, const std::vector<ColumnId>& needed) {
+                for (ColumnId column : needed) {
+                    if (!contains(columns, column)) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+
+
+/// Returns the position of `column` in the tuples with the layout `columns`.
+            size_t position(const std::vector<ColumnId>& columns, ColumnId column) {
+                auto it = std::find(columns.begin(), columns.end(), column);
+                assert(it != columns.end());
+                return static_cast<size_t>(it - columns.begin());
+            }
+
+
+/// Filters `input` with the conjunction of `predicates`, if there are any.
+            LogicalNodePtr wrap_select(LogicalNodePtr input, std::vector<LogicalPredicate> predicates) {
+                if (predicates.empty()) {
+                    return input;
+                }
+                auto node = std::make_unique<LogicalNode>(LogicalNode::Kind::SELECT);
+                node->columns = input->columns;
+                node->predicates = std::move(predicates);
+                node->inputs.push_back(std::move(input));
+                return node;
+            }
+
+
+/// Rewrites `Intersect` and `Except` of single attributes into semi and anti
+/// joins on the distinct left input.
+            LogicalNodePtr convert_set_operations(LogicalNodePtr node) {
+                for (auto& input : node->inputs) {
+                    input = convert_set_operations(std::move(input));
+                }
+                if (node->kind != LogicalNode::Kind::SET_OPERATION || node->columns.size() != 1) {
+                    return node;
+                }
+                bool intersect = node->set_operation == Planner::SetOperation::INTERSECT;
+                if (!intersect && node->set_operation != Planner::SetOperation::EXCEPT) {
+                    return node;
+                }
+
+                auto distinct = std::make_unique<LogicalNode>(LogicalNode::Kind::AGGREGATION);
+                distinct->columns = node->inputs[0]->columns;
+                distinct->group_by = node->inputs[0]->columns;
+                distinct->inputs.push_back(std::move(node->inputs[0]));
+
+                auto join = std::make_unique<LogicalNode>(LogicalNode::Kind::JOIN);
+                join->columns = distinct->columns;
+                join->left_key = distinct->columns[0];
+                join->right_key = node->inputs[1]->columns[0];
+                join->join_type = intersect ? HashJoin::Type::SEMI : HashJoin::Type::ANTI;
+                join->inputs.push_back(std::move(distinct));
+                join->inputs.push_back(std::move(node->inputs[1]));
+                return join;
+            }
+
+
+/// Pushes `predicates` (which are evaluated on the output of `node`) and the
+/// predicates of all selections below `node` as far down as possible.
+            LogicalNodePtr push_down_predicates(LogicalNodePtr node, std::vector<LogicalPredicate> predicates) {
+                switch (node->kind) {
+                    case LogicalNode::Kind::SELECT: {
+                        for (auto& predicate : node->predicates) {
+                            predicates.push_back(std::move(predicate));
+                        }
+                        return push_down_predicates(std::move(node->inputs[0]), std::move(predicates));
+                    }
+                    case LogicalNode::Kind::PROJECTION:
+                    case LogicalNode::Kind::SORT: {
+                        node->inputs[0] = push_down_predicates(std::move(node->inputs[0]), std::move(predicates));
+                        return node;
+                    }
+                    case LogicalNode::Kind::JOIN: {
+                        std::vector<LogicalPredicate> left_predicates;
+                        std::vector<LogicalPredicate> right_predicates;
+                        std::vector<LogicalPredicate> remaining;
+                        for (auto& predicate : predicates) {
+                            auto columns = predicate.get_columns();
+                            if (contains_all(node->inputs[0]->columns, columns)) {
+                                left_predicates.push_back(std::move(predicate));
+                            } else if (node->join_type == HashJoin::Type::INNER
+                                       && contains_all(node->inputs[1]->columns, columns)) {
+                                right_predicates.push_back(std::move(predicate));
+                            } else {
+                                remaining.push_back(std::move(predicate));
+                            }
+                        }
+                        node->inputs[0] = push_down_predicates(std::move(node->inputs[0]), std::move(left_predicates));
+                        node->inputs[1] = push_down_predicates(std::move(node->inputs[1]), std::move(right_predicates));
+                        return wrap_select(std::move(node), std::move(remaining));
+                    }
+                    case LogicalNode::Kind::AGGREGATION: {
+                        std::vector<LogicalPredicate> below;
+                        std::vector<LogicalPredicate> remaining;
+                        for (auto& predicate : predicates) {
+                            if (contains_all(node->group_by, predicate.get_columns())) {
+                                below.push_back(std::move(predicate));
+                            } else {
+                                remaining.push_back(std::move(predicate));
+                            }
+                        }
+                        node->inputs[0] = push_down_predicates(std::move(node->inputs[0]), std::move(below));
+                        return wrap_select(std::move(node), std::move(remaining));
+                    }
+                    case LogicalNode::Kind::SET_OPERATION: {
+                        // Selections distribute over all set operators. The
+                        // right input gets the predicates on its
+                        // corresponding attributes.
+                        std::vector<LogicalPredicate> right_predicates;
+                        const auto& right_columns = node->inputs[1]->columns;
+                        for (auto& predicate : predicates) {
+                            LogicalPredicate mapped = predicate;
+                            mapped.column = right_columns[position(node->columns, predicate.column)];
+                            if (predicate.other_column) {
+                                mapped.other_column = right_columns[position(node->columns, *predicate.other_column)];
+                            }
+                            right_predicates.push_back(std::move(mapped));
+                        }
+                        node->inputs[0] = push_down_predicates(std::move(node->inputs[0]), std::move(predicates));
+                        node->inputs[1] = push_down_predicates(std::move(node->inputs[1]), std::move(right_predicates));
+                        return node;
+                    }
+                    case LogicalNode::Kind::SCAN:
+                        return wrap_select(std::move(node), std::move(predicates));
+                }
+                return node;
+            }
+
+
+/// Removes the sorts whose order is not observable. `order_required` is set
+/// when the order of the output of `node` matters.
+            LogicalNodePtr remove_redundant_sorts(LogicalNodePtr node, bool order_required) {
+                switch (node->kind) {
+                    case LogicalNode::Kind::SORT:
+                        // `Sort` is stable, so ties keep the order of its
+                        // input. SQL guarantees no order among ties, though,
+                        // so an inner sort is still not observable.
+                        node->inputs[0] = remove_redundant_sorts(std::move(node->inputs[0]), false);
+                        if (!order_required) {
+                            return std::move(node->inputs[0]);
+                        }
+                        return node;
+                    case LogicalNode::Kind::SELECT:
+                    case LogicalNode::Kind::PROJECTION:
+                        node->inputs[0] = remove_redundant_sorts(std::move(node->inputs[0]), order_required);
+                        return node;
+                    default:
+                        for (auto& input : node->inputs) {
+                            input = remove_redundant_sorts(std::move(input), false);
+                        }
+                        return node;
+                }
+            }
+
+
+/// Restricts the output of `node` to the attributes in `required` by narrowing
+/// a projection or by adding one.
+            LogicalNodePtr narrow(LogicalNodePtr node, const std::set<ColumnId>& required) {
+                std::vector<ColumnId> columns;
+                for (ColumnId column : node->columns) {
+                    if (required.count(column) > 0) {
+                        columns.push_back(column);
+                    }
+                }
+                if (columns.size() == node->columns.size() || columns.empty()) {
+                    return node;
+                }
+                if (node->kind == LogicalNode::Kind::PROJECTION) {
+                    node->columns = std::move(columns);
+                    return node;
+                }
+                auto projection = std::make_unique<LogicalNode>(LogicalNode::Kind::PROJECTION);
+                projection->columns = std::move(columns);
+                projection->inputs.push_back(std::move(node));
+                return projection;
+            }
+
+
+/// Removes unused aggregates, merges consecutive projections, removes
+/// projections that keep all attributes and restricts the inputs of joins and
+/// sorts to the attributes in `required` and those they use themselves.
+            LogicalNodePtr prune_columns(LogicalNodePtr node, const std::set<ColumnId>& required) {
+                switch (node->kind) {
+                    case LogicalNode::Kind::PROJECTION: {
+                        std::vector<ColumnId> columns;
+                        for (ColumnId column : node->columns) {
+                            if (required.count(column) > 0) {
+                                columns.push_back(column);
+                            }
+                        }
+                        if (!columns.empty()) {
+                            node->columns = std::move(columns);
+                        }
+                        std::set<ColumnId> input_required(node->columns.begin(), node->columns.end());
+                        auto input = prune_columns(std::move(node->inputs[0]), input_required);
+                        if (input->kind == LogicalNode::Kind::PROJECTION) {
+                            input = std::move(input->inputs[0]);
+                        }
+                        if (input->columns == node->columns) {
+                            return input;
+                        }
+                        node->inputs[0] = std::move(input);
+                        return node;
+                    }
+                    case LogicalNode::Kind::SELECT: {
+                        std::set<ColumnId> input_required = required;
+                        for (auto& predicate : node->predicates) {
+                            for (ColumnId column : predicate.get_columns()) {
+                                input_required.insert(column);
+                            }
+                        }
+                        node->inputs[0] = prune_columns(std::move(node->inputs[0]), input_required);
+                        node->columns = node->inputs[0]->columns;
+                        return node;
+                    }
+                    case LogicalNode::Kind::SORT: {
+                        std::set<ColumnId> input_required = required;
+                        for (auto& criterion : node->criteria) {
+                            input_required.insert(criterion.column);
+                        }
+                        node->inputs[0] = narrow(prune_columns(std::move(node->inputs[0]), input_required), input_required);
+                        node->columns = node->inputs[0]->columns;
+                        return node;
+                    }
+                    case LogicalNode::Kind::JOIN: {
+                        std::set<ColumnId> left_required{node->left_key};
+                        std::set<ColumnId> right_required{node->right_key};
+                        for (ColumnId column : required) {
+                            if (contains(node->inputs[0]->columns, column)) {
+                                left_required.insert(column);
+                            } else if (node->join_type == HashJoin::Type::INNER) {
+                                right_required.insert(column);
+                            }
+                        }
+                        node->inputs[0] = narrow(prune_columns(std::move(node->inputs[0]), left_required), left_required);
+                        node->inputs[1] = narrow(prune_columns(std::move(node->inputs[1]), right_required), right_required);
+                        node->columns = node->inputs[0]->columns;
+                        if (node->join_type == HashJoin::Type::INNER) {
+                            const auto& right_columns = node->inputs[1]->columns;
+                            node->columns.insert(node->columns.end(), right_columns.begin(), right_columns.end());
+                        }
+                        return node;
+                    }
+                    case LogicalNode::Kind::AGGREGATION: {
+                        std::vector<LogicalAggregate> aggregates;
+                        for (auto& aggregate : node->aggregates) {
+                            if (required.count(aggregate.result) > 0) {
+                                aggregates.push_back(aggregate);
+                            }
+                        }
+                        // Without group by attributes, one aggregate has to
+                        // remain so that the output is not empty.
+                        if (aggregates.empty() && node->group_by.empty() && !node->aggregates.empty()) {
+                            aggregates.push_back(node->aggregates.front());
+                        }
+                        node->aggregates = std::move(aggregates);
+                        node->columns = node->group_by;
+                        std::set<ColumnId> input_required(node->group_by.begin(), node->group_by.end());
+                        for (auto& aggregate : node->aggregates) {
+                            node->columns.push_back(aggregate.result);
+                            input_required.insert(aggregate.column);
+                        }
+                        node->inputs[0] = prune_columns(std::move(node->inputs[0]), input_required);
+                        return node;
+                    }
+                    case LogicalNode::Kind::SET_OPERATION: {
+                        // Set operators compare whole tuples.
+                        for (auto& input : node->inputs) {
+                            std::set<ColumnId> input_required(input->columns.begin(), input->columns.end());
+                            input = prune_columns(std::move(input), input_required);
+                        }
+                        return node;
+                    }
+                    case LogicalNode::Kind::SCAN:
+                        return node;
+                }
+                return node;
+            }
+
+
+/// Estimates the output statistics of applying `predicate` to `input`.
+            TableStatistics estimate_predicate(
+                    const TableStatistics& input,
+                    const LogicalPredicate& predicate,
+                    const std::vector<ColumnId>& layout
+            ) {
+                size_t attr_index = position(layout, predicate.column);
+                if (predicate.parameter) {
+                    return estimate_parameter_select(input, attr_index, predicate.predicate_type);
+                }
+                if (predicate.other_column) {
+                    return estimate_select(input, Select::PredicateAttributeAttribute{
+                        attr_index, position(layout, *predicate.other_column), predicate.predicate_type});
+                }
+                switch (predicate.constant.get_type()) {
+                    case Register::Type::INT64:
+                        return estimate_select(input, Select::PredicateAttributeInt64{
+                            attr_index, predicate.constant.as_int(), predicate.predicate_type});
+                    case Register::Type::CHAR16:
+                        return estimate_select(input, Select::PredicateAttributeChar16{
+                            attr_index, predicate.constant.as_string(), predicate.predicate_type});
+                    default:
+                        return estimate_select(input, Select::PredicateAttributeValue{
+                            attr_index, predicate.constant, predicate.predicate_type});
+                }
+            }
+
+
+/// Plans a `Select` that applies `predicate` to `input`.
+            PlannedOperator plan_predicate(
+                    Planner& planner,
+                    const PlannedOperator& input,
+                    const LogicalPredicate& predicate,
+                    const std::vector<ColumnId>& layout
+            ) {
+                size_t attr_index = position(layout, predicate.column);
+                if (predicate.other_column) {
+                    return planner.select(input, Select::PredicateAttributeAttribute{
+                        attr_index, position(layout, *predicate.other_column), predicate.predicate_type});
+                }
+                switch (predicate.constant.get_type()) {
+                    case Register::Type::INT64:
+                        return planner.select(input, Select::PredicateAttributeInt64{
+                            attr_index, predicate.constant.as_int(), predicate.predicate_type});
+                    case Register::Type::CHAR16:
+                        return planner.select(input, Select::PredicateAttributeChar16{
+                            attr_index, predicate.constant.as_string(), predicate.predicate_type});
+                    default:
+                        return planner.select(input, Select::PredicateAttributeValue{
+                            attr_index, predicate.constant, predicate.predicate_type});
+                }
+            }
+
+
+/// The largest number of relations whose join order is enumerated. The joins
+/// of larger join graphs keep the order of the query.
+            constexpr size_t max_enumerated_relations = 16;
+
+
+/// A join predicate `left_column = right_column` between two relations.
+            struct JoinEdge {
+                size_t left;
+                size_t right;
+                ColumnId left_column;
+                ColumnId right_column;
+            };
+
+
+/// The relations and predicates of a tree of inner joins and the selections
+/// on top of them.
+            struct JoinGraph {
+                /// The slots of the relations in the plan.
+                std::vector<LogicalNodePtr*> relations;
+                /// The join predicates and the predicates of the selections.
+                std::vector<LogicalPredicate> predicates;
+            };
+
+
+/// The cheapest plan for a set of relations.
+            struct JoinCandidate {
+                /// The estimated cost as sum of the cardinalities of all
+                /// intermediate results.
+                double cost = 0;
+                TableStatistics statistics;
+                std::vector<ColumnId> columns;
+                /// The sets of relations of the inputs, both 0 for a single
+                /// relation.
+                uint64_t left = 0;
+                uint64_t right = 0;
+                /// The edge whose attributes are the join keys.
+                size_t key_edge = 0;
+            };
+
+
+/// Returns true when `node` is an inner join.
+            bool is_inner_join(const LogicalNode& node) {
+                return node.kind == LogicalNode::Kind::JOIN && node.join_type == HashJoin::Type::INNER;
+            }
+
+
+/// Returns true when `node` is the root of a tree of inner joins.
+            bool is_join_tree(const LogicalNode& node) {
+                if (node.kind == LogicalNode::Kind::SELECT) {
+                    return is_inner_join(*node.inputs[0]);
+                }
+                return is_inner_join(node);
+            }
+
+
+            LogicalNodePtr reorder_joins(LogicalNodePtr node);
+
+
+/// Collects the relations and predicates of the join tree in `slot`. The join
+/// trees within the relations are reordered on the way.
+            void collect_join_graph(LogicalNodePtr& slot, JoinGraph& graph) {
+                LogicalNode& node = *slot;
+                if (node.kind == LogicalNode::Kind::SELECT && is_inner_join(*node.inputs[0])) {
+                    graph.predicates.insert(graph.predicates.end(), node.predicates.begin(), node.predicates.end());
+                    collect_join_graph(node.inputs[0], graph);
+                    return;
+                }
+                if (is_inner_join(node)) {
+                    graph.predicates.push_back(
+                        LogicalPredicate{node.left_key, Select::PredicateType::EQ, Register{}, node.right_key, {}});
+                    collect_join_graph(node.inputs[0], graph);
+                    collect_join_graph(node.inputs[1], graph);
+                    return;
+                }
+                slot = reorder_joins(std::move(slot));
+                graph.relations.push_back(&slot);
+            }
+
+
+/// Finds the cheapest join tree over a connected join graph with the DPccp
+/// algorithm of Moerkotte and Neumann, which enumerates every pair of
+/// connected subgraphs with a connected complement exactly once. Relations
+/// must be numbered in breadth-first order. Sets of relations are bitmasks.
+            class JoinEnumerator {
+            private:
+                const std::vector<JoinEdge>& edges;
+                /// The neighbors of every relation.
+                std::vector<uint64_t> adjacency;
+                std::unordered_map<uint64_t, JoinCandidate> best;
+
+                /// Returns the set of relations that are adjacent to `set`
+                /// and not in `excluded`.
+                uint64_t neighborhood(uint64_t set, uint64_t excluded) const {
+                    uint64_t neighbors = 0;
+                    for (size_t i = 0; i < this->adjacency.size(); ++i) {
+                        if ((set >> i) & 1) {
+                            neighbors |= this->adjacency[i];
+                        }
+                    }
+                    return neighbors & ~set & ~excluded;
+                }
+
+                /// Enumerates the connected supersets of `set` that only add
+                /// relations outside of `excluded`.
+                void enumerate_csg_rec(uint64_t set, uint64_t excluded) {
+                    uint64_t neighbors = this->neighborhood(set, excluded);
+                    for (uint64_t subset = neighbors & -neighbors; subset != 0; subset = (subset - neighbors) & neighbors) {
+                        this->emit_csg(set | subset);
+                    }
+                    for (uint64_t subset = neighbors & -neighbors; subset != 0; subset = (subset - neighbors) & neighbors) {
+                        this->enumerate_csg_rec(set | subset, excluded | neighbors);
+                    }
+                }
+
+                /// Enumerates the connected complements of the connected set
+                /// `set`.
+                void emit_csg(uint64_t set) {
+                    uint64_t lowest = set & -set;
+                    uint64_t excluded = set | (lowest | (lowest - 1));
+                    uint64_t neighbors = this->neighborhood(set, excluded);
+                    for (size_t i = this->adjacency.size(); i-- > 0;) {
+                        uint64_t relation = uint64_t{1} << i;
+                        if ((neighbors & relation) == 0) {
+                            continue;
+                        }
+                        this->emit_csg_cmp(set, relation);
+                        this->enumerate_cmp_rec(set, relation, excluded | (neighbors & (relation | (relation - 1))));
+                    }
+                }
+
+                /// Enumerates the connected supersets of the complement
+                /// `complement` of `set`.
+                void enumerate_cmp_rec(uint64_t set, uint64_t complement, uint64_t excluded) {
+                    uint64_t neighbors = this->neighborhood(complement, excluded);
+                    for (uint64_t subset = neighbors & -neighbors; subset != 0; subset = (subset - neighbors) & neighbors) {
+                        this->emit_csg_cmp(set, complement | subset);
+                    }
+                    for (uint64_t subset = neighbors & -neighbors; subset != 0; subset = (subset - neighbors) & neighbors) {
+                        this->enumerate_cmp_rec(set, complement | subset, excluded | neighbors);
+                    }
+                }
+
+                /// Considers joining the plans of `left` and `right`.
+                void emit_csg_cmp(uint64_t left, uint64_t right) {
+                    const JoinCandidate& left_plan = this->best.at(left);
+                    const JoinCandidate& right_plan = this->best.at(right);
+                    JoinCandidate candidate;
+                    candidate.left = left;
+                    candidate.right = right;
+                    candidate.columns = left_plan.columns;
+                    candidate.columns.insert(candidate.columns.end(), right_plan.columns.begin(), right_plan.columns.end());
+
+                    // The edge with the smallest result becomes the join key,
+                    // the other edges are applied as selections.
+                    bool has_key = false;
+                    for (size_t i = 0; i < this->edges.size(); ++i) {
+                        auto& edge = this->edges[i];
+                        bool forward = ((left >> edge.left) & 1) && ((right >> edge.right) & 1);
+                        bool backward = ((left >> edge.right) & 1) && ((right >> edge.left) & 1);
+                        if (!forward && !backward) {
+                            continue;
+                        }
+                        TableStatistics statistics = estimate_join(
+                            left_plan.statistics, right_plan.statistics,
+                            position(left_plan.columns, forward ? edge.left_column : edge.right_column),
+                            position(right_plan.columns, forward ? edge.right_column : edge.left_column));
+                        if (!has_key || statistics.row_count < candidate.statistics.row_count) {
+                            candidate.statistics = std::move(statistics);
+                            candidate.key_edge = i;
+                            has_key = true;
+                        }
+                    }
+                    assert(has_key);
+                    for (size_t i = 0; i < this->edges.size(); ++i) {
+                        auto& edge = this->edges[i];
+                        uint64_t endpoints = (uint64_t{1} << edge.left) | (uint64_t{1} << edge.right);
+                        if (i == candidate.key_edge || (endpoints & left) == 0 || (endpoints & right) == 0) {
+                            continue;
+                        }
+                        candidate.statistics = estimate_select(candidate.statistics, Select::PredicateAttributeAttribute{
+                            position(candidate.columns, edge.left_column),
+                            position(candidate.columns, edge.right_column),
+                            Select::PredicateType::EQ});
+                    }
+                    candidate.cost = left_plan.cost + right_plan.cost
+                        + static_cast<double>(candidate.statistics.row_count);
+
+                    auto it = this->best.find(left | right);
+                    if (it == this->best.end() || candidate.cost < it->second.cost) {
+                        this->best[left | right] = std::move(candidate);
+                    }
+                }
+
+            public:
+                JoinEnumerator(std::vector<JoinCandidate> relations, const std::vector<JoinEdge>& edges)
+                    : edges(edges), adjacency(relations.size(), 0) {
+                    for (auto& edge : edges) {
+                        this->adjacency[edge.left] |= uint64_t{1} << edge.right;
+                        this->adjacency[edge.right] |= uint64_t{1} << edge.left;
+                    }
+                    for (size_t i = 0; i < relations.size(); ++i) {
+                        this->best[uint64_t{1} << i] = std::move(relations[i]);
+                    }
+                }
+
+                /// Enumerates all join trees and returns the plans of all sets
+                /// of relations that were considered.
+                const std::unordered_map<uint64_t, JoinCandidate>& run() {
+                    for (size_t i = this->adjacency.size(); i-- > 0;) {
+                        uint64_t relation = uint64_t{1} << i;
+                        this->emit_csg(relation);
+                        this->enumerate_csg_rec(relation, relation | (relation - 1));
+                    }
+                    return this->best;
+                }
+            };
+
+
+/// Builds the join tree of `set` from the cheapest plans.
+            LogicalNodePtr build_join_tree(
+                    uint64_t set,
+                    const std::unordered_map<uint64_t, JoinCandidate>& best,
+                    const std::vector<JoinEdge>& edges,
+                    std::vector<LogicalNodePtr*>& relations
+            ) {
+                const JoinCandidate& plan = best.at(set);
+                if (plan.left == 0) {
+                    size_t relation = 0;
+                    while (((set >> relation) & 1) == 0) {
+                        ++relation;
+                    }
+                    return std::move(*relations[relation]);
+                }
+
+                auto node = std::make_unique<LogicalNode>(LogicalNode::Kind::JOIN);
+                node->columns = plan.columns;
+                const JoinEdge& key = edges[plan.key_edge];
+                bool forward = (plan.left >> key.left) & 1;
+                node->left_key = forward ? key.left_column : key.right_column;
+                node->right_key = forward ? key.right_column : key.left_column;
+                node->inputs.push_back(build_join_tree(plan.left, best, edges, relations));
+                node->inputs.push_back(build_join_tree(plan.right, best, edges, relations));
+
+                std::vector<LogicalPredicate> predicates;
+                for (size_t i = 0; i < edges.size(); ++i) {
+                    uint64_t endpoints = (uint64_t{1} << edges[i].left) | (uint64_t{1} << edges[i].right);
+                    if (i != plan.key_edge && (endpoints & plan.left) != 0 && (endpoints & plan.right) != 0) {
+                        predicates.push_back(LogicalPredicate{
+                            edges[i].left_column, Select::PredicateType::EQ, Register{}, edges[i].right_column, {}});
+                    }
+                }
+                return wrap_select(std::move(node), std::move(predicates));
+            }
+
+
+/// Reorders the trees of inner joins in `node` by their estimated cost.
+            LogicalNodePtr reorder_joins(LogicalNodePtr node) {
+                if (!is_join_tree(*node)) {
+                    for (auto& input : node->inputs) {
+                        input = reorder_joins(std::move(input));
+                    }
+                    return node;
+                }
+
+                std::vector<ColumnId> columns = node->columns;
+                JoinGraph graph;
+                collect_join_graph(node, graph);
+                if (graph.relations.size() > max_enumerated_relations) {
+                    return node;
+                }
+
+                // Split the predicates into join predicates between two
+                // relations and the remaining ones.
+                auto relation_of = [&](ColumnId column) {
+                    for (size_t i = 0; i < graph.relations.size(); ++i) {
+                        if (contains((*graph.relations[i])->columns, column)) {
+                            return i;
+                        }
+                    }
+                    assert(false);
+                    return size_t{0};
+                };
+                std::vector<JoinEdge> edges;
+                std::vector<LogicalPredicate> residual;
+                for (auto& predicate : graph.predicates) {
+                    if (predicate.other_column && predicate.predicate_type == Select::PredicateType::EQ) {
+                        size_t left = relation_of(predicate.column);
+                        size_t right = relation_of(*predicate.other_column);
+                        if (left != right) {
+                            edges.push_back(JoinEdge{left, right, predicate.column, *predicate.other_column});
+                            continue;
+                        }
+                    }
+                    residual.push_back(predicate);
+                }
+
+                // Number the relations in breadth-first order. Disconnected
+                // join graphs would need cross products and keep their order.
+                std::vector<size_t> order{0};
+                std::vector<size_t> number(graph.relations.size(), graph.relations.size());
+                number[0] = 0;
+                for (size_t i = 0; i < order.size(); ++i) {
+                    for (auto& edge : edges) {
+                        if (edge.left != order[i] && edge.right != order[i]) {
+                            continue;
+                        }
+                        size_t neighbor = edge.left == order[i] ? edge.right : edge.left;
+                        if (number[neighbor] == graph.relations.size()) {
+                            number[neighbor] = order.size();
+                            order.push_back(neighbor);
+                        }
+                    }
+                }
+                if (order.size() != graph.relations.size()) {
+                    return node;
+                }
+                std::vector<LogicalNodePtr*> relations;
+                std::vector<JoinCandidate> candidates;
+                Planner estimator;
+                for (size_t relation : order) {
+                    relations.push_back(graph.relations[relation]);
+                    PlannedOperator planned = lower(**graph.relations[relation], estimator);
+                    JoinCandidate candidate;
+                    candidate.cost = planned.cost;
+                    candidate.statistics = std::move(planned.statistics);
+                    candidate.columns = (*graph.relations[relation])->columns;
+                    candidates.push_back(std::move(candidate));
+                }
+                for (auto& edge : edges) {
+                    edge.left = number[edge.left];
+                    edge.right = number[edge.right];
+                }
+
+                JoinEnumerator enumerator{std::move(candidates), edges};
+                const auto& best = enumerator.run();
+                uint64_t all = (uint64_t{1} << relations.size()) - 1;
+                LogicalNodePtr tree = build_join_tree(all, best, edges, relations);
+                tree = wrap_select(std::move(tree), std::move(residual));
+                if (tree->columns != columns) {
+                    auto projection = std::make_unique<LogicalNode>(LogicalNode::Kind::PROJECTION);
+                    projection->columns = std::move(columns);
+                    projection->inputs.push_back(std::move(tree));
+                    return projection;
+                }
+                return tree;
+            }
+
+
+/// Writes a constant to a fingerprint.
+            void write_register(std::ostream& out, const Register& reg) {
+                switch (reg.get_type()) {
+                    case Register::Type::INT64:
+                        out << 'i' << reg.as_int();
+                        break;
+                    case Register::Type::CHAR16: {
+                        std::string value = reg.as_string();
+                        out << 's' << value.size() << ':' << value;
+                        break;
+                    }
+                    case Register::Type::VARCHAR: {
+                        std::string value = reg.as_string();
+                        out << 'v' << value.size() << ':' << value;
+                        break;
+                    }
+                    case Register::Type::DOUBLE:
+                        out << 'f' << std::hexfloat << reg.as_double() << std::defaultfloat;
+                        break;
+                    default:
+                        out << 't' << static_cast<int>(reg.get_type()) << ':' << reg.as_int();
+                        break;
+                }
+            }
+
+
+/// Writes the fingerprint of `node` and its inputs.
+            void write_fingerprint(std::ostream& out, const LogicalNode& node) {
+                out << static_cast<int>(node.kind) << '[';
+                for (ColumnId column : node.columns) {
+                    out << column << ',';
+                }
+                out << ']';
+                switch (node.kind) {
+                    case LogicalNode::Kind::SCAN:
+                        out << node.source;
+                        break;
+                    case LogicalNode::Kind::SELECT:
+                        for (auto& predicate : node.predicates) {
+                            out << predicate.column << static_cast<int>(predicate.predicate_type);
+                            if (predicate.other_column) {
+                                out << 'c' << *predicate.other_column;
+                            } else if (predicate.parameter) {
+                                out << '?' << *predicate.parameter << static_cast<int>(predicate.constant.get_type());
+                            } else {
+                                write_register(out, predicate.constant);
+                            }
+                            out << ';';
+                        }
+                        break;
+                    case LogicalNode::Kind::PROJECTION:
+                        break;
+                    case LogicalNode::Kind::SORT:
+                        for (auto& criterion : node.criteria) {
+                            out << criterion.column << (criterion.desc ? 'd' : 'a');
+                        }
+                        break;
+                    case LogicalNode::Kind::JOIN:
+                        out << node.left_key << '=' << node.right_key << static_cast<int>(node.join_type);
+                        break;
+                    case LogicalNode::Kind::AGGREGATION:
+                        for (ColumnId column : node.group_by) {
+                            out << column << ',';
+                        }
+                        for (auto& aggregate : node.aggregates) {
+                            out << aggregate.func << '(' << aggregate.column << ',' << aggregate.parameter << ')'
+                                << aggregate.result << ';';
+                        }
+                        break;
+                    case LogicalNode::Kind::SET_OPERATION:
+                        out << static_cast<int>(node.set_operation);
+                        break;
+                }
+                out << '(';
+                for (auto& input : node.inputs) {
+                    write_fingerprint(out, *input);
+                }
+                out << ')';
+            }
+
+        }  // namespace
+
+
+        std::vector<ColumnId> LogicalPredicate::get_columns() const {
+            std::vector<ColumnId> columns{this->column};
+            if (this->other_column) {
+                columns.push_back(*this->other_column);
+            }
+            return columns;
+        }
+
+
+        LogicalNodePtr LogicalPlanBuilder::scan(Operator& source, TableStatistics statistics) {
+            auto node = std::make_unique<LogicalNode>(LogicalNode::Kind::SCAN);
+            for (size_t i = 0; i < statistics.columns.size(); ++i) {
+                node->columns.push_back(this->next_column++);
+            }
+            node->source = &source;
+            node->statistics = std::move(statistics);
+            return node;
+        }
+
+
+        LogicalNodePtr LogicalPlanBuilder::select(
+                LogicalNodePtr input,
+                ColumnId column,
+                Select::PredicateType predicate_type,
+                Register constant
+        ) {
+            LogicalPredicate predicate{column, predicate_type, std::move(constant), {}, {}};
+            return wrap_select(std::move(input), {std::move(predicate)});
+        }
+
+
+        LogicalNodePtr LogicalPlanBuilder::select(
+                LogicalNodePtr input,
+                ColumnId column,
+                Select::PredicateType predicate_type,
+                ColumnId other_column
+        ) {
+            LogicalPredicate predicate{column, predicate_type, Register{}, other_column, {}};
+            return wrap_select(std::move(input), {std::move(predicate)});
+        }
+
+
+        LogicalNodePtr LogicalPlanBuilder::select_parameter(
+                LogicalNodePtr input,
+                ColumnId column,
+                Select::PredicateType predicate_type,
+                size_t parameter,
+                Register::Type parameter_type
+        ) {
+            Register placeholder;
+            switch (parameter_type) {
+                case Register::Type::CHAR16:
+                    placeholder = Register::from_string(std::string(16, ' '));
+                    break;
+                case Register::Type::VARCHAR:
+                    placeholder = Register::from_varchar(GermanString{});
+                    break;
+                default:
+                    placeholder = Register::from_integer(parameter_type, 0);
+                    break;
+            }
+            LogicalPredicate predicate{column, predicate_type, std::move(placeholder), {}, parameter};
+            return wrap_select(std::move(input), {std::move(predicate)});
+        }
+
+
+        LogicalNodePtr LogicalPlanBuilder::projection(LogicalNodePtr input, std::vector<ColumnId> columns) {
+            auto node = std::make_unique<LogicalNode>(LogicalNode::Kind::PROJECTION);
+            node->columns = std::move(columns);
+            node->inputs.push_back(std::move(input));
+            return node;
+        }
+
+
+        LogicalNodePtr LogicalPlanBuilder::sort(LogicalNodePtr input, std::vector<LogicalSortCriterion> criteria) {
+            auto node = std::make_unique<LogicalNode>(LogicalNode::Kind::SORT);
+            node->columns = input->columns;
+            node->criteria = std::move(criteria);
+            node->inputs.push_back(std::move(input));
+            return node;
+        }
+
+
+        LogicalNodePtr LogicalPlanBuilder::join(
+                LogicalNodePtr left,
+                LogicalNodePtr right,
+                ColumnId left_key,
+                ColumnId right_key,
+                HashJoin::Type join_type
+        ) {
+            auto node = std::make_unique<LogicalNode>(LogicalNode::Kind::JOIN);
+            node->columns = left->columns;
+            if (join_type == HashJoin::Type::INNER) {
+                node->columns.insert(node->columns.end(), right->columns.begin(), right->columns.end());
+            }
+            node->left_key = left_key;
+            node->right_key = right_key;
+            node->join_type = join_type;
+            node->inputs.push_back(std::move(left));
+            node->inputs.push_back(std::move(right));
+            return node;
+        }
+
+
+        LogicalNodePtr LogicalPlanBuilder::aggregation(
+                LogicalNodePtr input,
+                std::vector<ColumnId> group_by,
+                std::vector<LogicalAggregate> aggregates
+        ) {
+            auto node = std::make_unique<LogicalNode>(LogicalNode::Kind::AGGREGATION);
+            node->columns = group_by;
+            for (auto& aggregate : aggregates) {
+                aggregate.result = this->next_column++;
+                node->columns.push_back(aggregate.result);
+            }
+            node->group_by = std::move(group_by);
+            node->aggregates = std::move(aggregates);
+            node->inputs.push_back(std::move(input));
+            return node;
+        }
+
+
+        LogicalNodePtr LogicalPlanBuilder::set_operation(
+                Planner::SetOperation set_operation,
+                LogicalNodePtr left,
+                LogicalNodePtr right
+        ) {
+            // The physical set operations emit one register per tuple, so
+            // they only implement inputs with a single attribute.
+            if (left->columns.size() != 1 || right->columns.size() != 1) {
+                throw std::invalid_argument("set operations require inputs with a single attribute");
+            }
+            auto node = std::make_unique<LogicalNode>(LogicalNode::Kind::SET_OPERATION);
+            node->columns = left->columns;
+            node->set_operation = set_operation;
+            node->inputs.push_back(std::move(left));
+            node->inputs.push_back(std::move(right));
+            return node;
+        }
+
+
+        LogicalNodePtr optimize(LogicalNodePtr plan) {
+            std::vector<ColumnId> columns = plan->columns;
+            plan = convert_set_operations(std::move(plan));
+            plan = push_down_predicates(std::move(plan), {});
+            plan = remove_redundant_sorts(std::move(plan), true);
+            plan = reorder_joins(std::move(plan));
+            plan = prune_columns(std::move(plan), std::set<ColumnId>(columns.begin(), columns.end()));
+            assert(plan->columns == columns);
+            return plan;
+        }
+
+
+        PlannedOperator lower(const LogicalNode& plan, Planner& planner, std::vector<ParameterBinding>* bindings) {
+            switch (plan.kind) {
+                case LogicalNode::Kind::SCAN:
+                    return planner.scan(*plan.source, plan.statistics);
+                case LogicalNode::Kind::SELECT: {
+                    const auto& layout = plan.inputs[0]->columns;
+                    PlannedOperator planned = lower(*plan.inputs[0], planner, bindings);
+                    // Apply the most selective predicate first.
+                    std::vector<const LogicalPredicate*> remaining;
+                    for (auto& predicate : plan.predicates) {
+                        remaining.push_back(&predicate);
+                    }
+                    while (!remaining.empty()) {
+                        auto best = remaining.begin();
+                        uint64_t best_rows = estimate_predicate(planned.statistics, **best, layout).row_count;
+                        for (auto it = std::next(remaining.begin()); it != remaining.end(); ++it) {
+                            uint64_t rows = estimate_predicate(planned.statistics, **it, layout).row_count;
+                            if (rows < best_rows) {
+                                best = it;
+                                best_rows = rows;
+                            }
+                        }
+                        planned = plan_predicate(planner, planned, **best, layout);
+                        if ((*best)->parameter && bindings != nullptr) {
+                            bindings->push_back(ParameterBinding{static_cast<Select*>(planned.op), *(*best)->parameter});
+                        }
+                        remaining.erase(best);
+                    }
+                    return planned;
+                }
+                case LogicalNode::Kind::PROJECTION: {
+                    const auto& layout = plan.inputs[0]->columns;
+                    std::vector<size_t> attr_indexes;
+                    for (ColumnId column : plan.columns) {
+                        attr_indexes.push_back(position(layout, column));
+                    }
+                    return planner.projection(lower(*plan.inputs[0], planner, bindings), std::move(attr_indexes));
+                }
+                case LogicalNode::Kind::SORT: {
+                    const auto& layout = plan.inputs[0]->columns;
+                    std::vector<Sort::Criterion> criteria;
+                    for (auto& criterion : plan.criteria) {
+                        criteria.push_back(Sort::Criterion{position(layout, criterion.column), criterion.desc});
+                    }
+                    return planner.sort(lower(*plan.inputs[0], planner, bindings), std::move(criteria));
+                }
+                case LogicalNode::Kind::JOIN: {
+                    PlannedOperator left = lower(*plan.inputs[0], planner, bindings);
+                    PlannedOperator right = lower(*plan.inputs[1], planner, bindings);
+                    size_t attr_index_left = position(plan.inputs[0]->columns, plan.left_key);
+                    size_t attr_index_right = position(plan.inputs[1]->columns, plan.right_key);
+                    if (plan.join_type == HashJoin::Type::INNER) {
+                        return planner.join(left, right, attr_index_left, attr_index_right);
+                    }
+                    return planner.semi_join(
+                        left, right, attr_index_left, attr_index_right, plan.join_type == HashJoin::Type::ANTI);
+                }
+                case LogicalNode::Kind::AGGREGATION: {
+                    const auto& layout = plan.inputs[0]->columns;
+                    std::vector<size_t> group_by_attrs;
+                    for (ColumnId column : plan.group_by) {
+                        group_by_attrs.push_back(position(layout, column));
+                    }
+                    std::vector<HashAggregation::AggrFunc> aggr_funcs;
+                    bool approximate = false;
+                    for (auto& aggregate : plan.aggregates) {
+                        aggr_funcs.push_back(HashAggregation::AggrFunc{
+                            aggregate.func, position(layout, aggregate.column), aggregate.parameter});
+                        approximate = approximate || aggr_funcs.back().is_approximate();
+                    }
+
+                    // An aggregation by the join key does not need the join
+                    // result, both are computed by one group join.
+                    const LogicalNode& input = *plan.inputs[0];
+                    if (input.kind == LogicalNode::Kind::JOIN && input.join_type == HashJoin::Type::INNER
+                        && plan.group_by.size() == 1 && !approximate
+                        && (plan.group_by[0] == input.left_key || plan.group_by[0] == input.right_key)) {
+                        PlannedOperator left = lower(*input.inputs[0], planner, bindings);
+                        PlannedOperator right = lower(*input.inputs[1], planner, bindings);
+                        return planner.group_join(
+                            left, right,
+                            position(input.inputs[0]->columns, input.left_key),
+                            position(input.inputs[1]->columns, input.right_key),
+                            std::move(aggr_funcs));
+                    }
+                    return planner.aggregation(
+                        lower(*plan.inputs[0], planner, bindings), std::move(group_by_attrs), std::move(aggr_funcs));
+                }
+                case LogicalNode::Kind::SET_OPERATION: {
+                    PlannedOperator left = lower(*plan.inputs[0], planner, bindings);
+                    PlannedOperator right = lower(*plan.inputs[1], planner, bindings);
+                    return planner.set_operation(plan.set_operation, left, right);
+                }
+            }
+            assert(false);
+            return {};
+        }
+
+
+        std::string fingerprint(const LogicalNode& plan) {
+            std::ostringstream out;
+            write_fingerprint(out, plan);
+            return out.str();
+        }
+
+    }  // namespace iterator_model
+}  // namespace moderndbs
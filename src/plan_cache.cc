@@ -0,0 +1,93 @@
+#include <algorithm>
+#include <cassert>
+#include <utility>
+#include "moderndbs/plan_cache.h"
+
+namespace moderndbs {
+    namespace iterator_model {
+
+        PreparedPlan::PreparedPlan(LogicalNodePtr plan) {
+            LogicalNodePtr optimized = optimize(std::move(plan));
+            this->plan = lower(*optimized, this->planner, &this->bindings);
+            for (auto& binding : this->bindings) {
+                this->parameter_count = std::max(this->parameter_count, binding.parameter + 1);
+            }
+        }
+
+
+        size_t PreparedPlan::get_parameter_count() const {
+            return this->parameter_count;
+        }
+
+
+        const PlannedOperator& PreparedPlan::get_plan() const {
+            return this->plan;
+        }
+
+
+        PreparedPlan::Execution::Execution(std::unique_lock<std::mutex> lock, Operator& root)
+                : lock(std::move(lock)) {
+            this->root = &root;
+        }
+
+
+        Operator& PreparedPlan::Execution::get_root() const {
+            return *this->root;
+        }
+
+
+        PreparedPlan::Execution PreparedPlan::execute(const std::vector<Register>& parameters) {
+            assert(parameters.size() >= this->parameter_count);
+            std::unique_lock<std::mutex> lock(this->mutex);
+            for (auto& binding : this->bindings) {
+                binding.select->set_constant(parameters[binding.parameter]);
+            }
+            return Execution(std::move(lock), *this->plan.op);
+        }
+
+
+        std::shared_ptr<PreparedPlan> PlanCache::prepare(LogicalNodePtr plan) {
+            std::string key = fingerprint(*plan);
+            {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                auto it = this->plans.find(key);
+                if (it != this->plans.end()) {
+                    ++this->hit_count;
+                    return it->second;
+                }
+            }
+
+            // Prepare without holding the lock. When another thread prepared
+            // the same plan in the meantime, its plan is kept.
+            auto prepared = std::make_shared<PreparedPlan>(std::move(plan));
+            std::lock_guard<std::mutex> lock(this->mutex);
+            ++this->miss_count;
+            return this->plans.emplace(std::move(key), std::move(prepared)).first->second;
+        }
+
+
+        void PlanCache::clear() {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->plans.clear();
+        }
+
+
+        size_t PlanCache::size() const {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            return this->plans.size();
+        }
+
+
+        size_t PlanCache::get_hit_count() const {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            return this->hit_count;
+        }
+
+
+        size_t PlanCache::get_miss_count() const {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            return this->miss_count;
+        }
+
+    }  // namespace iterator_model
+}  // namespace moderndbs
@@ -0,0 +1,245 @@
+#include <algorithm>
+#include <utility>
+#include "moderndbs/planner.h"
+
+namespace moderndbs {
+    namespace iterator_model {
+
+        PlannedOperator Planner::scan(Operator& source, TableStatistics statistics) {
+            PlannedOperator planned;
+            planned.op = &source;
+            planned.cost = static_cast<double>(statistics.row_count);
+            planned.statistics = std::move(statistics);
+            return planned;
+        }
+
+
+        PlannedOperator Planner::select(const PlannedOperator& input, const Select::PredicateAttributeInt64& predicate) {
+            PlannedOperator planned;
+            planned.op = &this->make<Select>(*input.op, predicate);
+            planned.statistics = estimate_select(input.statistics, predicate);
+            planned.cost = input.cost + static_cast<double>(planned.statistics.row_count);
+            return planned;
+        }
+
+
+        PlannedOperator Planner::select(const PlannedOperator& input, const Select::PredicateAttributeChar16& predicate) {
+            PlannedOperator planned;
+            planned.op = &this->make<Select>(*input.op, predicate);
+            planned.statistics = estimate_select(input.statistics, predicate);
+            planned.cost = input.cost + static_cast<double>(planned.statistics.row_count);
+            return planned;
+        }
+
+
+        PlannedOperator Planner::select(const PlannedOperator& input, const Select::PredicateAttributeValue& predicate) {
+            PlannedOperator planned;
+            planned.op = &this->make<Select>(*input.op, predicate);
+            planned.statistics = estimate_select(input.statistics, predicate);
+            planned.cost = input.cost + static_cast<double>(planned.statistics.row_count);
+            return planned;
+        }
+
+
+        PlannedOperator Planner::select(const PlannedOperator& input, const Select::PredicateAttributeAttribute& predicate) {
+            PlannedOperator planned;
+            planned.op = &this->make<Select>(*input.op, predicate);
+            planned.statistics = estimate_select(input.statistics, predicate);
+            planned.cost = input.cost + static_cast<double>(planned.statistics.row_count);
+            return planned;
+        }
+
+
+        PlannedOperator Planner::projection(const PlannedOperator& input, std::vector<size_t> attr_indexes) {
+            PlannedOperator planned;
+            planned.statistics = estimate_projection(input.statistics, attr_indexes);
+            planned.op = &this->make<Projection>(*input.op, std::move(attr_indexes));
+            planned.cost = input.cost + static_cast<double>(planned.statistics.row_count);
+            return planned;
+        }
+
+
+        PlannedOperator Planner::join(
+                const PlannedOperator& left,
+                const PlannedOperator& right,
+                size_t attr_index_left,
+                size_t attr_index_right
+        ) {
+            PlannedOperator planned;
+            planned.statistics = estimate_join(left.statistics, right.statistics, attr_index_left, attr_index_right);
+
+            // The attribute order can only be restored when the arity of both
+            // inputs is known.
+            size_t left_arity = left.statistics.columns.size();
+            size_t right_arity = right.statistics.columns.size();
+            bool build_right = left_arity > 0 && right_arity > 0
+                && estimate_size(right.statistics) < estimate_size(left.statistics);
+
+            const PlannedOperator& build = build_right ? right : left;
+            planned.cost = left.cost + right.cost
+                + static_cast<double>(build.statistics.row_count)
+                + static_cast<double>(planned.statistics.row_count);
+            if (!build_right) {
+                planned.op = &this->make<HashJoin>(*left.op, *right.op, attr_index_left, attr_index_right);
+                return planned;
+            }
+
+            auto& join = this->make<HashJoin>(*right.op, *left.op, attr_index_right, attr_index_left);
+            std::vector<size_t> attr_indexes;
+            for (size_t i = 0; i < left_arity; ++i) {
+                attr_indexes.push_back(right_arity + i);
+            }
+            for (size_t i = 0; i < right_arity; ++i) {
+                attr_indexes.push_back(i);
+            }
+            planned.op = &this->make<Projection>(join, std::move(attr_indexes));
+            return planned;
+        }
+
+
+        PlannedOperator Planner::semi_join(
+                const PlannedOperator& left,
+                const PlannedOperator& right,
+                size_t attr_index_left,
+                size_t attr_index_right,
+                bool anti
+        ) {
+            PlannedOperator planned;
+            planned.statistics = estimate_semi_join(
+                left.statistics, right.statistics, attr_index_left, attr_index_right, anti);
+            planned.op = &this->make<HashJoin>(
+                *left.op, *right.op, attr_index_left, attr_index_right,
+                anti ? HashJoin::Type::ANTI : HashJoin::Type::SEMI);
+            planned.cost = left.cost + right.cost
+                + static_cast<double>(left.statistics.row_count)
+                + static_cast<double>(planned.statistics.row_count);
+            return planned;
+        }
+
+
+        PlannedOperator Planner::aggregation(
+                const PlannedOperator& input,
+                std::vector<size_t> group_by_attrs,
+                std::vector<HashAggregation::AggrFunc> aggr_funcs
+        ) {
+            PlannedOperator planned;
+            planned.statistics = estimate_aggregation(input.statistics, group_by_attrs, aggr_funcs);
+            // The range of an integer group key lets the aggregation look up
+            // its groups in an array. Other key types ignore the range.
+            const ColumnStatistics* key_column = nullptr;
+            if (group_by_attrs.size() == 1 && group_by_attrs[0] < input.statistics.columns.size()) {
+                key_column = &input.statistics.columns[group_by_attrs[0]];
+            }
+            auto& aggregation = this->make<HashAggregation>(*input.op, std::move(group_by_attrs), std::move(aggr_funcs));
+            if (key_column != nullptr && key_column->min && key_column->max) {
+                aggregation.set_key_range(key_column->min->as_int(), key_column->max->as_int());
+            }
+            planned.op = &aggregation;
+            planned.cost = input.cost
+                + static_cast<double>(input.statistics.row_count)
+                + static_cast<double>(planned.statistics.row_count);
+            return planned;
+        }
+
+
+        PlannedOperator Planner::group_join(
+                const PlannedOperator& left,
+                const PlannedOperator& right,
+                size_t attr_index_left,
+                size_t attr_index_right,
+                std::vector<HashAggregation::AggrFunc> aggr_funcs
+        ) {
+            PlannedOperator planned;
+            TableStatistics joined = estimate_join(left.statistics, right.statistics, attr_index_left, attr_index_right);
+            planned.statistics = estimate_aggregation(joined, {attr_index_left}, aggr_funcs);
+
+            // The aggregate attributes can only be remapped when the arity of
+            // both inputs is known.
+            size_t left_arity = left.statistics.columns.size();
+            size_t right_arity = right.statistics.columns.size();
+            bool build_right = left_arity > 0 && right_arity > 0
+                && estimate_size(right.statistics) < estimate_size(left.statistics);
+
+            const PlannedOperator& build = build_right ? right : left;
+            planned.cost = left.cost + right.cost
+                + static_cast<double>(build.statistics.row_count)
+                + static_cast<double>(planned.statistics.row_count);
+            if (!build_right) {
+                planned.op = &this->make<GroupJoin>(
+                    *left.op, *right.op, attr_index_left, attr_index_right, std::move(aggr_funcs));
+                return planned;
+            }
+
+            // The join keys are equal, so the output does not change when the
+            // right input is the build side.
+            for (auto& func : aggr_funcs) {
+                func.attr_index = func.attr_index < left_arity ? right_arity + func.attr_index : func.attr_index - left_arity;
+            }
+            planned.op = &this->make<GroupJoin>(
+                *right.op, *left.op, attr_index_right, attr_index_left, std::move(aggr_funcs));
+            return planned;
+        }
+
+
+        PlannedOperator Planner::sort(const PlannedOperator& input, std::vector<Sort::Criterion> criteria) {
+            PlannedOperator planned;
+            planned.op = &this->make<Sort>(*input.op, std::move(criteria));
+            planned.statistics = input.statistics;
+            planned.cost = input.cost + static_cast<double>(input.statistics.row_count);
+            return planned;
+        }
+
+
+        PlannedOperator Planner::set_operation(
+                SetOperation operation,
+                const PlannedOperator& left,
+                const PlannedOperator& right
+        ) {
+            PlannedOperator planned;
+            uint64_t row_count = 0;
+            switch (operation) {
+                case SetOperation::UNION:
+                    planned.op = &this->make<Union>(*left.op, *right.op);
+                    row_count = left.statistics.row_count + right.statistics.row_count;
+                    break;
+                case SetOperation::UNION_ALL:
+                    planned.op = &this->make<UnionAll>(*left.op, *right.op);
+                    row_count = left.statistics.row_count + right.statistics.row_count;
+                    break;
+                case SetOperation::INTERSECT:
+                    planned.op = &this->make<Intersect>(*left.op, *right.op);
+                    row_count = std::min(left.statistics.row_count, right.statistics.row_count);
+                    break;
+                case SetOperation::INTERSECT_ALL:
+                    planned.op = &this->make<IntersectAll>(*left.op, *right.op);
+                    row_count = std::min(left.statistics.row_count, right.statistics.row_count);
+                    break;
+                case SetOperation::EXCEPT:
+                    planned.op = &this->make<Except>(*left.op, *right.op);
+                    row_count = left.statistics.row_count;
+                    break;
+                case SetOperation::EXCEPT_ALL:
+                    planned.op = &this->make<ExceptAll>(*left.op, *right.op);
+                    row_count = left.statistics.row_count;
+                    break;
+            }
+            planned.statistics.row_count = row_count;
+            for (auto& column : left.statistics.columns) {
+                planned.statistics.columns.push_back(column);
+                planned.statistics.columns.back().histogram_bounds.clear();
+            }
+            planned.cost = left.cost + right.cost
+                + static_cast<double>(left.statistics.row_count)
+                + static_cast<double>(right.statistics.row_count)
+                + static_cast<double>(row_count);
+            return planned;
+        }
+
+
+        double Planner::estimate_size(const TableStatistics& statistics) {
+            auto arity = static_cast<double>(std::max<size_t>(statistics.columns.size(), 1));
+            return static_cast<double>(statistics.row_count) * arity * sizeof(Register);
+        }
+
+    }  // namespace iterator_model
+}  // namespace moderndbs
@@ -0,0 +1,332 @@
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <iterator>
+#include <utility>
+#include "moderndbs/result_cache.h"
+
+namespace moderndbs {
+    namespace iterator_model {
+
+        namespace {
+
+/// Collects the tables that the scans of `plan` read. Returns false when a
+/// scan does not read a table.
+            bool collect_tables(const LogicalNode& plan, std::vector<const Table*>& tables) {
+                if (plan.kind == LogicalNode::Kind::SCAN) {
+                    auto* scan = dynamic_cast<const TableScan*>(plan.source);
+                    if (scan == nullptr) {
+                        return false;
+                    }
+                    if (std::find(tables.begin(), tables.end(), &scan->get_table()) == tables.end()) {
+                        tables.push_back(&scan->get_table());
+                    }
+                    return true;
+                }
+                for (auto& input : plan.inputs) {
+                    if (!collect_tables(*input, tables)) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+
+        }  // namespace
+
+
+        void CompactResult::append(const std::vector<Register*>& tuple) {
+            if (this->columns.empty() && this->row_count == 0) {
+                this->columns.resize(tuple.size());
+                for (size_t i = 0; i < tuple.size(); ++i) {
+                    this->columns[i].type = tuple[i]->get_type();
+                }
+            }
+            assert(tuple.size() == this->columns.size());
+            for (size_t i = 0; i < tuple.size(); ++i) {
+                auto& column = this->columns[i];
+                assert(tuple[i]->get_type() == column.type);
+                switch (column.type) {
+                    case Register::Type::INT64:
+                    case Register::Type::DECIMAL:
+                        column.ints.push_back(tuple[i]->as_int());
+                        break;
+                    case Register::Type::INT32:
+                    case Register::Type::DATE:
+                        column.narrow_ints.push_back(static_cast<int32_t>(tuple[i]->as_int()));
+                        break;
+                    case Register::Type::DOUBLE:
+                        column.doubles.push_back(tuple[i]->as_double());
+                        break;
+                    case Register::Type::VARCHAR: {
+                        GermanString value = tuple[i]->as_varchar();
+                        column.chars.append(value.data(), value.size());
+                        column.ends.push_back(static_cast<uint32_t>(column.chars.size()));
+                        break;
+                    }
+                    case Register::Type::CHAR16:
+                        column.chars += tuple[i]->as_string();
+                        column.ends.push_back(static_cast<uint32_t>(column.chars.size()));
+                        break;
+                }
+            }
+            ++this->row_count;
+        }
+
+
+        size_t CompactResult::get_row_count() const {
+            return this->row_count;
+        }
+
+
+        size_t CompactResult::get_arity() const {
+            return this->columns.size();
+        }
+
+
+        Schema CompactResult::get_schema() const {
+            Schema schema;
+            for (auto& column : this->columns) {
+                schema.push_back(column.type);
+            }
+            return schema;
+        }
+
+
+        size_t CompactResult::get_size_in_bytes() const {
+            size_t size = sizeof(CompactResult);
+            for (auto& column : this->columns) {
+                size += sizeof(Column)
+                    + column.ints.size() * sizeof(int64_t)
+                    + column.narrow_ints.size() * sizeof(int32_t)
+                    + column.doubles.size() * sizeof(double)
+                    + column.chars.size()
+                    + column.ends.size() * sizeof(uint32_t);
+            }
+            return size;
+        }
+
+
+        Register CompactResult::get(size_t row, size_t attr_index) const {
+            auto& column = this->columns[attr_index];
+            switch (column.type) {
+                case Register::Type::INT64:
+                case Register::Type::DECIMAL:
+                    return Register::from_integer(column.type, column.ints[row]);
+                case Register::Type::INT32:
+                case Register::Type::DATE:
+                    return Register::from_integer(column.type, column.narrow_ints[row]);
+                case Register::Type::DOUBLE:
+                    return Register::from_double(column.doubles[row]);
+                case Register::Type::CHAR16:
+                case Register::Type::VARCHAR:
+                    break;
+            }
+            size_t begin = row == 0 ? 0 : column.ends[row - 1];
+            if (column.type == Register::Type::VARCHAR) {
+                // The result is immutable, so its characters outlive the
+                // register.
+                return Register::from_varchar(GermanString::view(column.chars.data() + begin, column.ends[row] - begin));
+            }
+            return Register::from_string(column.chars.substr(begin, column.ends[row] - begin));
+        }
+
+
+        ResultScan::ResultScan(std::shared_ptr<const CompactResult> result) {
+            this->result = std::move(result);
+        }
+
+
+        ResultScan::~ResultScan() = default;
+
+
+        void ResultScan::open() {
+            this->current_index = 0;
+            this->output_regs.resize(this->result->get_arity());
+            this->schema = this->result->get_schema();
+        }
+
+
+        bool ResultScan::next() {
+            if (this->current_index == this->result->get_row_count()) {
+                return false;
+            }
+            for (size_t i = 0; i < this->output_regs.size(); ++i) {
+                this->output_regs[i] = this->result->get(this->current_index, i);
+            }
+            ++this->current_index;
+            return true;
+        }
+
+
+        void ResultScan::close() {
+            this->output_regs.clear();
+        }
+
+
+        std::vector<Register*> ResultScan::get_output() {
+            std::vector<Register*> output;
+            for (auto& reg : this->output_regs) {
+                output.push_back(&reg);
+            }
+            return output;
+        }
+
+
+        ResultCache::ResultCache(size_t byte_budget) {
+            this->byte_budget = byte_budget;
+        }
+
+
+        void ResultCache::erase(std::list<Entry>::iterator entry) {
+            this->used_bytes -= entry->size;
+            this->index.erase(entry->key);
+            this->entries.erase(entry);
+        }
+
+
+        std::shared_ptr<const CompactResult> ResultCache::lookup(
+                const std::string& key,
+                const std::vector<std::pair<const Table*, uint64_t>>& versions
+        ) {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            auto it = this->index.find(key);
+            if (it == this->index.end()) {
+                ++this->miss_count;
+                return nullptr;
+            }
+            if (it->second->versions != versions) {
+                this->erase(it->second);
+                ++this->miss_count;
+                return nullptr;
+            }
+            this->entries.splice(this->entries.begin(), this->entries, it->second);
+            ++this->hit_count;
+            return this->entries.front().result;
+        }
+
+
+        void ResultCache::insert(
+                const std::string& key,
+                std::vector<std::pair<const Table*, uint64_t>> versions,
+                std::shared_ptr<const CompactResult> result
+        ) {
+            size_t size = result->get_size_in_bytes() + key.size();
+            std::lock_guard<std::mutex> lock(this->mutex);
+            auto it = this->index.find(key);
+            if (it != this->index.end()) {
+                this->erase(it->second);
+            }
+            if (size > this->byte_budget) {
+                return;
+            }
+            while (this->used_bytes + size > this->byte_budget) {
+                this->erase(std::prev(this->entries.end()));
+            }
+            this->entries.push_front(Entry{key, std::move(versions), std::move(result), size});
+            this->index[key] = this->entries.begin();
+            this->used_bytes += size;
+        }
+
+
+        std::shared_ptr<const CompactResult> ResultCache::execute(
+                const LogicalNode& plan,
+                Operator& root,
+                const std::vector<Register>& parameters
+        ) {
+            std::vector<const Table*> tables;
+            bool cacheable = collect_tables(plan, tables);
+
+            std::string key;
+            std::vector<std::pair<const Table*, uint64_t>> versions;
+            if (cacheable) {
+                key = fingerprint(plan);
+                for (auto& parameter : parameters) {
+                    switch (parameter.get_type()) {
+                        case Register::Type::INT64:
+                            key += "|i" + std::to_string(parameter.as_int());
+                            break;
+                        case Register::Type::CHAR16: {
+                            std::string value = parameter.as_string();
+                            key += "|s" + std::to_string(value.size()) + ":" + value;
+                            break;
+                        }
+                        case Register::Type::VARCHAR: {
+                            std::string value = parameter.as_string();
+                            key += "|v" + std::to_string(value.size()) + ":" + value;
+                            break;
+                        }
+                        case Register::Type::DOUBLE: {
+                            double value = parameter.as_double();
+                            uint64_t bits = 0;
+                            std::memcpy(&bits, &value, sizeof(bits));
+                            key += "|f" + std::to_string(bits);
+                            break;
+                        }
+                        default:
+                            key += "|t" + std::to_string(static_cast<int>(parameter.get_type()))
+                                + ":" + std::to_string(parameter.as_int());
+                            break;
+                    }
+                }
+                for (auto* table : tables) {
+                    versions.emplace_back(table, table->get_version());
+                }
+                auto cached = this->lookup(key, versions);
+                if (cached) {
+                    return cached;
+                }
+            }
+
+            auto result = std::make_shared<CompactResult>();
+            root.open();
+            while (root.next()) {
+                result->append(root.get_output());
+            }
+            root.close();
+            if (cacheable) {
+                this->insert(key, std::move(versions), result);
+            }
+            return result;
+        }
+
+
+        void ResultCache::invalidate(const Table& table) {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            for (auto it = this->entries.begin(); it != this->entries.end();) {
+                auto next = std::next(it);
+                for (auto& version : it->versions) {
+                    if (version.first == &table) {
+                        this->erase(it);
+                        break;
+                    }
+                }
+                it = next;
+            }
+        }
+
+
+        size_t ResultCache::get_used_bytes() const {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            return this->used_bytes;
+        }
+
+
+        size_t ResultCache::size() const {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            return this->entries.size();
+        }
+
+
+        size_t ResultCache::get_hit_count() const {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            return this->hit_count;
+        }
+
+
+        size_t ResultCache::get_miss_count() const {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            return this->miss_count;
+        }
+
+    }  // namespace iterator_model
+}  // namespace moderndbs
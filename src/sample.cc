@@ -0,0 +1,189 @@
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <utility>
+#include "moderndbs/sample.h"
+#include "moderndbs/sketch.h"
+
+namespace moderndbs {
+    namespace iterator_model {
+
+        namespace {
+
+/// Returns the number of elements that are skipped before the next one is
+/// taken when every element is taken with probability `fraction`. This draws
+/// one random number per taken element instead of one per element.
+            uint64_t draw_skip(std::mt19937_64& generator, double fraction) {
+                if (fraction >= 1) {
+                    return 0;
+                }
+                if (fraction <= 0) {
+                    return std::numeric_limits<uint64_t>::max();
+                }
+                std::geometric_distribution<uint64_t> distribution(fraction);
+                return distribution(generator);
+            }
+
+        }  // namespace
+
+
+        Sample::Sample(Operator& input, Bernoulli method, uint64_t seed)
+                : UnaryOperator(input) {
+            this->method = Method::BERNOULLI;
+            this->fraction = method.fraction;
+            this->seed = seed;
+        }
+
+
+        Sample::Sample(Operator& input, Reservoir method, uint64_t seed)
+                : UnaryOperator(input) {
+            this->method = Method::RESERVOIR;
+            this->size = method.size;
+            this->seed = seed;
+        }
+
+
+        Sample::~Sample() = default;
+
+
+        void Sample::open() {
+            this->input->open();
+            this->generator.seed(this->seed);
+            this->schema = this->input->get_schema();
+        }
+
+
+        bool Sample::next_bernoulli() {
+            uint64_t skip = draw_skip(this->generator, this->fraction);
+            for (uint64_t i = 0; i <= skip; ++i) {
+                if (!this->input->next()) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+
+        bool Sample::next_reservoir() {
+            if (!this->isMaterialized) {
+                ReservoirSample reservoir(this->size, this->seed);
+                if (this->size > 0) {
+                    while (this->input->next()) {
+                        this->check_interrupted();
+                        auto slot = reservoir.offer();
+                        if (!slot) {
+                            continue;
+                        }
+                        std::vector<Register*> regs = this->input->get_output();
+                        if (*slot == this->tuples.size()) {
+                            this->tuples.emplace_back();
+                        }
+                        auto& tuple = this->tuples[*slot];
+                        tuple.clear();
+                        for (auto* reg : regs) {
+                            tuple.push_back(*reg);
+                        }
+                    }
+                }
+                if (this->token != nullptr) {
+                    this->token->check();
+                }
+                this->isMaterialized = true;
+            }
+            if (this->current_index < this->tuples.size()) {
+                this->output_regs = this->tuples[this->current_index];
+                ++this->current_index;
+                return true;
+            }
+            return false;
+        }
+
+
+        bool Sample::next() {
+            if (this->method == Method::BERNOULLI) {
+                return this->next_bernoulli();
+            }
+            return this->next_reservoir();
+        }
+
+
+        void Sample::close() {
+            this->input->close();
+            this->tuples.clear();
+            this->tuples.shrink_to_fit();
+            this->output_regs.clear();
+            this->isMaterialized = false;
+            this->current_index = 0;
+        }
+
+
+        std::vector<Register*> Sample::get_output() {
+            if (this->method == Method::BERNOULLI) {
+                return this->input->get_output();
+            }
+            std::vector<Register*> output;
+            output.reserve(this->output_regs.size());
+            for (auto& reg : this->output_regs) {
+                output.push_back(&reg);
+            }
+            return output;
+        }
+
+
+        BlockSampleScan::BlockSampleScan(const Table& table, double fraction, uint64_t seed, size_t block_size) {
+            assert(block_size > 0);
+            this->table = &table;
+            this->fraction = fraction;
+            this->seed = seed;
+            this->block_size = block_size;
+        }
+
+
+        BlockSampleScan::~BlockSampleScan() = default;
+
+
+        void BlockSampleScan::open() {
+            this->generator.seed(this->seed);
+            this->next_block = 0;
+            this->current_index = 0;
+            this->block_end = 0;
+            this->output_regs.resize(this->table->get_arity());
+            this->schema = this->table->get_schema();
+        }
+
+
+        bool BlockSampleScan::next() {
+            const auto& tuples = this->table->get_tuples();
+            if (this->current_index == this->block_end) {
+                size_t block_count = (tuples.size() + this->block_size - 1) / this->block_size;
+                uint64_t skip = draw_skip(this->generator, this->fraction);
+                if (this->next_block >= block_count || skip >= block_count - this->next_block) {
+                    this->next_block = block_count;
+                    return false;
+                }
+                size_t block = this->next_block + skip;
+                this->next_block = block + 1;
+                this->current_index = block * this->block_size;
+                this->block_end = std::min(tuples.size(), this->current_index + this->block_size);
+            }
+            const auto& tuple = tuples[this->current_index++];
+            std::copy(tuple.begin(), tuple.end(), this->output_regs.begin());
+            return true;
+        }
+
+
+        void BlockSampleScan::close() {
+            this->output_regs.clear();
+        }
+
+
+        std::vector<Register*> BlockSampleScan::get_output() {
+            std::vector<Register*> output;
+            for (auto& reg : this->output_regs) {
+                output.push_back(&reg);
+            }
+            return output;
+        }
+
+    }  // namespace iterator_model
+}  // namespace moderndbs
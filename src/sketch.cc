@@ -0,0 +1,479 @@
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <utility>
+#include "moderndbs/sketch.h"
+
+namespace moderndbs {
+    namespace iterator_model {
+
+        namespace {
+
+/// Spreads the entropy of a hash value over all bits (the finalizer of
+/// MurmurHash3).
+            uint64_t mix_hash(uint64_t hash) {
+                hash ^= hash >> 33U;
+                hash *= 0xff51afd7ed558ccdULL;
+                hash ^= hash >> 33U;
+                hash *= 0xc4ceb9fe1a85ec53ULL;
+                hash ^= hash >> 33U;
+                return hash;
+            }
+
+
+/// Hashes a value uniformly over all 64 bits. `Register::get_hash()` is made
+/// for the low bits that select hash table buckets and, with CRC32-C, is
+/// linear in the value, so numbers are mixed directly.
+            uint64_t get_uniform_hash(const Register& value) {
+                switch (value.get_type()) {
+                    case Register::Type::CHAR16:
+                    case Register::Type::VARCHAR:
+                        return mix_hash(value.get_hash());
+                    case Register::Type::DOUBLE: {
+                        double number = value.as_double() == 0 ? 0.0 : value.as_double();
+                        uint64_t bits = 0;
+                        std::memcpy(&bits, &number, sizeof(bits));
+                        return mix_hash(bits);
+                    }
+                    default:
+                        return mix_hash(static_cast<uint64_t>(value.as_int()));
+                }
+            }
+
+
+/// APPROX_COUNT_DISTINCT
+            class DistinctCountAggregate
+            : public ApproximateAggregate {
+            private:
+                /// 2^10 registers keep the state of a group at 1 KiB with a
+                /// standard error of about 3%.
+                HyperLogLog sketch{10};
+
+            public:
+                std::unique_ptr<ApproximateAggregate> clone() const override {
+                    return std::make_unique<DistinctCountAggregate>(*this);
+                }
+
+                void add(const Register& value) override {
+                    this->sketch.add(value);
+                }
+
+                void merge(const ApproximateAggregate& other) override {
+                    this->sketch.merge(dynamic_cast<const DistinctCountAggregate&>(other).sketch);
+                }
+
+                Register get_result() const override {
+                    return Register::from_int(static_cast<int64_t>(this->sketch.estimate()));
+                }
+            };
+
+
+/// APPROX_QUANTILE. The sketch holds the integers of `Register::as_int()`,
+/// so quantiles of DOUBLE values are truncated.
+            class QuantileAggregate
+            : public ApproximateAggregate {
+            private:
+                double quantile;
+                KllSketch sketch;
+                Register::Type type = Register::Type::INT64;
+
+            public:
+                explicit QuantileAggregate(double quantile) : quantile(quantile) {}
+
+                std::unique_ptr<ApproximateAggregate> clone() const override {
+                    return std::make_unique<QuantileAggregate>(*this);
+                }
+
+                void add(const Register& value) override {
+                    this->type = value.get_type();
+                    this->sketch.add(value.as_int());
+                }
+
+                void merge(const ApproximateAggregate& other) override {
+                    auto& quantiles = dynamic_cast<const QuantileAggregate&>(other);
+                    if (quantiles.sketch.get_count() > 0) {
+                        this->type = quantiles.type;
+                    }
+                    this->sketch.merge(quantiles.sketch);
+                }
+
+                Register get_result() const override {
+                    return Register::from_integer(this->type, this->sketch.get_quantile(this->quantile));
+                }
+            };
+
+
+/// APPROX_MOST_FREQUENT
+            class MostFrequentAggregate
+            : public ApproximateAggregate {
+            private:
+                SpaceSaving sketch;
+
+            public:
+                std::unique_ptr<ApproximateAggregate> clone() const override {
+                    return std::make_unique<MostFrequentAggregate>(*this);
+                }
+
+                void add(const Register& value) override {
+                    this->sketch.add(value);
+                }
+
+                void merge(const ApproximateAggregate& other) override {
+                    this->sketch.merge(dynamic_cast<const MostFrequentAggregate&>(other).sketch);
+                }
+
+                Register get_result() const override {
+                    return this->sketch.get_top(1).front().value;
+                }
+            };
+
+        }  // namespace
+
+
+        HyperLogLog::HyperLogLog(uint8_t precision) {
+            assert(precision >= 4 && precision <= 18);
+            this->precision = precision;
+            this->registers.resize(size_t{1} << precision, 0);
+        }
+
+
+        void HyperLogLog::add(uint64_t hash) {
+            size_t index = hash >> (64U - this->precision);
+            uint64_t remaining = hash << this->precision;
+            // The rank is the position of the first set bit of the remaining
+            // bits; a sentinel bit bounds it when all of them are zero.
+            remaining |= uint64_t{1} << (this->precision - 1U);
+            auto rank = static_cast<uint8_t>(__builtin_clzll(remaining) + 1);
+            this->registers[index] = std::max(this->registers[index], rank);
+        }
+
+
+        void HyperLogLog::add(const Register& value) {
+            this->add(get_uniform_hash(value));
+        }
+
+
+        void HyperLogLog::merge(const HyperLogLog& other) {
+            assert(this->precision == other.precision);
+            for (size_t i = 0; i < this->registers.size(); ++i) {
+                this->registers[i] = std::max(this->registers[i], other.registers[i]);
+            }
+        }
+
+
+        uint64_t HyperLogLog::estimate() const {
+            auto m = static_cast<double>(this->registers.size());
+            double sum = 0;
+            size_t zeros = 0;
+            for (uint8_t rank : this->registers) {
+                sum += std::ldexp(1.0, -rank);
+                zeros += rank == 0;
+            }
+            double alpha = 0.7213 / (1.0 + 1.079 / m);
+            double estimate = alpha * m * m / sum;
+            // Linear counting is more accurate for small cardinalities.
+            if (estimate <= 2.5 * m && zeros > 0) {
+                estimate = m * std::log(m / static_cast<double>(zeros));
+            }
+            return static_cast<uint64_t>(std::llround(estimate));
+        }
+
+
+        ReservoirSample::ReservoirSample(size_t capacity, uint64_t seed) : generator(seed) {
+            this->capacity = std::max<size_t>(capacity, 1);
+        }
+
+
+        double ReservoirSample::random() {
+            std::uniform_real_distribution<double> distribution(0.0, 1.0);
+            double value = 0;
+            while (value == 0) {
+                value = distribution(this->generator);
+            }
+            return value;
+        }
+
+
+        void ReservoirSample::skip() {
+            this->next_taken = this->count
+                + static_cast<uint64_t>(std::floor(std::log(this->random()) / std::log1p(-this->weight))) + 1;
+        }
+
+
+        std::experimental::optional<size_t> ReservoirSample::offer() {
+            ++this->count;
+            if (this->count <= this->capacity) {
+                if (this->count == this->capacity) {
+                    this->weight = std::exp(std::log(this->random()) / static_cast<double>(this->capacity));
+                    this->skip();
+                }
+                return static_cast<size_t>(this->count - 1);
+            }
+            if (this->count != this->next_taken) {
+                return {};
+            }
+            std::uniform_int_distribution<size_t> slot(0, this->capacity - 1);
+            size_t taken = slot(this->generator);
+            this->weight *= std::exp(std::log(this->random()) / static_cast<double>(this->capacity));
+            this->skip();
+            return taken;
+        }
+
+
+        void ReservoirSample::add(const Register& value) {
+            auto slot = this->offer();
+            if (!slot) {
+                return;
+            }
+            if (*slot == this->values.size()) {
+                this->values.push_back(value);
+            } else {
+                this->values[*slot] = value;
+            }
+        }
+
+
+        void ReservoirSample::merge(const ReservoirSample& other) {
+            std::vector<Register> left = std::move(this->values);
+            std::vector<Register> right = other.values;
+            uint64_t left_population = this->count;
+            uint64_t right_population = other.count;
+            size_t target = std::min(this->capacity, left.size() + right.size());
+
+            this->values.clear();
+            while (this->values.size() < target) {
+                bool from_left = right.empty();
+                if (!left.empty() && !right.empty()) {
+                    double total = static_cast<double>(left_population + right_population);
+                    from_left = this->random() * total < static_cast<double>(left_population);
+                }
+                auto& source = from_left ? left : right;
+                auto& population = from_left ? left_population : right_population;
+                std::uniform_int_distribution<size_t> index(0, source.size() - 1);
+                size_t i = index(this->generator);
+                this->values.push_back(std::move(source[i]));
+                source[i] = std::move(source.back());
+                source.pop_back();
+                population -= population > 0;
+            }
+
+            this->count += other.count;
+            if (this->values.size() == this->capacity) {
+                // The keys of the sample are unknown after merging, continue
+                // with the expected largest key of `capacity` out of `count`
+                // values.
+                this->weight = static_cast<double>(this->capacity) / static_cast<double>(this->count + 1);
+                this->skip();
+            }
+        }
+
+
+        uint64_t ReservoirSample::get_count() const {
+            return this->count;
+        }
+
+
+        const std::vector<Register>& ReservoirSample::get_values() const {
+            return this->values;
+        }
+
+
+        SpaceSaving::SpaceSaving(size_t capacity) {
+            this->capacity = std::max<size_t>(capacity, 1);
+        }
+
+
+        void SpaceSaving::replace_minimum(const Register& value, uint64_t count) {
+            auto minimum = std::min_element(
+                this->counters.begin(), this->counters.end(),
+                [](const Counter& left, const Counter& right) { return left.count < right.count; });
+            this->index.erase(minimum->value);
+            this->index[value] = static_cast<size_t>(minimum - this->counters.begin());
+            minimum->value = value;
+            minimum->error = minimum->count;
+            minimum->count += count;
+        }
+
+
+        void SpaceSaving::add(const Register& value, uint64_t count) {
+            auto it = this->index.find(value);
+            if (it != this->index.end()) {
+                this->counters[it->second].count += count;
+            } else if (this->counters.size() < this->capacity) {
+                this->index[value] = this->counters.size();
+                this->counters.push_back(Counter{value, count, 0});
+            } else {
+                this->replace_minimum(value, count);
+            }
+        }
+
+
+        void SpaceSaving::merge(const SpaceSaving& other) {
+            // A full sketch undercounts missing values by at most its smallest
+            // count.
+            auto minimum_count = [](const SpaceSaving& sketch) -> uint64_t {
+                if (sketch.counters.size() < sketch.capacity) {
+                    return 0;
+                }
+                uint64_t minimum = sketch.counters.front().count;
+                for (auto& counter : sketch.counters) {
+                    minimum = std::min(minimum, counter.count);
+                }
+                return minimum;
+            };
+            uint64_t this_minimum = minimum_count(*this);
+            uint64_t other_minimum = minimum_count(other);
+
+            std::vector<Counter> merged;
+            for (auto& counter : this->counters) {
+                auto it = other.index.find(counter.value);
+                if (it != other.index.end()) {
+                    auto& other_counter = other.counters[it->second];
+                    merged.push_back(Counter{
+                        counter.value, counter.count + other_counter.count, counter.error + other_counter.error});
+                } else {
+                    merged.push_back(Counter{
+                        counter.value, counter.count + other_minimum, counter.error + other_minimum});
+                }
+            }
+            for (auto& counter : other.counters) {
+                if (this->index.count(counter.value) == 0) {
+                    merged.push_back(Counter{
+                        counter.value, counter.count + this_minimum, counter.error + this_minimum});
+                }
+            }
+
+            std::sort(merged.begin(), merged.end(), [](const Counter& left, const Counter& right) {
+                return left.count > right.count;
+            });
+            if (merged.size() > this->capacity) {
+                merged.resize(this->capacity);
+            }
+            this->counters = std::move(merged);
+            this->index.clear();
+            for (size_t i = 0; i < this->counters.size(); ++i) {
+                this->index[this->counters[i].value] = i;
+            }
+        }
+
+
+        std::vector<SpaceSaving::Counter> SpaceSaving::get_top(size_t k) const {
+            std::vector<Counter> top = this->counters;
+            k = std::min(k, top.size());
+            std::partial_sort(top.begin(), top.begin() + k, top.end(), [](const Counter& left, const Counter& right) {
+                return left.count > right.count;
+            });
+            top.resize(k);
+            return top;
+        }
+
+
+        KllSketch::KllSketch(size_t k, uint64_t seed) : generator(seed) {
+            this->k = std::max<size_t>(k, 8);
+            this->levels.resize(1);
+        }
+
+
+        size_t KllSketch::get_level_capacity(size_t level) const {
+            // Lower levels shrink geometrically with factor 2/3 below the top.
+            size_t depth = this->levels.size() - 1 - level;
+            auto capacity = static_cast<double>(this->k) * std::pow(2.0 / 3.0, static_cast<double>(depth));
+            return std::max<size_t>(2, static_cast<size_t>(std::ceil(capacity)));
+        }
+
+
+        void KllSketch::compress() {
+            for (size_t level = 0; level < this->levels.size(); ++level) {
+                if (this->levels[level].size() < this->get_level_capacity(level)) {
+                    continue;
+                }
+                if (level + 1 == this->levels.size()) {
+                    this->levels.emplace_back();
+                }
+                auto& values = this->levels[level];
+                std::sort(values.begin(), values.end());
+                // Keep either the values at even or at odd positions. An odd
+                // value out stays on this level.
+                size_t offset = this->generator() & 1U;
+                size_t paired = values.size() & ~size_t{1};
+                auto& next = this->levels[level + 1];
+                for (size_t i = offset; i < paired; i += 2) {
+                    next.push_back(values[i]);
+                }
+                if (paired < values.size()) {
+                    values[0] = values.back();
+                    values.resize(1);
+                } else {
+                    values.clear();
+                }
+            }
+        }
+
+
+        void KllSketch::add(int64_t value) {
+            ++this->count;
+            this->levels[0].push_back(value);
+            if (this->levels[0].size() >= this->get_level_capacity(0)) {
+                this->compress();
+            }
+        }
+
+
+        void KllSketch::merge(const KllSketch& other) {
+            if (other.levels.size() > this->levels.size()) {
+                this->levels.resize(other.levels.size());
+            }
+            for (size_t level = 0; level < other.levels.size(); ++level) {
+                auto& values = other.levels[level];
+                this->levels[level].insert(this->levels[level].end(), values.begin(), values.end());
+            }
+            this->count += other.count;
+            this->compress();
+        }
+
+
+        uint64_t KllSketch::get_count() const {
+            return this->count;
+        }
+
+
+        int64_t KllSketch::get_quantile(double quantile) const {
+            std::vector<std::pair<int64_t, uint64_t>> weighted;
+            uint64_t total = 0;
+            for (size_t level = 0; level < this->levels.size(); ++level) {
+                for (int64_t value : this->levels[level]) {
+                    weighted.emplace_back(value, uint64_t{1} << level);
+                    total += uint64_t{1} << level;
+                }
+            }
+            assert(!weighted.empty());
+            std::sort(weighted.begin(), weighted.end());
+            quantile = std::min(std::max(quantile, 0.0), 1.0);
+            auto rank = static_cast<uint64_t>(quantile * static_cast<double>(total));
+            uint64_t seen = 0;
+            for (auto& [value, weight] : weighted) {
+                seen += weight;
+                if (seen > rank) {
+                    return value;
+                }
+            }
+            return weighted.back().first;
+        }
+
+
+        std::unique_ptr<ApproximateAggregate> ApproximateAggregate::create(const HashAggregation::AggrFunc& func) {
+            switch (func.func) {
+                case HashAggregation::AggrFunc::APPROX_COUNT_DISTINCT:
+                    return std::make_unique<DistinctCountAggregate>();
+                case HashAggregation::AggrFunc::APPROX_QUANTILE:
+                    return std::make_unique<QuantileAggregate>(func.parameter);
+                case HashAggregation::AggrFunc::APPROX_MOST_FREQUENT:
+                    return std::make_unique<MostFrequentAggregate>();
+                default:
+                    throw std::invalid_argument("aggregate is not approximate");
+            }
+        }
+
+    }  // namespace iterator_model
+}  // namespace moderndbs
@@ -0,0 +1,499 @@
+#include <algorithm>
+#include <cmath>
+#include "moderndbs/statistics.h"
+
+namespace moderndbs {
+    namespace iterator_model {
+
+        namespace {
+
+/// Selectivity of range predicates when nothing is known about the attribute.
+            constexpr double default_range_selectivity = 1.0 / 3.0;
+
+
+/// Selectivity of equality predicates when nothing is known about the attribute.
+            constexpr double default_equality_selectivity = 0.1;
+
+
+/// Returns the number of distinct values of a column. Unknown distinct counts
+/// are approximated by the number of tuples.
+            uint64_t distinct_count(const ColumnStatistics& column, uint64_t row_count) {
+                if (column.distinct_count == 0) {
+                    return row_count;
+                }
+                return column.distinct_count;
+            }
+
+
+/// Returns the estimated number of tuples when a fraction `selectivity` of
+/// `row_count` tuples qualifies.
+            uint64_t scale_rows(uint64_t row_count, double selectivity) {
+                selectivity = std::min(std::max(selectivity, 0.0), 1.0);
+                return static_cast<uint64_t>(std::ceil(static_cast<double>(row_count) * selectivity));
+            }
+
+
+/// Converts `constant` to the type of the values of `column` with
+/// `coerce_constant()`, so that it can be compared with the bounds. Constants
+/// that already have that type and constants of columns without any known
+/// values are returned unchanged.
+            Register to_column_type(const ColumnStatistics& column, const Register& constant, StringArena& strings) {
+                const Register* value = nullptr;
+                if (column.min) {
+                    value = &*column.min;
+                } else if (column.max) {
+                    value = &*column.max;
+                } else if (!column.histogram_bounds.empty()) {
+                    value = &column.histogram_bounds[0];
+                }
+                if (value == nullptr || value->get_type() == constant.get_type()) {
+                    return constant;
+                }
+                return coerce_constant(constant, value->get_type(), strings);
+            }
+
+
+/// Returns the statistics of a column after the table was reduced to
+/// `row_count` tuples.
+            ColumnStatistics scale_column(const ColumnStatistics& column, uint64_t row_count) {
+                ColumnStatistics scaled = column;
+                if (scaled.distinct_count > row_count) {
+                    scaled.distinct_count = row_count;
+                }
+                return scaled;
+            }
+
+
+/// Returns the statistics of a table after it was reduced to `row_count`
+/// tuples.
+            TableStatistics scale_table(const TableStatistics& input, uint64_t row_count) {
+                TableStatistics output;
+                output.row_count = row_count;
+                for (auto& column : input.columns) {
+                    output.columns.push_back(scale_column(column, row_count));
+                }
+                return output;
+            }
+
+
+/// Computes the output statistics of a predicate between an attribute and a
+/// constant.
+            TableStatistics estimate_constant_select(
+                    const TableStatistics& input,
+                    size_t attr_index,
+                    const Register& constant,
+                    Select::PredicateType predicate_type
+            ) {
+                ColumnStatistics unknown;
+                const ColumnStatistics& column = attr_index < input.columns.size() ? input.columns[attr_index] : unknown;
+                StringArena strings;
+                Register typed_constant = to_column_type(column, constant, strings);
+                double selectivity = column.estimate_selectivity(predicate_type, typed_constant);
+                TableStatistics output = scale_table(input, scale_rows(input.row_count, selectivity));
+                // A converted long VARCHAR constant points into `strings`, so
+                // it must not become a bound of the output.
+                if (attr_index >= output.columns.size() || strings.get_size_in_bytes() > 0) {
+                    return output;
+                }
+
+                auto& restricted = output.columns[attr_index];
+                switch (predicate_type) {
+                    case Select::PredicateType::EQ:
+                        restricted.distinct_count = std::min<uint64_t>(1, output.row_count);
+                        restricted.min = typed_constant;
+                        restricted.max = typed_constant;
+                        restricted.histogram_bounds.clear();
+                        break;
+                    case Select::PredicateType::LT:
+                    case Select::PredicateType::LE:
+                        if (!restricted.max || typed_constant < *restricted.max) {
+                            restricted.max = typed_constant;
+                        }
+                        break;
+                    case Select::PredicateType::GT:
+                    case Select::PredicateType::GE:
+                        if (!restricted.min || typed_constant > *restricted.min) {
+                            restricted.min = typed_constant;
+                        }
+                        break;
+                    case Select::PredicateType::NE:
+                        break;
+                }
+                return output;
+            }
+
+
+/// Is `value` a number, i.e. not a string?
+            bool is_numeric(const Register& value) {
+                return value.get_type() != Register::Type::CHAR16 && value.get_type() != Register::Type::VARCHAR;
+            }
+
+
+/// Adds a value to the synopsis of its attribute.
+            void add_value(ColumnSynopsis& column, const Register& value) {
+                column.distinct_values.add(value);
+                column.sample.add(value);
+                if (!column.min || value < *column.min) {
+                    column.min = value;
+                }
+                if (!column.max || value > *column.max) {
+                    column.max = value;
+                }
+            }
+
+        }  // namespace
+
+
+        double ColumnStatistics::estimate_fraction_below(const Register& constant) const {
+            StringArena strings;
+            Register typed_constant = to_column_type(*this, constant, strings);
+            if (this->min && typed_constant <= *this->min) {
+                return 0.0;
+            }
+            if (this->max && typed_constant > *this->max) {
+                return 1.0;
+            }
+
+            if (!this->histogram_bounds.empty()) {
+                auto bucket_count = static_cast<double>(this->histogram_bounds.size());
+                auto bucket = static_cast<size_t>(
+                    std::lower_bound(this->histogram_bounds.begin(), this->histogram_bounds.end(), typed_constant)
+                    - this->histogram_bounds.begin());
+                if (bucket == this->histogram_bounds.size()) {
+                    return 1.0;
+                }
+
+                // Interpolate within the bucket for numbers, assume the middle
+                // of the bucket otherwise.
+                double within_bucket = 0.5;
+                const Register& upper = this->histogram_bounds[bucket];
+                const Register* lower = nullptr;
+                if (bucket > 0) {
+                    lower = &this->histogram_bounds[bucket - 1];
+                } else if (this->min) {
+                    lower = &*this->min;
+                }
+                if (lower != nullptr
+                    && is_numeric(typed_constant)
+                    && is_numeric(upper)
+                    && is_numeric(*lower)
+                    && upper.as_double() > lower->as_double()) {
+                    within_bucket = (typed_constant.as_double() - lower->as_double())
+                        / (upper.as_double() - lower->as_double());
+                    within_bucket = std::min(std::max(within_bucket, 0.0), 1.0);
+                }
+                return (static_cast<double>(bucket) + within_bucket) / bucket_count;
+            }
+
+            if (this->min && this->max) {
+                if (is_numeric(typed_constant) && is_numeric(*this->min)) {
+                    auto range = this->max->as_double() - this->min->as_double() + 1.0;
+                    return (typed_constant.as_double() - this->min->as_double()) / range;
+                }
+                return 0.5;
+            }
+            return default_range_selectivity;
+        }
+
+
+        double ColumnStatistics::estimate_selectivity(Select::PredicateType predicate_type, const Register& constant) const {
+            StringArena strings;
+            Register typed_constant = to_column_type(*this, constant, strings);
+            double equal = default_equality_selectivity;
+            if ((this->min && typed_constant < *this->min) || (this->max && typed_constant > *this->max)) {
+                equal = 0.0;
+            } else if (this->distinct_count > 0) {
+                equal = 1.0 / static_cast<double>(this->distinct_count);
+            }
+
+            bool has_range_info = this->min || this->max || !this->histogram_bounds.empty();
+            double below = this->estimate_fraction_below(typed_constant);
+            double selectivity = 0;
+            switch (predicate_type) {
+                case Select::PredicateType::EQ:
+                    selectivity = equal;
+                    break;
+                case Select::PredicateType::NE:
+                    selectivity = 1.0 - equal;
+                    break;
+                case Select::PredicateType::LT:
+                    selectivity = below;
+                    break;
+                case Select::PredicateType::LE:
+                    selectivity = has_range_info ? below + equal : below;
+                    break;
+                case Select::PredicateType::GT:
+                    selectivity = has_range_info ? 1.0 - below - equal : default_range_selectivity;
+                    break;
+                case Select::PredicateType::GE:
+                    selectivity = has_range_info ? 1.0 - below : default_range_selectivity;
+                    break;
+            }
+            return std::min(std::max(selectivity, 0.0), 1.0);
+        }
+
+
+        TableStatistics estimate_select(const TableStatistics& input, const Select::PredicateAttributeInt64& predicate) {
+            return estimate_constant_select(
+                input, predicate.attr_index, Register::from_int(predicate.constant), predicate.predicate_type);
+        }
+
+
+        TableStatistics estimate_select(const TableStatistics& input, const Select::PredicateAttributeChar16& predicate) {
+            return estimate_constant_select(
+                input, predicate.attr_index, Register::from_string(predicate.constant), predicate.predicate_type);
+        }
+
+
+        TableStatistics estimate_select(const TableStatistics& input, const Select::PredicateAttributeValue& predicate) {
+            return estimate_constant_select(input, predicate.attr_index, predicate.constant, predicate.predicate_type);
+        }
+
+
+        TableStatistics estimate_select(const TableStatistics& input, const Select::PredicateAttributeAttribute& predicate) {
+            double selectivity = default_range_selectivity;
+            if (predicate.predicate_type == Select::PredicateType::EQ
+                || predicate.predicate_type == Select::PredicateType::NE) {
+                uint64_t distinct = input.row_count;
+                if (predicate.attr_left_index < input.columns.size() && predicate.attr_right_index < input.columns.size()) {
+                    distinct = std::max(
+                        distinct_count(input.columns[predicate.attr_left_index], input.row_count),
+                        distinct_count(input.columns[predicate.attr_right_index], input.row_count));
+                }
+                double equal = 1.0 / static_cast<double>(std::max<uint64_t>(distinct, 1));
+                selectivity = predicate.predicate_type == Select::PredicateType::EQ ? equal : 1.0 - equal;
+            }
+            return scale_table(input, scale_rows(input.row_count, selectivity));
+        }
+
+
+        TableStatistics estimate_parameter_select(
+                const TableStatistics& input,
+                size_t attr_index,
+                Select::PredicateType predicate_type
+        ) {
+            double equal = default_equality_selectivity;
+            if (attr_index < input.columns.size() && input.columns[attr_index].distinct_count > 0) {
+                equal = 1.0 / static_cast<double>(input.columns[attr_index].distinct_count);
+            }
+            double selectivity = default_range_selectivity;
+            if (predicate_type == Select::PredicateType::EQ) {
+                selectivity = equal;
+            } else if (predicate_type == Select::PredicateType::NE) {
+                selectivity = 1.0 - equal;
+            }
+            TableStatistics output = scale_table(input, scale_rows(input.row_count, selectivity));
+            if (predicate_type == Select::PredicateType::EQ && attr_index < output.columns.size()) {
+                output.columns[attr_index].distinct_count = std::min<uint64_t>(1, output.row_count);
+            }
+            return output;
+        }
+
+
+        TableStatistics estimate_projection(const TableStatistics& input, const std::vector<size_t>& attr_indexes) {
+            TableStatistics output;
+            output.row_count = input.row_count;
+            for (size_t attr_index : attr_indexes) {
+                output.columns.push_back(attr_index < input.columns.size() ? input.columns[attr_index] : ColumnStatistics{});
+            }
+            return output;
+        }
+
+
+        TableStatistics estimate_join(
+                const TableStatistics& left,
+                const TableStatistics& right,
+                size_t attr_index_left,
+                size_t attr_index_right
+        ) {
+            uint64_t distinct_left = left.row_count;
+            if (attr_index_left < left.columns.size()) {
+                distinct_left = distinct_count(left.columns[attr_index_left], left.row_count);
+            }
+            uint64_t distinct_right = right.row_count;
+            if (attr_index_right < right.columns.size()) {
+                distinct_right = distinct_count(right.columns[attr_index_right], right.row_count);
+            }
+            double product = static_cast<double>(left.row_count) * static_cast<double>(right.row_count);
+            double distinct = static_cast<double>(std::max<uint64_t>(std::max(distinct_left, distinct_right), 1));
+
+            TableStatistics output;
+            output.row_count = static_cast<uint64_t>(std::ceil(product / distinct));
+            for (auto& column : left.columns) {
+                output.columns.push_back(scale_column(column, output.row_count));
+            }
+            for (auto& column : right.columns) {
+                output.columns.push_back(scale_column(column, output.row_count));
+            }
+            // Only keys that occur on both sides survive the join.
+            if (attr_index_left < left.columns.size() && attr_index_right < right.columns.size()) {
+                uint64_t key_distinct = std::min(
+                    std::min(distinct_left, distinct_right), output.row_count);
+                output.columns[attr_index_left].distinct_count = key_distinct;
+                output.columns[left.columns.size() + attr_index_right].distinct_count = key_distinct;
+            }
+            return output;
+        }
+
+
+        TableStatistics estimate_semi_join(
+                const TableStatistics& left,
+                const TableStatistics& right,
+                size_t attr_index_left,
+                size_t attr_index_right,
+                bool anti
+        ) {
+            uint64_t distinct_left = left.row_count;
+            if (attr_index_left < left.columns.size()) {
+                distinct_left = distinct_count(left.columns[attr_index_left], left.row_count);
+            }
+            uint64_t distinct_right = right.row_count;
+            if (attr_index_right < right.columns.size()) {
+                distinct_right = distinct_count(right.columns[attr_index_right], right.row_count);
+            }
+            // Assume that the keys of the side with fewer distinct keys all
+            // occur on the other side.
+            double selectivity = 1.0;
+            if (distinct_left > 0) {
+                selectivity = std::min(1.0, static_cast<double>(distinct_right) / static_cast<double>(distinct_left));
+            }
+            if (anti) {
+                selectivity = 1.0 - selectivity;
+            }
+            return scale_table(left, scale_rows(left.row_count, selectivity));
+        }
+
+
+        TableStatistics estimate_aggregation(
+                const TableStatistics& input,
+                const std::vector<size_t>& group_by_attrs,
+                const std::vector<HashAggregation::AggrFunc>& aggr_funcs
+        ) {
+            double groups = std::min<double>(1, static_cast<double>(input.row_count));
+            for (size_t attr : group_by_attrs) {
+                uint64_t distinct = input.row_count;
+                if (attr < input.columns.size()) {
+                    distinct = distinct_count(input.columns[attr], input.row_count);
+                }
+                groups = std::max(groups, 1.0) * static_cast<double>(distinct);
+                groups = std::min(groups, static_cast<double>(input.row_count));
+            }
+
+            TableStatistics output;
+            output.row_count = static_cast<uint64_t>(groups);
+            for (size_t attr : group_by_attrs) {
+                ColumnStatistics column = attr < input.columns.size() ? input.columns[attr] : ColumnStatistics{};
+                output.columns.push_back(scale_column(column, output.row_count));
+            }
+            for (auto& func : aggr_funcs) {
+                ColumnStatistics column;
+                // These aggregates return values of the aggregated attribute.
+                bool input_value = func.func == HashAggregation::AggrFunc::MIN
+                    || func.func == HashAggregation::AggrFunc::MAX
+                    || func.func == HashAggregation::AggrFunc::APPROX_QUANTILE
+                    || func.func == HashAggregation::AggrFunc::APPROX_MOST_FREQUENT;
+                if (input_value && func.attr_index < input.columns.size()) {
+                    column = scale_column(input.columns[func.attr_index], output.row_count);
+                    column.histogram_bounds.clear();
+                } else {
+                    column.distinct_count = output.row_count;
+                }
+                output.columns.push_back(std::move(column));
+            }
+            return output;
+        }
+
+
+        StatisticsCollector::StatisticsCollector(size_t arity, size_t sample_size, uint64_t seed) {
+            for (size_t i = 0; i < arity; ++i) {
+                this->columns.emplace_back(sample_size, seed * arity + i);
+            }
+        }
+
+
+        void StatisticsCollector::add(const std::vector<Register>& tuple) {
+            ++this->row_count;
+            for (size_t i = 0; i < this->columns.size(); ++i) {
+                add_value(this->columns[i], tuple[i]);
+            }
+        }
+
+
+        void StatisticsCollector::add(const std::vector<Register*>& tuple) {
+            ++this->row_count;
+            for (size_t i = 0; i < this->columns.size(); ++i) {
+                add_value(this->columns[i], *tuple[i]);
+            }
+        }
+
+
+        void StatisticsCollector::merge(const StatisticsCollector& other) {
+            this->row_count += other.row_count;
+            for (size_t i = 0; i < this->columns.size(); ++i) {
+                auto& column = this->columns[i];
+                auto& other_column = other.columns[i];
+                column.distinct_values.merge(other_column.distinct_values);
+                column.sample.merge(other_column.sample);
+                if (other_column.min && (!column.min || *other_column.min < *column.min)) {
+                    column.min = other_column.min;
+                }
+                if (other_column.max && (!column.max || *other_column.max > *column.max)) {
+                    column.max = other_column.max;
+                }
+            }
+        }
+
+
+        const std::vector<ColumnSynopsis>& StatisticsCollector::get_synopses() const {
+            return this->columns;
+        }
+
+
+        TableStatistics StatisticsCollector::get_statistics(size_t histogram_buckets) const {
+            TableStatistics statistics;
+            statistics.row_count = this->row_count;
+            for (auto& column : this->columns) {
+                ColumnStatistics column_statistics;
+                column_statistics.distinct_count = std::min(column.distinct_values.estimate(), this->row_count);
+                if (this->row_count > 0) {
+                    column_statistics.distinct_count = std::max<uint64_t>(column_statistics.distinct_count, 1);
+                }
+                column_statistics.min = column.min;
+                column_statistics.max = column.max;
+
+                // Every bucket gets the same share of the sample. The last
+                // bound is the exact maximum so that all values are covered.
+                std::vector<Register> sample = column.sample.get_values();
+                std::sort(sample.begin(), sample.end());
+                size_t bucket_count = std::min(histogram_buckets, sample.size());
+                for (size_t bucket = 1; bucket <= bucket_count; ++bucket) {
+                    column_statistics.histogram_bounds.push_back(sample[bucket * sample.size() / bucket_count - 1]);
+                }
+                if (!column_statistics.histogram_bounds.empty() && column.max) {
+                    column_statistics.histogram_bounds.back() = *column.max;
+                }
+                statistics.columns.push_back(std::move(column_statistics));
+            }
+            return statistics;
+        }
+
+
+        TableStatistics analyze(Operator& input, size_t histogram_buckets, size_t sample_size) {
+            std::experimental::optional<StatisticsCollector> collector;
+            input.open();
+            while (input.next()) {
+                auto output = input.get_output();
+                if (!collector) {
+                    collector.emplace(output.size(), sample_size);
+                }
+                collector->add(output);
+            }
+            input.close();
+            if (!collector) {
+                return TableStatistics{};
+            }
+            return collector->get_statistics(histogram_buckets);
+        }
+
+    }  // namespace iterator_model
+}  // namespace moderndbs
@@ -0,0 +1,156 @@
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <thread>
+#include <utility>
+#include "moderndbs/table.h"
+
+namespace moderndbs {
+    namespace iterator_model {
+
+        namespace {
+
+/// The next data version of any table. Versions are never reused, so a table
+/// that is created where another one was destroyed does not repeat its
+/// versions.
+            std::atomic<uint64_t> next_version{1};
+
+        }  // namespace
+
+
+        Table::Table(size_t arity) {
+            this->arity = arity;
+            this->version = next_version++;
+        }
+
+
+        void Table::insert(std::vector<Register> tuple) {
+            assert(tuple.size() == this->arity);
+            if (this->tuples.empty()) {
+                this->schema.clear();
+                for (auto& value : tuple) {
+                    this->schema.push_back(value.get_type());
+                }
+            }
+            for (auto& value : tuple) {
+                if (value.get_type() == Register::Type::VARCHAR && !value.as_varchar().is_inline()) {
+                    value = Register::from_varchar(this->strings.store(value.as_varchar()));
+                }
+            }
+            this->tuples.push_back(std::move(tuple));
+            this->version = next_version++;
+        }
+
+
+        size_t Table::get_arity() const {
+            return this->arity;
+        }
+
+
+        const Schema& Table::get_schema() const {
+            return this->schema;
+        }
+
+
+        uint64_t Table::get_version() const {
+            return this->version;
+        }
+
+
+        const std::vector<std::vector<Register>>& Table::get_tuples() const {
+            return this->tuples;
+        }
+
+
+        void Table::analyze(size_t thread_count, size_t histogram_buckets, size_t sample_size) {
+            thread_count = std::max<size_t>(1, std::min(thread_count, this->tuples.size()));
+            std::vector<StatisticsCollector> collectors;
+            for (size_t i = 0; i < thread_count; ++i) {
+                collectors.emplace_back(this->arity, sample_size, i);
+            }
+
+            // Every thread collects the statistics of one contiguous range of
+            // tuples.
+            auto collect = [&](size_t part) {
+                size_t begin = this->tuples.size() * part / thread_count;
+                size_t end = this->tuples.size() * (part + 1) / thread_count;
+                for (size_t i = begin; i < end; ++i) {
+                    collectors[part].add(this->tuples[i]);
+                }
+            };
+            std::vector<std::thread> threads;
+            for (size_t part = 1; part < thread_count; ++part) {
+                threads.emplace_back(collect, part);
+            }
+            collect(0);
+            for (auto& thread : threads) {
+                thread.join();
+            }
+
+            for (size_t part = 1; part < thread_count; ++part) {
+                collectors[0].merge(collectors[part]);
+            }
+            this->statistics = collectors[0].get_statistics(histogram_buckets);
+            this->synopses = collectors[0].get_synopses();
+        }
+
+
+        TableStatistics Table::get_statistics() const {
+            TableStatistics statistics = this->statistics;
+            statistics.row_count = this->tuples.size();
+            statistics.columns.resize(this->arity);
+            return statistics;
+        }
+
+
+        const std::vector<ColumnSynopsis>& Table::get_synopses() const {
+            return this->synopses;
+        }
+
+
+        TableScan::TableScan(const Table& table) {
+            this->table = &table;
+        }
+
+
+        TableScan::~TableScan() = default;
+
+
+        const Table& TableScan::get_table() const {
+            return *this->table;
+        }
+
+
+        void TableScan::open() {
+            this->current_index = 0;
+            this->output_regs.resize(this->table->get_arity());
+            this->schema = this->table->get_schema();
+        }
+
+
+        bool TableScan::next() {
+            const auto& tuples = this->table->get_tuples();
+            if (this->current_index == tuples.size()) {
+                return false;
+            }
+            const auto& tuple = tuples[this->current_index++];
+            std::copy(tuple.begin(), tuple.end(), this->output_regs.begin());
+            return true;
+        }
+
+
+        void TableScan::close() {
+            this->output_regs.clear();
+        }
+
+
+        std::vector<Register*> TableScan::get_output() {
+            std::vector<Register*> output;
+            for (auto& reg : this->output_regs) {
+                output.push_back(&reg);
+            }
+            return output;
+        }
+
+    }  // namespace iterator_model
+}  // namespace moderndbs
@@ -0,0 +1,133 @@
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+#include <gtest/gtest.h>
+#include "moderndbs/algebra.h"
+#include "moderndbs/execution.h"
+#include "test_tuple_source.h"
+
+
+namespace {
+
+using moderndbs::iterator_model::Batch;
+using moderndbs::iterator_model::HashAggregation;
+using moderndbs::iterator_model::Query;
+using moderndbs::iterator_model::QueryInterrupted;
+using moderndbs::iterator_model::Scheduler;
+using moderndbs::iterator_model::Select;
+using moderndbs::test::TestTupleSource;
+
+
+std::vector<std::tuple<int64_t, int64_t>> make_relation(int64_t size) {
+    std::vector<std::tuple<int64_t, int64_t>> relation;
+    for (int64_t i = 0; i < size; ++i) {
+        relation.emplace_back(i, i % 7);
+    }
+    return relation;
+}
+
+
+// NOLINTNEXTLINE
+TEST(ExecutionTest, BatchesOfManyQueries) {
+    auto relation = make_relation(1000);
+    Scheduler scheduler{2};
+    std::vector<std::unique_ptr<TestTupleSource<int64_t, int64_t>>> sources;
+    std::vector<std::shared_ptr<Query>> queries;
+    for (size_t i = 0; i < 32; ++i) {
+        sources.push_back(std::make_unique<TestTupleSource<int64_t, int64_t>>(relation));
+        queries.push_back(scheduler.submit(*sources.back(), 100, 2));
+    }
+
+    for (size_t i = 0; i < queries.size(); ++i) {
+        Batch batch;
+        int64_t expected = 0;
+        while (queries[i]->wait_batch(batch)) {
+            EXPECT_LE(batch.size(), 100u);
+            for (auto& tuple : batch) {
+                ASSERT_EQ(2u, tuple.size());
+                EXPECT_EQ(expected, tuple[0].as_int());
+                ++expected;
+            }
+        }
+        EXPECT_EQ(1000, expected);
+        EXPECT_TRUE(queries[i]->is_finished());
+        EXPECT_TRUE(sources[i]->opened);
+        EXPECT_TRUE(sources[i]->closed);
+    }
+}
+
+
+// NOLINTNEXTLINE
+TEST(ExecutionTest, BlockingOperator) {
+    auto relation = make_relation(1000);
+    TestTupleSource source{relation};
+    HashAggregation aggregation{
+        source,
+        {1},
+        {HashAggregation::AggrFunc{HashAggregation::AggrFunc::COUNT, 0}}
+    };
+    Scheduler scheduler{1};
+    auto query = scheduler.submit(aggregation);
+
+    Batch batch;
+    int64_t total = 0;
+    size_t groups = 0;
+    while (query->wait_batch(batch)) {
+        for (auto& tuple : batch) {
+            total += tuple[1].as_int();
+            ++groups;
+        }
+    }
+    EXPECT_EQ(7u, groups);
+    EXPECT_EQ(1000, total);
+}
+
+
+// NOLINTNEXTLINE
+TEST(ExecutionTest, Cancel) {
+    auto relation = make_relation(10000);
+    TestTupleSource source{relation};
+    Select select{source, Select::PredicateAttributeInt64{1, 3, Select::PredicateType::GE}};
+    Scheduler scheduler{1};
+    auto query = scheduler.submit(select, 10, 1);
+
+    Batch batch;
+    ASSERT_TRUE(query->wait_batch(batch));
+    query->cancel();
+    EXPECT_TRUE(query->is_cancelled());
+    while (query->wait_batch(batch)) {}
+    EXPECT_TRUE(query->is_finished());
+    EXPECT_TRUE(source.closed);
+    EXPECT_FALSE(query->poll_batch(batch));
+}
+
+
+// NOLINTNEXTLINE
+TEST(ExecutionTest, Deadline) {
+    auto relation = make_relation(100000);
+    TestTupleSource source{relation};
+    HashAggregation aggregation{
+        source,
+        {0},
+        {HashAggregation::AggrFunc{HashAggregation::AggrFunc::COUNT, 0}}
+    };
+    Scheduler scheduler{1};
+    auto query = scheduler.submit(aggregation, 1024, 4, std::chrono::steady_clock::now());
+
+    Batch batch;
+    EXPECT_THROW(while (query->wait_batch(batch)) {}, QueryInterrupted);
+    EXPECT_TRUE(query->is_finished());
+    EXPECT_TRUE(source.closed);
+
+    // A streaming plan is interrupted as well, before its first batch.
+    TestTupleSource streaming_source{relation};
+    auto streaming_query = scheduler.submit(streaming_source, 1024, 4, std::chrono::steady_clock::now());
+    EXPECT_THROW(streaming_query->wait_batch(batch), QueryInterrupted);
+    EXPECT_TRUE(streaming_query->is_finished());
+    EXPECT_TRUE(streaming_source.closed);
+}
+
+}  // namespace
@@ -0,0 +1,187 @@
+#include <sstream>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include "moderndbs/algebra.h"
+#include "moderndbs/german_string.h"
+#include "moderndbs/table.h"
+
+
+namespace {
+
+using namespace std::literals::string_literals;
+
+using moderndbs::iterator_model::AggregationState;
+using moderndbs::iterator_model::AggregationStateScan;
+using moderndbs::iterator_model::GermanString;
+using moderndbs::iterator_model::HashAggregation;
+using moderndbs::iterator_model::Print;
+using moderndbs::iterator_model::Register;
+using moderndbs::iterator_model::Select;
+using moderndbs::iterator_model::Sort;
+using moderndbs::iterator_model::StringArena;
+using moderndbs::iterator_model::Table;
+using moderndbs::iterator_model::TableScan;
+
+
+// NOLINTNEXTLINE
+TEST(GermanStringTest, InlineAndLong) {
+    std::string short_value = "hello world";
+    std::string long_value = "a considerably longer string";
+    auto short_string = GermanString::view(short_value.data(), short_value.size());
+    auto long_string = GermanString::view(long_value.data(), long_value.size());
+
+    EXPECT_TRUE(short_string.is_inline());
+    EXPECT_FALSE(long_string.is_inline());
+    EXPECT_EQ(short_value, short_string.str());
+    EXPECT_EQ(long_value, long_string.str());
+    // Long strings point at the given characters, short ones keep a copy.
+    EXPECT_EQ(long_value.data(), long_string.data());
+    EXPECT_NE(short_value.data(), short_string.data());
+    EXPECT_EQ(0U, GermanString{}.size());
+    EXPECT_EQ(""s, GermanString{}.str());
+}
+
+
+// NOLINTNEXTLINE
+TEST(GermanStringTest, Compare) {
+    StringArena arena;
+    auto make = [&arena](const std::string& value) {
+        return arena.store(value);
+    };
+
+    EXPECT_EQ(make("abc"), make("abc"));
+    EXPECT_NE(make("abc"), make("abd"));
+    EXPECT_NE(make("abc"), make("abc "));
+    EXPECT_EQ(make("twelve chars"), make("twelve chars"));
+    EXPECT_EQ(make("a string beyond the inline size"), make("a string beyond the inline size"));
+    EXPECT_NE(make("a string beyond the inline size"), make("a string beyond the inline sizE"));
+    EXPECT_NE(make("a string beyond the inline size"), make("a string beyond"));
+
+    std::vector<std::string> values{
+        "", "a", "ab", "abcd", "abcde", "abcdefghijkl", "abcdefghijklm", "abcdefghijklmn", "abce", "b",
+    };
+    for (auto& left : values) {
+        for (auto& right : values) {
+            int expected = left.compare(right);
+            int comparison = make(left).compare(make(right));
+            EXPECT_EQ(expected < 0, comparison < 0) << left << " " << right;
+            EXPECT_EQ(expected == 0, comparison == 0) << left << " " << right;
+            EXPECT_EQ(expected == 0, make(left) == make(right)) << left << " " << right;
+        }
+        // Strings hash alike in both representations.
+        EXPECT_EQ(Register::from_string(left).get_hash(), make(left).get_hash());
+    }
+}
+
+
+// NOLINTNEXTLINE
+TEST(GermanStringTest, Arena) {
+    StringArena arena;
+    std::vector<GermanString> strings;
+    for (size_t i = 0; i < 10000; ++i) {
+        strings.push_back(arena.store("string number " + std::to_string(i)));
+    }
+    std::string huge(StringArena::chunk_size * 2, 'x');
+    auto huge_string = arena.store(huge);
+    auto after_huge = arena.store("stored after the huge string"s);
+
+    StringArena moved = std::move(arena);
+    for (size_t i = 0; i < strings.size(); ++i) {
+        EXPECT_EQ("string number " + std::to_string(i), strings[i].str());
+    }
+    EXPECT_EQ(huge, huge_string.str());
+    EXPECT_EQ("stored after the huge string"s, after_huge.str());
+    EXPECT_GE(moved.get_size_in_bytes(), huge.size() + StringArena::chunk_size);
+}
+
+
+// NOLINTNEXTLINE
+TEST(GermanStringTest, Operators) {
+    Table table{2};
+    {
+        // The table copies the characters of long strings.
+        StringArena arena;
+        table.insert({Register::from_varchar("Xenokrates", arena), Register::from_int(1)});
+        table.insert({Register::from_varchar("Schopenhauer, Arthur", arena), Register::from_int(2)});
+        table.insert({Register::from_varchar("Xenokrates", arena), Register::from_int(3)});
+        table.insert({Register::from_varchar("Fichte", arena), Register::from_int(4)});
+        table.insert({Register::from_varchar("Schopenhauer, Arthur", arena), Register::from_int(5)});
+    }
+    TableScan scan{table};
+    StringArena constants;
+    Select select{
+        scan,
+        Select::PredicateAttributeValue{
+            0, Register::from_varchar("Schopenhauer", constants), Select::PredicateType::GT}
+    };
+    HashAggregation aggregation{select, {0}, {HashAggregation::AggrFunc{HashAggregation::AggrFunc::SUM, 1}}};
+    Sort sort{aggregation, {Sort::Criterion{0, false}}};
+    std::stringstream output;
+    Print print{sort, output};
+
+    print.open();
+    EXPECT_EQ(
+        (std::vector<Register::Type>{Register::Type::VARCHAR, Register::Type::INT64}),
+        aggregation.get_schema()
+    );
+    while (print.next()) {}
+    print.close();
+
+    auto expected_output = (
+        "Schopenhauer, Arthur,7\n"
+        "Xenokrates,4\n"s
+    );
+    EXPECT_EQ(expected_output, output.str());
+}
+
+
+// NOLINTNEXTLINE
+TEST(GermanStringTest, AggregationStateOwnsStrings) {
+    std::vector<HashAggregation::AggrFunc> aggr_funcs{
+        HashAggregation::AggrFunc{HashAggregation::AggrFunc::MIN, 1},
+        HashAggregation::AggrFunc{HashAggregation::AggrFunc::MAX, 1},
+    };
+    auto insert_delta = [](AggregationState& state, const std::vector<std::pair<std::string, std::string>>& tuples) {
+        // The delta and its strings are gone once the state is updated.
+        Table delta{2};
+        StringArena arena;
+        for (auto& [key, value] : tuples) {
+            delta.insert({Register::from_varchar(key, arena), Register::from_varchar(value, arena)});
+        }
+        TableScan scan{delta};
+        state.insert(scan);
+    };
+    auto print_state = [](const AggregationState& state) {
+        AggregationStateScan scan{state};
+        std::stringstream output;
+        Print print{scan, output};
+        print.open();
+        while (print.next()) {}
+        print.close();
+        return output.str();
+    };
+
+    AggregationState state{{0}, aggr_funcs};
+    insert_delta(state, {
+        {"the first long group key", "a long value in the middle"},
+        {"the first long group key", "a long value at the end"},
+    });
+    insert_delta(state, {{"the first long group key", "a long value at the start"}});
+
+    AggregationState other{{0}, aggr_funcs};
+    insert_delta(other, {
+        {"the first long group key", "a long value before the start"},
+        {"the second long group key", "the only value of the group"},
+    });
+    state.merge(other);
+    other = AggregationState{{0}, aggr_funcs};
+
+    EXPECT_EQ(
+        "the first long group key,a long value at the end,a long value in the middle\n"
+        "the second long group key,the only value of the group,the only value of the group\n"s,
+        print_state(state)
+    );
+}
+
+}  // namespace
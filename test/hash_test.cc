@@ -0,0 +1,79 @@
+#include <cstdint>
+#include <set>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include "moderndbs/algebra.h"
+#include "moderndbs/hash.h"
+
+
+namespace {
+
+using namespace std::literals::string_literals;
+
+using moderndbs::iterator_model::combine_hashes;
+using moderndbs::iterator_model::hash_bytes;
+using moderndbs::iterator_model::hash_int;
+using moderndbs::iterator_model::Register;
+
+
+// NOLINTNEXTLINE
+TEST(HashTest, Integers) {
+    // Consecutive keys spread over the buckets selected by the low bits.
+    std::set<uint64_t> buckets;
+    for (uint64_t i = 0; i < 1024; ++i) {
+        buckets.insert(hash_int(i) & 1023U);
+    }
+    EXPECT_GT(buckets.size(), 600U);
+
+    // So do keys that only differ in their high bits.
+    buckets.clear();
+    for (uint64_t i = 0; i < 1024; ++i) {
+        buckets.insert(hash_int(i << 40U) & 1023U);
+    }
+    EXPECT_GT(buckets.size(), 600U);
+}
+
+
+// NOLINTNEXTLINE
+TEST(HashTest, Bytes) {
+    std::string value = "Xenokrates      ";
+    EXPECT_EQ(hash_bytes(value.data(), value.size()), hash_bytes(value.data(), value.size()));
+    EXPECT_NE(hash_bytes(value.data(), value.size()), hash_bytes("Xenokrates     x", 16));
+    // Zero characters do not collide with the padding of the last word.
+    EXPECT_NE(hash_bytes("a", 1), hash_bytes("a\0", 2));
+    EXPECT_NE(hash_bytes("", 0), hash_bytes("\0", 1));
+
+    std::set<uint64_t> hashes;
+    for (int i = 0; i < 1000; ++i) {
+        std::string key = "key " + std::to_string(i);
+        hashes.insert(hash_bytes(key.data(), key.size()));
+    }
+    EXPECT_EQ(1000U, hashes.size());
+}
+
+
+// NOLINTNEXTLINE
+TEST(HashTest, Registers) {
+    std::vector<Register> values{
+        Register::from_int(42),
+        Register::from_int32(42),
+        Register::from_double(-0.0),
+        Register::from_date(9204),
+        Register::from_decimal(1234),
+        Register::from_string("this is a string"s),
+    };
+    for (auto& value : values) {
+        EXPECT_EQ(value.get_hash(), Register::hash(value, value.get_type()));
+    }
+    EXPECT_EQ(Register::from_double(0.0).get_hash(), Register::from_double(-0.0).get_hash());
+
+    // Combining is not symmetric and keys with equal attributes do not
+    // collide.
+    uint64_t a = hash_int(1);
+    uint64_t b = hash_int(2);
+    EXPECT_NE(combine_hashes(combine_hashes(0, a), b), combine_hashes(combine_hashes(0, b), a));
+    EXPECT_NE(combine_hashes(combine_hashes(0, a), a), combine_hashes(combine_hashes(0, b), b));
+}
+
+}  // namespace
@@ -1,4 +1,6 @@
 #include <algorithm>
+#include <chrono>
+#include <functional>
 #include <sstream>
 #include <string>
 #include <tuple>
@@ -6,6 +8,7 @@
 #include <vector>
 #include <gtest/gtest.h>
 #include "moderndbs/algebra.h"
+#include "test_tuple_source.h"
 
 
 namespace {
@@ -13,18 +16,27 @@ namespace {
 using namespace std::literals::string_literals;
 
 using moderndbs::iterator_model::Register;
+using moderndbs::iterator_model::CancellationToken;
+using moderndbs::iterator_model::QueryInterrupted;
 using moderndbs::iterator_model::Print;
 using moderndbs::iterator_model::Projection;
 using moderndbs::iterator_model::Select;
+using moderndbs::iterator_model::Limit;
 using moderndbs::iterator_model::Sort;
+using moderndbs::iterator_model::Window;
 using moderndbs::iterator_model::HashJoin;
+using moderndbs::iterator_model::GroupJoin;
 using moderndbs::iterator_model::HashAggregation;
+using moderndbs::iterator_model::AggregationState;
+using moderndbs::iterator_model::AggregationStateScan;
 using moderndbs::iterator_model::Union;
 using moderndbs::iterator_model::UnionAll;
 using moderndbs::iterator_model::Intersect;
 using moderndbs::iterator_model::IntersectAll;
 using moderndbs::iterator_model::Except;
 using moderndbs::iterator_model::ExceptAll;
+using moderndbs::iterator_model::hash_attributes;
+using moderndbs::test::TestTupleSource;
 
 
 // NOLINTNEXTLINE
@@ -74,75 +86,47 @@ TEST(IteratorModelTest, Register) {
 }
 
 
-Register convert_to_register(int64_t value) {
-    return Register::from_int(value);
-}
-
-
-Register convert_to_register(const std::string& value) {
-    return Register::from_string(value);
-}
-
-
-template <typename... Ts, size_t... Is>
-void write_to_registers_impl(
-    std::vector<Register>& registers,
-    const std::tuple<Ts...>& tuple,
-    std::index_sequence<Is...>
-) {
-    ((registers[Is] = convert_to_register(std::get<Is>(tuple))),...);
-}
-
-
-template <typename... Ts>
-void write_to_registers(std::vector<Register>& registers, const std::tuple<Ts...>& tuple) {
-    write_to_registers_impl(registers, tuple, std::index_sequence_for<Ts...>{});
-}
-
-
-template <typename... Ts>
-class TestTupleSource
-: public moderndbs::iterator_model::Operator {
-private:
-    const std::vector<std::tuple<Ts...>>& tuples;
-    size_t current_index = 0;
-    std::vector<Register> output_regs;
-
-public:
-    bool opened = false;
-    bool closed = false;
-
-    explicit TestTupleSource(const std::vector<std::tuple<Ts...>>& tuples) : tuples(tuples) {}
-
-    void open() override {
-        output_regs.resize(sizeof...(Ts));
-        opened = true;
-    }
-
-    bool next() override {
-        if (current_index < tuples.size()) {
-            write_to_registers(output_regs, tuples[current_index]);
-            ++current_index;
-            return true;
-        } else {
-            return false;
-        }
-    }
-
-    void close() override {
-        output_regs.clear();
-        closed = true;
+// NOLINTNEXTLINE
+TEST(IteratorModelTest, RegisterTypes) {
+    auto reg_int32 = Register::from_int32(12345);
+    auto reg_double = Register::from_double(1.5);
+    auto reg_date = Register::from_date(9204);
+    auto reg_decimal = Register::from_decimal(-5);
+
+    ASSERT_EQ(Register::Type::INT32, reg_int32.get_type());
+    ASSERT_EQ(Register::Type::DOUBLE, reg_double.get_type());
+    ASSERT_EQ(Register::Type::DATE, reg_date.get_type());
+    ASSERT_EQ(Register::Type::DECIMAL, reg_decimal.get_type());
+
+    EXPECT_EQ(12345, reg_int32.as_int());
+    EXPECT_EQ(1.5, reg_double.as_double());
+    EXPECT_EQ(9204, reg_date.as_int());
+    EXPECT_EQ(-5, reg_decimal.as_int());
+    EXPECT_EQ(-0.05, reg_decimal.as_double());
+
+    EXPECT_EQ("12345"s, reg_int32.to_string());
+    EXPECT_EQ("1.5"s, reg_double.to_string());
+    EXPECT_EQ("1995-03-15"s, reg_date.to_string());
+    EXPECT_EQ("1969-12-31"s, Register::from_date(-1).to_string());
+    EXPECT_EQ("2000-02-29"s, Register::from_date(11016).to_string());
+    EXPECT_EQ("-0.05"s, reg_decimal.to_string());
+    EXPECT_EQ("12.34"s, Register::from_decimal(1234).to_string());
+    for (auto& reg : {reg_int32, reg_double, reg_date, reg_decimal, Register::from_string("text")}) {
+        EXPECT_EQ(reg.to_string(), Register::to_string(reg, reg.get_type()));
     }
 
-    std::vector<Register*> get_output() override {
-        std::vector<Register*> output;
-        output.reserve(sizeof...(Ts));
-        for (auto& reg : output_regs) {
-            output.push_back(&reg);
-        }
-        return output;
-    }
-};
+    // Values of different types are never equal.
+    EXPECT_NE(Register::from_int(12345), reg_int32);
+    EXPECT_NE(Register::from_decimal(9204), reg_date);
+    EXPECT_EQ(Register::from_int32(12345), reg_int32);
+
+    EXPECT_LT(Register::from_double(-0.5), reg_double);
+    EXPECT_LT(Register::from_date(9203), reg_date);
+    EXPECT_GT(Register::from_decimal(1), reg_decimal);
+    EXPECT_EQ(Register::from_double(0.0), Register::from_double(-0.0));
+    EXPECT_EQ(Register::from_double(0.0).get_hash(), Register::from_double(-0.0).get_hash());
+    EXPECT_EQ(Register::from_date(9204).get_hash(), reg_date.get_hash());
+}
 
 
 const std::vector<std::tuple<int64_t, std::string>> relation_students{
@@ -372,6 +356,129 @@ TEST(IteratorModelTest, SelectAttrAttr) {
 }
 
 
+// NOLINTNEXTLINE
+TEST(IteratorModelTest, SelectModes) {
+    // Pseudo-random values from 0 to 99 that no branch predictor can follow.
+    std::vector<std::tuple<int64_t, int64_t>> relation;
+    for (int64_t i = 0; i < 20000; ++i) {
+        relation.emplace_back(i, i * 7919 % 100);
+    }
+    auto select = [&relation](int64_t constant, Select::Mode mode) {
+        TestTupleSource source{relation};
+        Select select{source, Select::PredicateAttributeInt64{1, constant, Select::PredicateType::LT}};
+        select.set_mode(mode);
+        std::stringstream output;
+        Print print{select, output};
+        print.open();
+        while (print.next()) {}
+        print.close();
+        EXPECT_EQ((relation.size() + Select::batch_size - 1) / Select::batch_size, select.get_batch_count());
+        return std::make_pair(output.str(), select.get_predicated_count());
+    };
+
+    for (int64_t constant : {0, 1, 50, 99, 100}) {
+        std::string expected_output;
+        for (auto& [key, value] : relation) {
+            if (value < constant) {
+                expected_output += std::to_string(key) + "," + std::to_string(value) + "\n";
+            }
+        }
+        auto branching = select(constant, Select::Mode::BRANCHING);
+        auto predicated = select(constant, Select::Mode::PREDICATED);
+        auto adaptive = select(constant, Select::Mode::ADAPTIVE);
+        EXPECT_EQ(expected_output, branching.first);
+        EXPECT_EQ(expected_output, predicated.first);
+        EXPECT_EQ(expected_output, adaptive.first);
+        EXPECT_EQ(0U, branching.second);
+        EXPECT_EQ(20U, predicated.second);
+        // Only batches after a batch with a mid-range selectivity are
+        // predicated, the first batch is not.
+        EXPECT_EQ(constant == 50 ? 19U : 0U, adaptive.second);
+    }
+}
+
+
+// NOLINTNEXTLINE
+TEST(IteratorModelTest, SelectMixedIntegerWidths) {
+    std::vector<std::tuple<int32_t, int64_t, double>> relation{
+        {3, 5, 1.0}, {5, 5, 5.0}, {7, 2, 7.5},
+    };
+    auto select = [&relation](auto predicate) {
+        TestTupleSource source{relation};
+        Select select{source, predicate};
+        std::stringstream output;
+        Print print{select, output};
+        print.open();
+        while (print.next()) {}
+        print.close();
+        return output.str();
+    };
+
+    // INT64 constants compare with INT32 and DOUBLE attributes.
+    EXPECT_EQ("5,5,5\n", select(Select::PredicateAttributeInt64{0, 5, Select::PredicateType::EQ}));
+    EXPECT_EQ("3,5,1\n", select(Select::PredicateAttributeInt64{0, 5, Select::PredicateType::LT}));
+    EXPECT_EQ(
+        "5,5,5\n7,2,7.5\n",
+        select(Select::PredicateAttributeValue{2, Register::from_int(5), Select::PredicateType::GE})
+    );
+    EXPECT_EQ(
+        "3,5,1\n5,5,5\n",
+        select(Select::PredicateAttributeAttribute{0, 1, Select::PredicateType::LE})
+    );
+    EXPECT_THROW(
+        select(Select::PredicateAttributeChar16{0, "5", Select::PredicateType::EQ}),
+        std::invalid_argument
+    );
+    EXPECT_THROW(
+        select(Select::PredicateAttributeAttribute{0, 2, Select::PredicateType::EQ}),
+        std::invalid_argument
+    );
+}
+
+
+// NOLINTNEXTLINE
+TEST(IteratorModelTest, Limit) {
+    std::vector<std::tuple<int64_t>> relation;
+    for (int64_t i = 0; i < 100000; ++i) {
+        relation.emplace_back(i);
+    }
+    TestTupleSource source{relation};
+    Select select{source, Select::PredicateAttributeInt64{0, 10, Select::PredicateType::GE}};
+    Limit limit{select, 3, 2};
+    std::stringstream output;
+    Print print{limit, output};
+
+    print.open();
+    EXPECT_TRUE(source.opened);
+    while (print.next()) {}
+    // The input is closed as soon as the limit is reached.
+    EXPECT_TRUE(source.closed);
+    print.close();
+
+    auto expected_output = (
+        "12\n"
+        "13\n"
+        "14\n"s
+    );
+    EXPECT_EQ(expected_output, output.str());
+
+    TestTupleSource source_students{relation_students};
+    Limit empty{source_students, 0};
+    empty.open();
+    EXPECT_FALSE(empty.next());
+    EXPECT_TRUE(source_students.closed);
+    empty.close();
+
+    TestTupleSource source_grades{relation_grades};
+    Limit past_end{source_grades, 10, 5};
+    past_end.open();
+    EXPECT_FALSE(past_end.next());
+    EXPECT_FALSE(source_grades.closed);
+    past_end.close();
+    EXPECT_TRUE(source_grades.closed);
+}
+
+
 // NOLINTNEXTLINE
 TEST(IteratorModelTest, Sort) {
     TestTupleSource source{relation_grades};
@@ -394,6 +501,138 @@ TEST(IteratorModelTest, Sort) {
     EXPECT_EQ(expected_output, output.str());
 }
 
+// NOLINTNEXTLINE
+TEST(IteratorModelTest, Window) {
+    std::vector<std::tuple<int64_t, int64_t>> relation{
+        {1, 20}, {2, 7}, {1, 30}, {1, 10}, {2, 5}, {1, 20}
+    };
+    TestTupleSource source{relation};
+    Window window{
+        source,
+        {0},
+        {{1, false}},
+        {
+            Window::Function::row_number(),
+            Window::Function::rank(),
+            Window::Function::dense_rank(),
+            Window::Function::lag(1, 1, Register::from_int(-1)),
+            Window::Function::sum(1),
+            Window::Function::max(1, Window::Frame::rows(1, 1)),
+            Window::Function::count(Window::Frame::partition()),
+        },
+        2
+    };
+    std::stringstream output;
+    Print print{window, output};
+
+    print.open();
+    EXPECT_TRUE(source.opened);
+    while (print.next()) {}
+    print.close();
+    EXPECT_TRUE(source.closed);
+
+    auto expected_output = (
+        "1,10,1,1,1,-1,10,20,4\n"
+        "1,20,2,2,2,10,30,20,4\n"
+        "1,20,3,2,2,20,50,30,4\n"
+        "1,30,4,4,3,20,80,30,4\n"
+        "2,5,1,1,1,-1,5,7,2\n"
+        "2,7,2,2,2,5,12,7,2\n"s
+    );
+    EXPECT_EQ(expected_output, output.str());
+}
+
+// NOLINTNEXTLINE
+TEST(IteratorModelTest, WindowSlidingFrames) {
+    std::vector<std::tuple<int64_t, int64_t>> relation;
+    for (int64_t i = 0; i < 1000; ++i) {
+        relation.emplace_back(i % 7, (i * 7919) % 1009);
+    }
+    TestTupleSource source{relation};
+    Window window{
+        source,
+        {0},
+        {{1, true}},
+        {
+            Window::Function::sum(1, Window::Frame::rows(2, 1)),
+            Window::Function::min(1, Window::Frame::rows(3, 0)),
+            Window::Function::lead(1, 2, Register::from_int(0)),
+        },
+        4
+    };
+
+    // Compute the expected values row by row on the sorted partitions.
+    std::vector<std::vector<int64_t>> partitions(7);
+    for (auto& [partition, value] : relation) {
+        partitions[partition].push_back(value);
+    }
+    std::string expected_output;
+    for (size_t p = 0; p < partitions.size(); ++p) {
+        auto& values = partitions[p];
+        std::sort(values.begin(), values.end(), std::greater<>());
+        for (size_t i = 0; i < values.size(); ++i) {
+            int64_t sum = 0;
+            for (size_t j = i < 2 ? 0 : i - 2; j < std::min(values.size(), i + 2); ++j) {
+                sum += values[j];
+            }
+            int64_t min = *std::min_element(values.begin() + (i < 3 ? 0 : i - 3), values.begin() + i + 1);
+            int64_t lead = i + 2 < values.size() ? values[i + 2] : 0;
+            expected_output += std::to_string(p) + "," + std::to_string(values[i]) + ",";
+            expected_output += std::to_string(sum) + "," + std::to_string(min) + "," + std::to_string(lead) + "\n";
+        }
+    }
+
+    std::stringstream output;
+    Print print{window, output};
+    print.open();
+    while (print.next()) {}
+    print.close();
+    EXPECT_EQ(expected_output, output.str());
+}
+
+
+// NOLINTNEXTLINE
+TEST(IteratorModelTest, WindowSumOfInt32) {
+    using Type = Register::Type;
+    std::vector<std::tuple<int64_t, int32_t>> relation{
+        {1, 10}, {1, 20}, {2, 5}, {1, 30}, {2, 7},
+    };
+    TestTupleSource source{relation};
+    Window window{
+        source,
+        {0},
+        {{1, false}},
+        {
+            Window::Function::sum(1),
+            Window::Function::sum(1, Window::Frame::rows(0, 0)),
+            Window::Function::sum(1, Window::Frame::rows(1, 0)),
+        }
+    };
+
+    // Sums of INT32 are INT64, also in frames of a single row.
+    window.open();
+    EXPECT_EQ((std::vector<Type>{Type::INT64, Type::INT32, Type::INT64, Type::INT64, Type::INT64}), window.get_schema());
+    std::vector<std::string> rows;
+    while (window.next()) {
+        std::string row;
+        for (auto* reg : window.get_output()) {
+            row += reg->to_string() + (reg->get_type() == Type::INT64 ? "l" : "i") + ",";
+        }
+        rows.push_back(row);
+    }
+    window.close();
+    EXPECT_EQ(
+        (std::vector<std::string>{
+            "1l,10i,10l,10l,10l,",
+            "1l,20i,30l,20l,30l,",
+            "1l,30i,60l,30l,50l,",
+            "2l,5i,5l,5l,5l,",
+            "2l,7i,12l,7l,12l,",
+        }),
+        rows
+    );
+}
+
 // NOLINTNEXTLINE
 TEST(IteratorModelTest, HashJoin) {
     TestTupleSource source_students{relation_students};
@@ -477,6 +716,645 @@ TEST(IteratorModelTest, HashAggregationSumCount) {
     EXPECT_EQ(expected_output, sort_output(output.str()));
 }
 
+// NOLINTNEXTLINE
+TEST(IteratorModelTest, HashJoinProbeGroups) {
+    // More probe tuples than fit into one probe group, with duplicate keys on
+    // both sides and probe keys without a join partner.
+    std::vector<std::tuple<int64_t, int64_t>> relation_left;
+    std::vector<std::tuple<int64_t>> relation_right;
+    for (int64_t i = 0; i < 100; ++i) {
+        relation_left.emplace_back(i % 50, i);
+    }
+    for (int64_t i = 0; i < 75; ++i) {
+        relation_right.emplace_back(i);
+    }
+    TestTupleSource source_left{relation_left};
+    TestTupleSource source_right{relation_right};
+    HashJoin join{source_left, source_right, 0, 0};
+    std::stringstream output;
+    Print print{join, output};
+
+    print.open();
+    size_t count = 0;
+    while (print.next()) {
+        ++count;
+    }
+    print.close();
+
+    std::string expected_output;
+    for (int64_t i = 0; i < 100; ++i) {
+        expected_output += std::to_string(i % 50) + "," + std::to_string(i) + ",";
+        expected_output += std::to_string(i % 50) + "\n";
+    }
+    EXPECT_EQ(100u, count);
+    EXPECT_EQ(sort_output(expected_output), sort_output(output.str()));
+}
+
+
+// NOLINTNEXTLINE
+TEST(IteratorModelTest, HashJoinSemiAnti) {
+    std::vector<std::tuple<int64_t, std::string>> relation_left{
+        {1, "one"}, {2, "two"}, {3, "three"}, {4, "four"},
+    };
+    std::vector<std::tuple<int64_t>> relation_right{{2}, {4}, {4}, {5}};
+
+    TestTupleSource source_left{relation_left};
+    TestTupleSource source_right{relation_right};
+    HashJoin semi_join{source_left, source_right, 0, 0, HashJoin::Type::SEMI};
+    std::stringstream semi_output;
+    Print semi_print{semi_join, semi_output};
+    semi_print.open();
+    while (semi_print.next()) {}
+    semi_print.close();
+    EXPECT_EQ("2,two\n4,four\n", sort_output(semi_output.str()));
+
+    TestTupleSource source_left_2{relation_left};
+    TestTupleSource source_right_2{relation_right};
+    HashJoin anti_join{source_left_2, source_right_2, 0, 0, HashJoin::Type::ANTI};
+    std::stringstream anti_output;
+    Print anti_print{anti_join, anti_output};
+    anti_print.open();
+    while (anti_print.next()) {}
+    anti_print.close();
+    EXPECT_EQ("1,one\n3,three\n", sort_output(anti_output.str()));
+}
+
+
+// NOLINTNEXTLINE
+TEST(IteratorModelTest, AdaptiveHashJoin) {
+    // Every third left tuple has a join partner, every sixth one has two.
+    auto join = [](int64_t left_size, HashJoin::Type type, size_t memory_budget) {
+        std::vector<std::tuple<int64_t, std::string>> relation_left;
+        std::vector<std::tuple<int64_t>> relation_right;
+        for (int64_t i = 0; i < left_size; ++i) {
+            relation_left.emplace_back(i, "value " + std::to_string(i));
+        }
+        for (int64_t i = 0; i < 2 * left_size; i += 3) {
+            relation_right.emplace_back(i);
+            if (i % 2 == 0) {
+                relation_right.emplace_back(i);
+            }
+        }
+        TestTupleSource source_left{relation_left};
+        TestTupleSource source_right{relation_right};
+        HashJoin join{source_left, source_right, 0, 0, type};
+        join.set_memory_budget(memory_budget);
+        std::stringstream output;
+        Print print{join, output};
+        print.open();
+        while (print.next()) {}
+        print.close();
+
+        std::string expected_output;
+        for (int64_t i = 0; i < left_size; ++i) {
+            std::string tuple = std::to_string(i) + ",value " + std::to_string(i);
+            if (type == HashJoin::Type::INNER && i % 3 == 0) {
+                expected_output += tuple + "," + std::to_string(i) + "\n";
+                if (i % 2 == 0) {
+                    expected_output += tuple + "," + std::to_string(i) + "\n";
+                }
+            } else if ((type == HashJoin::Type::SEMI) == (i % 3 == 0) && type != HashJoin::Type::INNER) {
+                expected_output += tuple + "\n";
+            }
+        }
+        EXPECT_EQ(sort_output(expected_output), sort_output(output.str()));
+        return std::make_pair(join.get_strategy(), join.is_spilled());
+    };
+
+    for (auto type : {HashJoin::Type::INNER, HashJoin::Type::SEMI, HashJoin::Type::ANTI}) {
+        EXPECT_EQ(std::make_pair(HashJoin::Strategy::SCAN, false), join(10, type, 0));
+        EXPECT_EQ(std::make_pair(HashJoin::Strategy::CHAINED, false), join(1000, type, 0));
+        EXPECT_EQ(std::make_pair(HashJoin::Strategy::PARTITIONED, false), join(50000, type, 0));
+        // The partitions of the spilled build side are small enough to be
+        // joined with a single directory each.
+        EXPECT_EQ(std::make_pair(HashJoin::Strategy::CHAINED, true), join(50000, type, 1U << 20U));
+        EXPECT_EQ(std::make_pair(HashJoin::Strategy::CHAINED, false), join(1000, type, 1U << 20U));
+    }
+}
+
+
+// NOLINTNEXTLINE
+TEST(IteratorModelTest, HashAggregationManyGroups) {
+    std::vector<std::tuple<int64_t, int64_t>> relation;
+    for (int64_t i = 0; i < 1000; ++i) {
+        relation.emplace_back(i % 100, i);
+    }
+    TestTupleSource source{relation};
+    HashAggregation aggregation{
+        source,
+        {0},
+        {
+            HashAggregation::AggrFunc{HashAggregation::AggrFunc::COUNT, 0},
+            HashAggregation::AggrFunc{HashAggregation::AggrFunc::MIN, 1},
+            HashAggregation::AggrFunc{HashAggregation::AggrFunc::MAX, 1},
+            HashAggregation::AggrFunc{HashAggregation::AggrFunc::SUM, 1},
+        }
+    };
+    std::stringstream output;
+    Print print{aggregation, output};
+
+    print.open();
+    while (print.next()) {}
+    print.close();
+
+    std::string expected_output;
+    for (int64_t key = 0; key < 100; ++key) {
+        expected_output += std::to_string(key) + ",10," + std::to_string(key) + ",";
+        expected_output += std::to_string(key + 900) + "," + std::to_string(10 * key + 4500) + "\n";
+    }
+    EXPECT_EQ(sort_output(expected_output), sort_output(output.str()));
+}
+
+// NOLINTNEXTLINE
+TEST(IteratorModelTest, PartitionedAggregation) {
+    auto aggregate = [](const std::vector<std::tuple<int64_t, int64_t>>& relation, size_t thread_count) {
+        TestTupleSource source{relation};
+        HashAggregation aggregation{
+            source,
+            {0},
+            {
+                HashAggregation::AggrFunc{HashAggregation::AggrFunc::SUM, 1},
+                HashAggregation::AggrFunc{HashAggregation::AggrFunc::COUNT, 0},
+            },
+            thread_count
+        };
+        std::stringstream output;
+        Print print{aggregation, output};
+        print.open();
+        while (print.next()) {}
+        print.close();
+        return std::make_pair(sort_output(output.str()), aggregation.get_bypassed_count());
+    };
+
+    // Few groups are pre-aggregated.
+    std::vector<std::tuple<int64_t, int64_t>> few_groups;
+    for (int64_t i = 0; i < 20000; ++i) {
+        few_groups.emplace_back(i % 10, i);
+    }
+    auto partitioned = aggregate(few_groups, 4);
+    EXPECT_EQ(aggregate(few_groups, 1).first, partitioned.first);
+    EXPECT_EQ(0U, partitioned.second);
+
+    // Unique keys bypass the pre-aggregation after the first interval.
+    std::vector<std::tuple<int64_t, int64_t>> unique;
+    for (int64_t i = 0; i < 20000; ++i) {
+        unique.emplace_back(i * 7919, i);
+    }
+    partitioned = aggregate(unique, 4);
+    EXPECT_EQ(aggregate(unique, 1).first, partitioned.first);
+    EXPECT_GT(partitioned.second, 10000U);
+
+    // When the keys start to repeat, the pre-aggregation is used again.
+    std::vector<std::tuple<int64_t, int64_t>> mixed = unique;
+    mixed.insert(mixed.end(), few_groups.begin(), few_groups.end());
+    mixed.insert(mixed.end(), few_groups.begin(), few_groups.end());
+    partitioned = aggregate(mixed, 3);
+    EXPECT_EQ(aggregate(mixed, 1).first, partitioned.first);
+    EXPECT_GT(partitioned.second, 10000U);
+    EXPECT_LT(partitioned.second, 20000U + HashAggregation::bypass_intervals * HashAggregation::adaptation_interval);
+}
+
+
+// NOLINTNEXTLINE
+TEST(IteratorModelTest, ArrayAggregation) {
+    using Type = Register::Type;
+    auto insert = [](AggregationState& state, const std::vector<int64_t>& keys) {
+        std::vector<std::vector<Register>> tuples;
+        for (size_t begin = 0; begin < keys.size(); begin += HashAggregation::probe_group_size) {
+            size_t count = std::min(HashAggregation::probe_group_size, keys.size() - begin);
+            tuples.assign(count, {});
+            for (size_t i = 0; i < count; ++i) {
+                tuples[i] = {Register::from_int(keys[begin + i]), Register::from_int(1)};
+            }
+            state.insert(tuples, count);
+        }
+    };
+    auto get_counts = [](const AggregationState& state) {
+        std::vector<std::pair<int64_t, int64_t>> counts;
+        for (size_t i = 0; i < state.get_group_count(); ++i) {
+            auto& group = *state.get_group(i);
+            counts.emplace_back(group[0].as_int(), group[1].as_int());
+        }
+        std::sort(counts.begin(), counts.end());
+        return counts;
+    };
+
+    // Keys that spread to both sides of the first ones widen the array.
+    AggregationState state{{0}, {HashAggregation::AggrFunc{HashAggregation::AggrFunc::COUNT, 0}}};
+    state.set_input_schema({Type::INT64, Type::INT64});
+    std::vector<int64_t> keys;
+    std::vector<std::pair<int64_t, int64_t>> expected;
+    for (int64_t k = -100; k <= 100; ++k) {
+        keys.push_back(500 + k);
+        keys.push_back(500 - k);
+        expected.emplace_back(500 + k, 2);
+    }
+    insert(state, keys);
+    EXPECT_TRUE(state.is_array_lookup());
+    EXPECT_EQ(expected, get_counts(state));
+
+    // A key far away falls back to hashing, which still finds the groups.
+    insert(state, {int64_t{1} << 40, 500});
+    EXPECT_FALSE(state.is_array_lookup());
+    expected[100].second = 3;
+    expected.emplace_back(int64_t{1} << 40, 1);
+    EXPECT_EQ(expected, get_counts(state));
+
+    // An announced range is used from the first tuple on.
+    AggregationState ranged{{0}, {HashAggregation::AggrFunc{HashAggregation::AggrFunc::COUNT, 0}}};
+    ranged.set_key_range(-5, 5);
+    ranged.set_input_schema({Type::INT64, Type::INT64});
+    insert(ranged, {-5, 5, 0, 5});
+    EXPECT_TRUE(ranged.is_array_lookup());
+    EXPECT_EQ((std::vector<std::pair<int64_t, int64_t>>{{-5, 1}, {0, 1}, {5, 2}}), get_counts(ranged));
+    ranged.clear();
+    ranged.set_key_range(0, 2 * AggregationState::max_array_range);
+    insert(ranged, {1});
+    EXPECT_FALSE(ranged.is_array_lookup());
+
+    // Keys of unknown type are always hashed.
+    AggregationState untyped{{0}, {HashAggregation::AggrFunc{HashAggregation::AggrFunc::COUNT, 0}}};
+    insert(untyped, {1, 2, 1});
+    EXPECT_FALSE(untyped.is_array_lookup());
+    EXPECT_EQ((std::vector<std::pair<int64_t, int64_t>>{{1, 2}, {2, 1}}), get_counts(untyped));
+}
+
+// NOLINTNEXTLINE
+TEST(IteratorModelTest, NormalizedKeys) {
+    using Type = Register::Type;
+    std::vector<std::vector<Register>> tuples{
+        {Register::from_string("Xenokrates      "s), Register::from_int(1), Register::from_int32(7)},
+        {Register::from_string("a"s), Register::from_int(1), Register::from_int32(1)},
+        {Register::from_string("a\0"s), Register::from_int(1), Register::from_int32(2)},
+        {Register::from_string("Xenokrates      "s), Register::from_int(1), Register::from_int32(3)},
+        {Register::from_string("a"s), Register::from_int(2), Register::from_int32(4)},
+        {Register::from_string("a"s), Register::from_int(1), Register::from_int32(5)},
+    };
+    std::vector<size_t> key_attrs{0, 1};
+    auto get_sums = [&key_attrs](const AggregationState& state) {
+        std::vector<std::string> sums;
+        for (size_t i = 0; i < state.get_group_count(); ++i) {
+            auto& group = *state.get_group(i);
+            // The hashes of normalized keys equal those of the registers.
+            EXPECT_EQ(hash_attributes(group, key_attrs), state.get_group_hash(i));
+            sums.push_back(group[0].as_string() + "," + group[1].to_string() + "," + group[2].to_string());
+        }
+        std::sort(sums.begin(), sums.end());
+        return sums;
+    };
+
+    AggregationState state{key_attrs, {HashAggregation::AggrFunc{HashAggregation::AggrFunc::SUM, 2}}};
+    state.set_input_schema({Type::CHAR16, Type::INT64, Type::INT32});
+    EXPECT_TRUE(state.has_normalized_keys());
+    state.insert(tuples, tuples.size());
+    EXPECT_TRUE(state.has_normalized_keys());
+    std::vector<std::string> expected{"Xenokrates      ,1,10", "a\0,1,2"s, "a,1,6", "a,2,4"};
+    EXPECT_EQ(expected, get_sums(state));
+
+    // Strings longer than 16 characters make the state compare registers.
+    std::vector<std::vector<Register>> long_tuples{
+        {Register::from_string("a"s), Register::from_int(2), Register::from_int32(10)},
+        {Register::from_string("more than sixteen chars"s), Register::from_int(2), Register::from_int32(1)},
+    };
+    state.insert(long_tuples, long_tuples.size());
+    EXPECT_FALSE(state.has_normalized_keys());
+    state.insert(tuples, 2);
+    expected = {"Xenokrates      ,1,17", "a\0,1,2"s, "a,1,7", "a,2,14", "more than sixteen chars,2,1"};
+    EXPECT_EQ(expected, get_sums(state));
+
+    // Single integer keys and variable-width keys are not normalized.
+    AggregationState single{{1}, {HashAggregation::AggrFunc{HashAggregation::AggrFunc::COUNT, 0}}};
+    single.set_input_schema({Type::CHAR16, Type::INT64, Type::INT32});
+    EXPECT_FALSE(single.has_normalized_keys());
+    AggregationState varchar{{0, 1}, {HashAggregation::AggrFunc{HashAggregation::AggrFunc::COUNT, 0}}};
+    varchar.set_input_schema({Type::VARCHAR, Type::INT64});
+    EXPECT_FALSE(varchar.has_normalized_keys());
+}
+
+// NOLINTNEXTLINE
+TEST(IteratorModelTest, IncrementalAggregation) {
+    std::vector<std::tuple<std::string, int64_t>> base{
+        {"a", 1}, {"b", 2}, {"a", 3}, {"c", 4},
+    };
+    std::vector<std::tuple<std::string, int64_t>> inserted{{"a", 10}, {"d", 5}};
+    std::vector<std::tuple<std::string, int64_t>> deleted{{"b", 2}, {"a", 1}};
+
+    auto print_state = [](const AggregationState& state) {
+        AggregationStateScan scan{state};
+        std::stringstream output;
+        Print print{scan, output};
+        print.open();
+        while (print.next()) {}
+        print.close();
+        return sort_output(output.str());
+    };
+
+    AggregationState state{
+        {0},
+        {
+            HashAggregation::AggrFunc{HashAggregation::AggrFunc::SUM, 1},
+            HashAggregation::AggrFunc{HashAggregation::AggrFunc::COUNT, 0},
+        }
+    };
+    TestTupleSource source_base{base};
+    state.insert(source_base);
+    EXPECT_EQ("a,4,2\nb,2,1\nc,4,1\n", print_state(state));
+
+    // The deltas update the groups without the base data. Group "b" loses
+    // its only tuple.
+    TestTupleSource source_inserted{inserted};
+    state.insert(source_inserted);
+    TestTupleSource source_deleted{deleted};
+    state.remove(source_deleted);
+    EXPECT_EQ("a,13,2\nc,4,1\nd,5,1\n", print_state(state));
+
+    // The state survives a round trip through its binary format.
+    std::stringstream stored;
+    state.save(stored);
+    AggregationState loaded = AggregationState::load(stored);
+    EXPECT_EQ(print_state(state), print_state(loaded));
+    std::vector<Register> tuple{Register::from_string("c"), Register::from_int(4)};
+    loaded.remove(tuple);
+    EXPECT_EQ("a,13,2\nd,5,1\n", print_state(loaded));
+    EXPECT_THROW(loaded.remove(tuple), std::invalid_argument);
+
+    AggregationState minimum{{0}, {HashAggregation::AggrFunc{HashAggregation::AggrFunc::MIN, 1}}};
+    EXPECT_FALSE(minimum.is_invertible());
+    EXPECT_THROW(minimum.remove(tuple), std::logic_error);
+}
+
+
+// NOLINTNEXTLINE
+TEST(IteratorModelTest, ApproximateAggregation) {
+    // Group g has 10000 tuples i with the value g * 1000 + (i % 500), except
+    // that every 20th tuple has g * 1000. That are 476 distinct values with a
+    // median of about g * 1000 + 250 and g * 1000 as the most frequent value.
+    std::vector<std::tuple<int64_t, int64_t>> relation;
+    for (int64_t g = 0; g < 4; ++g) {
+        for (int64_t i = 0; i < 10000; ++i) {
+            relation.emplace_back(g, g * 1000 + (i % 20 == 0 ? 0 : i % 500));
+        }
+    }
+    std::vector<HashAggregation::AggrFunc> aggr_funcs{
+        HashAggregation::AggrFunc{HashAggregation::AggrFunc::APPROX_COUNT_DISTINCT, 1},
+        HashAggregation::AggrFunc{HashAggregation::AggrFunc::APPROX_QUANTILE, 1, 0.5},
+        HashAggregation::AggrFunc{HashAggregation::AggrFunc::APPROX_MOST_FREQUENT, 1},
+        HashAggregation::AggrFunc{HashAggregation::AggrFunc::COUNT, 0},
+    };
+    auto check = [](const std::vector<Register>& group) {
+        int64_t base = group[0].as_int() * 1000;
+        EXPECT_NEAR(476.0, static_cast<double>(group[1].as_int()), 25.0);
+        EXPECT_NEAR(static_cast<double>(base + 250), static_cast<double>(group[2].as_int()), 15.0);
+        EXPECT_EQ(base, group[3].as_int());
+        EXPECT_EQ(10000, group[4].as_int());
+    };
+
+    TestTupleSource source{relation};
+    HashAggregation aggregation{source, {0}, aggr_funcs};
+    aggregation.open();
+    size_t group_count = 0;
+    while (aggregation.next()) {
+        std::vector<Register> group;
+        for (auto* reg : aggregation.get_output()) {
+            group.push_back(*reg);
+        }
+        check(group);
+        ++group_count;
+    }
+    aggregation.close();
+    EXPECT_EQ(4u, group_count);
+
+    // Aggregate both halves of the input separately and merge the states.
+    std::vector<std::tuple<int64_t, int64_t>> first_half(relation.begin(), relation.begin() + 15000);
+    std::vector<std::tuple<int64_t, int64_t>> second_half(relation.begin() + 15000, relation.end());
+    AggregationState merged{{0}, aggr_funcs};
+    AggregationState other{{0}, aggr_funcs};
+    TestTupleSource source_first{first_half};
+    TestTupleSource source_second{second_half};
+    merged.insert(source_first);
+    other.insert(source_second);
+    merged.merge(other);
+    ASSERT_EQ(4u, merged.get_group_count());
+    for (size_t i = 0; i < merged.get_group_count(); ++i) {
+        check(*merged.get_group(i));
+    }
+
+    EXPECT_FALSE(merged.is_invertible());
+    std::stringstream saved;
+    EXPECT_THROW(merged.save(saved), std::logic_error);
+}
+
+
+// NOLINTNEXTLINE
+TEST(IteratorModelTest, GroupJoin) {
+    // Keys occur several times on both sides, some only on one side.
+    std::vector<std::tuple<int64_t, int64_t>> relation_left;
+    std::vector<std::tuple<int64_t, int64_t, int64_t>> relation_right;
+    for (int64_t i = 0; i < 300; ++i) {
+        relation_left.emplace_back(i % 40, i);
+    }
+    for (int64_t i = 0; i < 1000; ++i) {
+        relation_right.emplace_back(i, (i * 7) % 50, i % 13);
+    }
+    std::vector<HashAggregation::AggrFunc> aggr_funcs{
+        HashAggregation::AggrFunc{HashAggregation::AggrFunc::COUNT, 0},
+        HashAggregation::AggrFunc{HashAggregation::AggrFunc::SUM, 1},
+        HashAggregation::AggrFunc{HashAggregation::AggrFunc::SUM, 4},
+        HashAggregation::AggrFunc{HashAggregation::AggrFunc::MIN, 1},
+        HashAggregation::AggrFunc{HashAggregation::AggrFunc::MAX, 2},
+    };
+
+    TestTupleSource source_left{relation_left};
+    TestTupleSource source_right{relation_right};
+    HashJoin join{source_left, source_right, 0, 1};
+    HashAggregation aggregation{join, {0}, aggr_funcs};
+    std::stringstream expected_output;
+    Print print_expected{aggregation, expected_output};
+    print_expected.open();
+    while (print_expected.next()) {}
+    print_expected.close();
+
+    TestTupleSource group_source_left{relation_left};
+    TestTupleSource group_source_right{relation_right};
+    GroupJoin group_join{group_source_left, group_source_right, 0, 1, aggr_funcs};
+    std::stringstream output;
+    Print print{group_join, output};
+    print.open();
+    while (print.next()) {}
+    print.close();
+    EXPECT_TRUE(group_source_left.closed);
+    EXPECT_TRUE(group_source_right.closed);
+
+    // Keys 40 to 49 of the right input have no join partner.
+    std::string result = output.str();
+    EXPECT_EQ(40, std::count(result.begin(), result.end(), '\n'));
+    EXPECT_EQ(sort_output(expected_output.str()), sort_output(result));
+}
+
+
+// NOLINTNEXTLINE
+TEST(IteratorModelTest, Schema) {
+    using Type = Register::Type;
+    TestTupleSource source_students{relation_students};
+    TestTupleSource source_grades{relation_grades};
+    Projection projection{source_students, {1, 0}};
+    HashJoin join{projection, source_grades, 1, 0};
+    HashAggregation aggregation{
+        join,
+        {0},
+        {
+            HashAggregation::AggrFunc{HashAggregation::AggrFunc::MAX, 3},
+            HashAggregation::AggrFunc{HashAggregation::AggrFunc::COUNT, 0},
+        }
+    };
+    Sort sort{aggregation, {Sort::Criterion{0, true}}};
+    std::stringstream output;
+    Print print{sort, output};
+
+    print.open();
+    EXPECT_EQ((std::vector<Type>{Type::CHAR16, Type::INT64}), projection.get_schema());
+    EXPECT_EQ(
+        (std::vector<Type>{Type::CHAR16, Type::INT64, Type::INT64, Type::INT64, Type::INT64}),
+        join.get_schema()
+    );
+    EXPECT_EQ((std::vector<Type>{Type::CHAR16, Type::INT64, Type::INT64}), aggregation.get_schema());
+    EXPECT_EQ(aggregation.get_schema(), sort.get_schema());
+    while (print.next()) {}
+    print.close();
+
+    auto expected_output = (
+        "Xenokrates      ,5041,2\n"
+        "Feuerbach       ,4630,1\n"s
+    );
+    EXPECT_EQ(expected_output, output.str());
+
+    // A state that does not know the types of its input has no schema.
+    AggregationState state{{}, {HashAggregation::AggrFunc{HashAggregation::AggrFunc::MIN, 0}}};
+    EXPECT_TRUE(state.get_schema().empty());
+}
+
+
+// NOLINTNEXTLINE
+TEST(IteratorModelTest, HashPropagation) {
+    TestTupleSource source_students{relation_students};
+    TestTupleSource source_grades{relation_grades};
+    TestTupleSource source_names{relation_students};
+    HashJoin join{source_students, source_grades, 0, 0};
+    Select select{join, Select::PredicateAttributeInt64{3, 5000, Select::PredicateType::GT}};
+    HashAggregation aggregation{select, {0}, {HashAggregation::AggrFunc{HashAggregation::AggrFunc::SUM, 4}}};
+    HashJoin lookup{aggregation, source_names, 0, 0};
+
+    // Every hash operator carries the hash of its key, which the next one
+    // reuses.
+    lookup.open();
+    EXPECT_EQ(std::vector<size_t>{0}, join.get_hash_attrs());
+    EXPECT_EQ(std::vector<size_t>{0}, select.get_hash_attrs());
+    EXPECT_EQ(std::vector<size_t>{0}, aggregation.get_hash_attrs());
+    EXPECT_EQ(std::vector<size_t>{0}, lookup.get_hash_attrs());
+    std::vector<std::vector<Register>> tuples;
+    while (lookup.next()) {
+        std::vector<Register> tuple;
+        for (auto* reg : lookup.get_output()) {
+            tuple.push_back(*reg);
+        }
+        EXPECT_EQ(hash_attributes(tuple, {0}), lookup.get_output_hash());
+        EXPECT_EQ(tuple[0].get_hash(), lookup.get_output_hash());
+        tuples.push_back(std::move(tuple));
+    }
+    lookup.close();
+    ASSERT_EQ(1U, tuples.size());
+    EXPECT_EQ(24002, tuples[0][0].as_int());
+    EXPECT_EQ(3, tuples[0][1].as_int());
+    EXPECT_EQ("Xenokrates      "s, tuples[0][3].as_string());
+
+    // Projections pass on hashes over several attributes as long as all of
+    // them are kept.
+    TestTupleSource source{relation_grades};
+    HashAggregation groups{source, {2, 0}, {HashAggregation::AggrFunc{HashAggregation::AggrFunc::COUNT, 0}}};
+    Projection swapped{groups, {2, 1, 0}};
+    swapped.open();
+    EXPECT_EQ((std::vector<size_t>{0, 1}), groups.get_hash_attrs());
+    EXPECT_EQ((std::vector<size_t>{2, 1}), swapped.get_hash_attrs());
+    size_t count = 0;
+    while (swapped.next()) {
+        std::vector<Register> tuple;
+        for (auto* reg : swapped.get_output()) {
+            tuple.push_back(*reg);
+        }
+        EXPECT_EQ(hash_attributes(tuple, {2, 1}), swapped.get_output_hash());
+        ++count;
+    }
+    swapped.close();
+    EXPECT_EQ(3U, count);
+
+    Projection dropped{groups, {0, 2}};
+    dropped.open();
+    EXPECT_TRUE(dropped.get_hash_attrs().empty());
+    dropped.close();
+}
+
+
+// NOLINTNEXTLINE
+TEST(IteratorModelTest, FixedWidthTypes) {
+    using Type = Register::Type;
+    std::vector<std::tuple<int32_t, double>> relation{
+        {1, 0.5}, {2, 2.25}, {1, 1.5}, {2, -1.0}, {3, 0.25}, {1, 4.0},
+    };
+    TestTupleSource source{relation};
+    Select select{source, Select::PredicateAttributeValue{1, Register::from_double(0.5), Select::PredicateType::GE}};
+    HashAggregation aggregation{
+        select,
+        {0},
+        {
+            HashAggregation::AggrFunc{HashAggregation::AggrFunc::SUM, 1},
+            HashAggregation::AggrFunc{HashAggregation::AggrFunc::MIN, 1},
+            HashAggregation::AggrFunc{HashAggregation::AggrFunc::SUM, 0},
+        }
+    };
+    Sort sort{aggregation, {Sort::Criterion{1, true}}};
+    std::stringstream output;
+    Print print{sort, output};
+
+    print.open();
+    EXPECT_EQ((std::vector<Type>{Type::INT32, Type::DOUBLE, Type::DOUBLE, Type::INT64}), aggregation.get_schema());
+    while (print.next()) {}
+    print.close();
+
+    auto expected_output = (
+        "1,6,0.5,3\n"
+        "2,2.25,2.25,2\n"s
+    );
+    EXPECT_EQ(expected_output, output.str());
+}
+
+
+// NOLINTNEXTLINE
+TEST(IteratorModelTest, CancellationToken) {
+    std::vector<std::tuple<int64_t>> relation;
+    for (int64_t i = 0; i < 5000; ++i) {
+        relation.emplace_back(i);
+    }
+    TestTupleSource source_left{relation};
+    TestTupleSource source_right{relation};
+    HashJoin join{source_left, source_right, 0, 0};
+    Sort sort{join, {{0, true}}};
+    CancellationToken token;
+    sort.set_cancellation_token(&token);
+
+    sort.open();
+    token.cancel();
+    EXPECT_THROW(sort.next(), QueryInterrupted);
+    sort.close();
+    EXPECT_TRUE(source_left.closed);
+    EXPECT_TRUE(source_right.closed);
+
+    CancellationToken expired_token;
+    expired_token.set_timeout(std::chrono::seconds(0));
+    EXPECT_TRUE(expired_token.is_expired());
+    EXPECT_FALSE(expired_token.is_cancelled());
+    EXPECT_THROW(expired_token.check(), QueryInterrupted);
+}
+
 // NOLINTNEXTLINE
 TEST(AdvancedIteratorModelTest, Union) {
     TestTupleSource source_left{relation_set_a};
@@ -661,4 +1539,40 @@ TEST(BonusIteratorModelTest, ExceptAll) {
     EXPECT_EQ(expected_output, sort_output(output.str()));
 }
 
+// NOLINTNEXTLINE
+TEST(BonusIteratorModelTest, SetOperationSchema) {
+    using Type = Register::Type;
+    TestTupleSource single_left{relation_set_a};
+    TestTupleSource single_right{relation_set_b};
+    Intersect single{single_left, single_right};
+    single.open();
+    EXPECT_EQ((std::vector<Type>{Type::INT64}), single.get_schema());
+    single.close();
+
+    // The set operations emit the attributes of wider tuples one by one, so
+    // they cannot report the schema of their inputs.
+    std::vector<std::tuple<int64_t, int64_t>> pairs{{1, 5}, {2, 6}};
+    TestTupleSource pairs_left{pairs};
+    TestTupleSource pairs_right{pairs};
+    UnionAll union_{pairs_left, pairs_right};
+    std::stringstream output;
+    Print print{union_, output};
+    print.open();
+    EXPECT_TRUE(union_.get_schema().empty());
+    while (print.next()) {}
+    print.close();
+
+    auto expected_output = (
+        "1\n"
+        "1\n"
+        "2\n"
+        "2\n"
+        "5\n"
+        "5\n"
+        "6\n"
+        "6\n"s
+    );
+    EXPECT_EQ(expected_output, sort_output(output.str()));
+}
+
 }  // namespace
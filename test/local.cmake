@@ -7,7 +7,16 @@
 # ---------------------------------------------------------------------------
 
 set(TEST_CC
+    test/execution_test.cc
+    test/german_string_test.cc
+    test/hash_test.cc
     test/iterator_model_test.cc
+    test/logical_plan_test.cc
+    test/plan_cache_test.cc
+    test/planner_test.cc
+    test/result_cache_test.cc
+    test/sample_test.cc
+    test/statistics_test.cc
 )
 
 # ---------------------------------------------------------------------------
@@ -0,0 +1,274 @@
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+#include <gtest/gtest.h>
+#include "moderndbs/algebra.h"
+#include "moderndbs/logical_plan.h"
+#include "moderndbs/planner.h"
+#include "moderndbs/statistics.h"
+#include "test_helpers.h"
+#include "test_tuple_source.h"
+
+
+namespace {
+
+using moderndbs::iterator_model::GroupJoin;
+using moderndbs::iterator_model::HashAggregation;
+using moderndbs::iterator_model::HashJoin;
+using moderndbs::iterator_model::LogicalAggregate;
+using moderndbs::iterator_model::LogicalNode;
+using moderndbs::iterator_model::LogicalNodePtr;
+using moderndbs::iterator_model::LogicalPlanBuilder;
+using moderndbs::iterator_model::LogicalSortCriterion;
+using moderndbs::iterator_model::PlannedOperator;
+using moderndbs::iterator_model::Planner;
+using moderndbs::iterator_model::Register;
+using moderndbs::iterator_model::Select;
+using moderndbs::iterator_model::TableStatistics;
+using moderndbs::test::TestTupleSource;
+using moderndbs::test::make_statistics;
+using moderndbs::test::run;
+
+
+class LogicalPlanTest : public ::testing::Test {
+protected:
+    std::vector<std::tuple<int64_t, std::string>> students{
+        {1, "Alice"}, {2, "Bob"}, {3, "Carol"}, {4, "Dave"},
+    };
+    std::vector<std::tuple<int64_t, std::string, int64_t>> grades{
+        {1, "Databases", 1}, {1, "Compilers", 3}, {2, "Databases", 2},
+        {3, "Databases", 1}, {4, "Compilers", 1}, {4, "Databases", 4},
+    };
+
+    /// Builds `SELECT name, course FROM students, grades WHERE
+    /// students.id = grades.id AND grade = 1 AND grades.id < 4`.
+    LogicalNodePtr build_join_query(LogicalPlanBuilder& builder, TestTupleSource<int64_t, std::string>& source_students,
+                                    TestTupleSource<int64_t, std::string, int64_t>& source_grades) {
+        auto scan_students = builder.scan(source_students, make_statistics(4, 2));
+        auto scan_grades = builder.scan(source_grades, make_statistics(6, 3));
+        auto student_id = scan_students->columns[0];
+        auto name = scan_students->columns[1];
+        auto grade_id = scan_grades->columns[0];
+        auto course = scan_grades->columns[1];
+        auto grade = scan_grades->columns[2];
+        auto join = builder.join(std::move(scan_students), std::move(scan_grades), student_id, grade_id);
+        auto select = builder.select(std::move(join), grade, Select::PredicateType::EQ, Register::from_int(1));
+        select = builder.select(std::move(select), grade_id, Select::PredicateType::LT, Register::from_int(4));
+        return builder.projection(std::move(select), {name, course});
+    }
+};
+
+
+// NOLINTNEXTLINE
+TEST_F(LogicalPlanTest, PushDownThroughJoin) {
+    std::string expected_output = "Alice,Databases\nCarol,Databases\n";
+
+    TestTupleSource source_students{students};
+    TestTupleSource source_grades{grades};
+    LogicalPlanBuilder builder;
+    Planner planner;
+    auto plan = build_join_query(builder, source_students, source_grades);
+    auto columns = plan->columns;
+    EXPECT_EQ(expected_output, run(*lower(*plan, planner).op));
+
+    TestTupleSource source_students_2{students};
+    TestTupleSource source_grades_2{grades};
+    auto optimized = optimize(build_join_query(builder, source_students_2, source_grades_2));
+    ASSERT_EQ(LogicalNode::Kind::PROJECTION, optimized->kind);
+    const auto& join = *optimized->inputs[0];
+    ASSERT_EQ(LogicalNode::Kind::JOIN, join.kind);
+
+    // Both predicates were merged into one selection below the join and the
+    // unused grade attribute is projected away before the join.
+    ASSERT_EQ(LogicalNode::Kind::PROJECTION, join.inputs[1]->kind);
+    EXPECT_EQ(2u, join.inputs[1]->columns.size());
+    const auto& select = *join.inputs[1]->inputs[0];
+    ASSERT_EQ(LogicalNode::Kind::SELECT, select.kind);
+    EXPECT_EQ(2u, select.predicates.size());
+    EXPECT_EQ(LogicalNode::Kind::SCAN, select.inputs[0]->kind);
+    EXPECT_EQ(LogicalNode::Kind::SCAN, join.inputs[0]->kind);
+
+    EXPECT_EQ(expected_output, run(*lower(*optimized, planner).op));
+}
+
+
+// NOLINTNEXTLINE
+TEST_F(LogicalPlanTest, IntersectToSemiJoin) {
+    std::vector<std::tuple<int64_t>> relation_left{{1}, {2}, {2}, {3}, {5}};
+    std::vector<std::tuple<int64_t>> relation_right{{2}, {3}, {3}, {4}};
+
+    for (auto set_operation : {Planner::SetOperation::INTERSECT, Planner::SetOperation::EXCEPT}) {
+        TestTupleSource source_left{relation_left};
+        TestTupleSource source_right{relation_right};
+        LogicalPlanBuilder builder;
+        Planner planner;
+        auto plan = builder.set_operation(
+            set_operation,
+            builder.scan(source_left, make_statistics(5, 1)),
+            builder.scan(source_right, make_statistics(4, 1)));
+        plan = optimize(std::move(plan));
+        ASSERT_EQ(LogicalNode::Kind::JOIN, plan->kind);
+        EXPECT_EQ(LogicalNode::Kind::AGGREGATION, plan->inputs[0]->kind);
+
+        PlannedOperator planned = lower(*plan, planner);
+        if (set_operation == Planner::SetOperation::INTERSECT) {
+            EXPECT_EQ(HashJoin::Type::SEMI, plan->join_type);
+            EXPECT_EQ("2\n3\n", run(*planned.op));
+        } else {
+            EXPECT_EQ(HashJoin::Type::ANTI, plan->join_type);
+            EXPECT_EQ("1\n5\n", run(*planned.op));
+        }
+    }
+}
+
+
+// NOLINTNEXTLINE
+TEST_F(LogicalPlanTest, SetOperationOfSeveralAttributes) {
+    TestTupleSource source_students{students};
+    TestTupleSource source_grades{grades};
+    LogicalPlanBuilder builder;
+    auto scan_grades = builder.scan(source_grades, make_statistics(6, 3));
+    auto grade_id = scan_grades->columns[0];
+    auto grade_ids = builder.projection(std::move(scan_grades), {grade_id});
+    auto scan_students = builder.scan(source_students, make_statistics(4, 2));
+    EXPECT_THROW(
+        builder.set_operation(Planner::SetOperation::UNION, std::move(scan_students), std::move(grade_ids)),
+        std::invalid_argument);
+}
+
+
+// NOLINTNEXTLINE
+TEST_F(LogicalPlanTest, RemoveRedundantSorts) {
+    TestTupleSource source_grades{grades};
+    LogicalPlanBuilder builder;
+    Planner planner;
+    auto scan = builder.scan(source_grades, make_statistics(6, 3));
+    auto course = scan->columns[1];
+    auto grade = scan->columns[2];
+    auto sorted = builder.sort(std::move(scan), {LogicalSortCriterion{grade, false}});
+    auto aggregation = builder.aggregation(
+        std::move(sorted), {course},
+        {LogicalAggregate{HashAggregation::AggrFunc::COUNT, grade, 0},
+         LogicalAggregate{HashAggregation::AggrFunc::SUM, grade, 0}});
+    auto sum = aggregation->columns[2];
+    auto plan = builder.sort(std::move(aggregation), {LogicalSortCriterion{course, true}});
+    plan = builder.projection(std::move(plan), {course, sum});
+
+    plan = optimize(std::move(plan));
+    ASSERT_EQ(LogicalNode::Kind::SORT, plan->kind);
+    const auto& optimized_aggregation = *plan->inputs[0];
+    ASSERT_EQ(LogicalNode::Kind::AGGREGATION, optimized_aggregation.kind);
+    // The unused count is removed, so no projection is needed on top.
+    EXPECT_EQ(1u, optimized_aggregation.aggregates.size());
+    EXPECT_NE(LogicalNode::Kind::SORT, optimized_aggregation.inputs[0]->kind);
+
+    EXPECT_EQ("Compilers,4\nDatabases,8\n", run(*lower(*plan, planner).op));
+}
+
+
+// NOLINTNEXTLINE
+TEST_F(LogicalPlanTest, GroupJoin) {
+    TestTupleSource source_students{students};
+    TestTupleSource source_grades{grades};
+    LogicalPlanBuilder builder;
+    Planner planner;
+    auto scan_students = builder.scan(source_students, make_statistics(4, 2));
+    auto scan_grades = builder.scan(source_grades, make_statistics(6, 3));
+    auto student_id = scan_students->columns[0];
+    auto grade_id = scan_grades->columns[0];
+    auto grade = scan_grades->columns[2];
+    auto join = builder.join(std::move(scan_students), std::move(scan_grades), student_id, grade_id);
+    auto plan = builder.aggregation(
+        std::move(join), {grade_id},
+        {LogicalAggregate{HashAggregation::AggrFunc::COUNT, grade, 0},
+         LogicalAggregate{HashAggregation::AggrFunc::MAX, grade, 0}});
+
+    PlannedOperator planned = lower(*plan, planner);
+    EXPECT_NE(nullptr, dynamic_cast<GroupJoin*>(planned.op));
+    EXPECT_EQ("1,2,3\n2,1,2\n3,1,1\n4,2,4\n", run(*planned.op));
+
+    // With the larger input on the left, the right input becomes the build
+    // side.
+    TestTupleSource swapped_students{students};
+    TestTupleSource swapped_grades{grades};
+    auto swapped_scan_students = builder.scan(swapped_students, make_statistics(4, 2));
+    auto swapped_scan_grades = builder.scan(swapped_grades, make_statistics(6, 3));
+    auto swapped_student_id = swapped_scan_students->columns[0];
+    auto swapped_grade_id = swapped_scan_grades->columns[0];
+    auto swapped_grade = swapped_scan_grades->columns[2];
+    auto swapped_join = builder.join(
+        std::move(swapped_scan_grades), std::move(swapped_scan_students), swapped_grade_id, swapped_student_id);
+    auto swapped_plan = builder.aggregation(
+        std::move(swapped_join), {swapped_student_id},
+        {LogicalAggregate{HashAggregation::AggrFunc::COUNT, swapped_grade, 0},
+         LogicalAggregate{HashAggregation::AggrFunc::MAX, swapped_grade, 0}});
+    PlannedOperator swapped = lower(*swapped_plan, planner);
+    EXPECT_NE(nullptr, dynamic_cast<GroupJoin*>(swapped.op));
+    EXPECT_EQ("1,2,3\n2,1,2\n3,1,1\n4,2,4\n", run(*swapped.op));
+}
+
+
+// NOLINTNEXTLINE
+TEST_F(LogicalPlanTest, JoinOrder) {
+    // `a` and `b` only join on two distinct values, the join with the small
+    // relation `c` should come first.
+    std::vector<std::tuple<int64_t, int64_t>> relation_a;
+    std::vector<std::tuple<int64_t, int64_t>> relation_b;
+    for (int64_t i = 0; i < 100; ++i) {
+        relation_a.emplace_back(i, i % 2);
+        relation_b.emplace_back(i % 2, i);
+    }
+    std::vector<std::tuple<int64_t>> relation_c{{3}, {4}};
+
+    auto build = [&](LogicalPlanBuilder& builder, auto& source_a, auto& source_b, auto& source_c) {
+        TableStatistics statistics_a = make_statistics(100, 2);
+        statistics_a.columns[1].distinct_count = 2;
+        TableStatistics statistics_b = make_statistics(100, 2);
+        statistics_b.columns[0].distinct_count = 2;
+        auto scan_a = builder.scan(source_a, statistics_a);
+        auto scan_b = builder.scan(source_b, statistics_b);
+        auto scan_c = builder.scan(source_c, make_statistics(2, 1));
+        auto a_id = scan_a->columns[0];
+        auto a_x = scan_a->columns[1];
+        auto b_x = scan_b->columns[0];
+        auto c_id = scan_c->columns[0];
+        auto join = builder.join(std::move(scan_a), std::move(scan_b), a_x, b_x);
+        return builder.join(std::move(join), std::move(scan_c), a_id, c_id);
+    };
+
+    TestTupleSource source_a{relation_a};
+    TestTupleSource source_b{relation_b};
+    TestTupleSource source_c{relation_c};
+    LogicalPlanBuilder builder;
+    Planner planner;
+    auto plan = build(builder, source_a, source_b, source_c);
+    PlannedOperator planned = lower(*plan, planner);
+
+    TestTupleSource source_a_2{relation_a};
+    TestTupleSource source_b_2{relation_b};
+    TestTupleSource source_c_2{relation_c};
+    auto optimized = optimize(build(builder, source_a_2, source_b_2, source_c_2));
+    PlannedOperator planned_optimized = lower(*optimized, planner);
+
+    // `b` is joined last.
+    const LogicalNode* join = optimized.get();
+    while (join->kind != LogicalNode::Kind::JOIN) {
+        join = join->inputs[0].get();
+    }
+    auto is_scan_b = [&](const LogicalNode* node) {
+        while (node->kind == LogicalNode::Kind::PROJECTION) {
+            node = node->inputs[0].get();
+        }
+        return node->kind == LogicalNode::Kind::SCAN && node->source == &source_b_2;
+    };
+    EXPECT_TRUE(is_scan_b(join->inputs[0].get()) || is_scan_b(join->inputs[1].get()));
+    EXPECT_LT(planned_optimized.cost * 10, planned.cost);
+    std::string output = run(*planned_optimized.op);
+    EXPECT_EQ(run(*planned.op), output);
+    EXPECT_EQ(100u, std::count(output.begin(), output.end(), '\n'));
+}
+
+}  // namespace
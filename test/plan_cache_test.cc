@@ -0,0 +1,122 @@
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include "moderndbs/algebra.h"
+#include "moderndbs/logical_plan.h"
+#include "moderndbs/plan_cache.h"
+#include "moderndbs/table.h"
+#include "test_helpers.h"
+
+
+namespace {
+
+using moderndbs::iterator_model::LogicalNodePtr;
+using moderndbs::iterator_model::LogicalPlanBuilder;
+using moderndbs::iterator_model::Operator;
+using moderndbs::iterator_model::PlanCache;
+using moderndbs::iterator_model::Register;
+using moderndbs::iterator_model::Select;
+using moderndbs::iterator_model::Table;
+using moderndbs::iterator_model::TableScan;
+using moderndbs::test::run;
+
+
+// NOLINTNEXTLINE
+TEST(PlanCacheTest, ParameterizedPlan) {
+    Table orders{2};
+    Table customers{2};
+    for (int64_t i = 0; i < 20; ++i) {
+        orders.insert({Register::from_int(i), Register::from_int(i % 4)});
+    }
+    for (int64_t i = 0; i < 4; ++i) {
+        customers.insert({Register::from_int(i), Register::from_int(i * 100)});
+    }
+    orders.analyze();
+    customers.analyze();
+    TableScan scan_orders{orders};
+    TableScan scan_customers{customers};
+
+    // SELECT order, region FROM orders, customers WHERE customer = id AND
+    // order >= ? AND region = ?
+    auto build = [&] {
+        LogicalPlanBuilder builder;
+        auto left = builder.scan(scan_orders, orders.get_statistics());
+        auto right = builder.scan(scan_customers, customers.get_statistics());
+        auto order = left->columns[0];
+        auto customer = left->columns[1];
+        auto id = right->columns[0];
+        auto region = right->columns[1];
+        auto plan = builder.join(std::move(left), std::move(right), customer, id);
+        plan = builder.select_parameter(std::move(plan), order, Select::PredicateType::GE, 0);
+        plan = builder.select_parameter(std::move(plan), region, Select::PredicateType::EQ, 1);
+        return builder.projection(std::move(plan), {order, region});
+    };
+
+    PlanCache cache;
+    auto prepared = cache.prepare(build());
+    EXPECT_EQ(2u, prepared->get_parameter_count());
+    EXPECT_EQ(1u, cache.get_miss_count());
+    EXPECT_EQ("13,100\n17,100\n", run(prepared->execute({Register::from_int(10), Register::from_int(100)}).get_root()));
+    EXPECT_EQ("10,200\n14,200\n18,200\n", run(prepared->execute({Register::from_int(10), Register::from_int(200)}).get_root()));
+
+    // The same query with other parameters reuses the plan.
+    auto cached = cache.prepare(build());
+    EXPECT_EQ(prepared, cached);
+    EXPECT_EQ(1u, cache.get_hit_count());
+    EXPECT_EQ(1u, cache.size());
+    EXPECT_EQ("19,300\n", run(cached->execute({Register::from_int(16), Register::from_int(300)}).get_root()));
+
+    cache.clear();
+    EXPECT_EQ(0u, cache.size());
+}
+
+
+// NOLINTNEXTLINE
+TEST(PlanCacheTest, ConcurrentExecutions) {
+    Table values{2};
+    for (int64_t i = 0; i < 100; ++i) {
+        values.insert({Register::from_int(100 + i), Register::from_int(i % 10)});
+    }
+    values.analyze();
+    TableScan scan{values};
+    auto build = [&] {
+        LogicalPlanBuilder builder;
+        auto plan = builder.scan(scan, values.get_statistics());
+        auto value = plan->columns[0];
+        auto group = plan->columns[1];
+        plan = builder.select_parameter(std::move(plan), group, Select::PredicateType::EQ, 0);
+        return builder.projection(std::move(plan), {value});
+    };
+
+    // Every thread runs the query with its own parameter. The threads share
+    // one prepared plan and its scan.
+    PlanCache cache;
+    std::vector<std::string> outputs(4);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < outputs.size(); ++t) {
+        threads.emplace_back([&, t] {
+            for (size_t repetition = 0; repetition < 20; ++repetition) {
+                auto prepared = cache.prepare(build());
+                outputs[t] = run(prepared->execute({Register::from_int(static_cast<int64_t>(t))}).get_root());
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (size_t t = 0; t < outputs.size(); ++t) {
+        std::string expected;
+        for (int64_t i = 0; i < 100; ++i) {
+            if (i % 10 == static_cast<int64_t>(t)) {
+                expected += std::to_string(100 + i) + "\n";
+            }
+        }
+        EXPECT_EQ(expected, outputs[t]);
+    }
+    EXPECT_EQ(80u, cache.get_hit_count() + cache.get_miss_count());
+    EXPECT_EQ(1u, cache.size());
+}
+
+}  // namespace
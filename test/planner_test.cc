@@ -0,0 +1,128 @@
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <tuple>
+#include <vector>
+#include <gtest/gtest.h>
+#include "moderndbs/algebra.h"
+#include "moderndbs/planner.h"
+#include "moderndbs/statistics.h"
+#include "moderndbs/table.h"
+#include "test_helpers.h"
+#include "test_tuple_source.h"
+
+
+namespace {
+
+using moderndbs::iterator_model::ColumnStatistics;
+using moderndbs::iterator_model::HashJoin;
+using moderndbs::iterator_model::PlannedOperator;
+using moderndbs::iterator_model::Planner;
+using moderndbs::iterator_model::Projection;
+using moderndbs::iterator_model::Register;
+using moderndbs::iterator_model::Select;
+using moderndbs::iterator_model::Table;
+using moderndbs::iterator_model::TableScan;
+using moderndbs::test::TestTupleSource;
+using moderndbs::test::make_statistics;
+using moderndbs::test::run;
+
+
+// NOLINTNEXTLINE
+TEST(PlannerTest, HistogramSelectivity) {
+    ColumnStatistics column;
+    column.distinct_count = 40;
+    column.min = Register::from_int(0);
+    column.max = Register::from_int(40);
+    for (int64_t bound : {10, 20, 30, 40}) {
+        column.histogram_bounds.push_back(Register::from_int(bound));
+    }
+
+    EXPECT_DOUBLE_EQ(0.0, column.estimate_fraction_below(Register::from_int(-5)));
+    EXPECT_DOUBLE_EQ(0.375, column.estimate_fraction_below(Register::from_int(15)));
+    EXPECT_DOUBLE_EQ(0.5, column.estimate_fraction_below(Register::from_int(20)));
+    EXPECT_DOUBLE_EQ(1.0, column.estimate_fraction_below(Register::from_int(50)));
+    EXPECT_DOUBLE_EQ(0.025, column.estimate_selectivity(Select::PredicateType::EQ, Register::from_int(7)));
+    EXPECT_DOUBLE_EQ(0.0, column.estimate_selectivity(Select::PredicateType::EQ, Register::from_int(41)));
+    EXPECT_DOUBLE_EQ(0.625, column.estimate_selectivity(Select::PredicateType::GE, Register::from_int(15)));
+}
+
+
+// NOLINTNEXTLINE
+TEST(PlannerTest, JoinBuildSide) {
+    std::vector<std::tuple<int64_t, int64_t>> relation_large;
+    for (int64_t i = 0; i < 1000; ++i) {
+        relation_large.emplace_back(i % 10, i);
+    }
+    std::vector<std::tuple<int64_t>> relation_small{{3}, {7}};
+
+    std::string expected_output;
+    {
+        TestTupleSource source_large{relation_large};
+        TestTupleSource source_small{relation_small};
+        HashJoin join{source_large, source_small, 0, 0};
+        expected_output = run(join);
+    }
+
+    TestTupleSource source_large{relation_large};
+    TestTupleSource source_small{relation_small};
+    Planner planner;
+    auto large = planner.scan(source_large, make_statistics(1000, 2));
+    auto small = planner.scan(source_small, make_statistics(2, 1));
+    large.statistics.columns[0].distinct_count = 10;
+
+    // The small right input becomes the build side.
+    PlannedOperator planned = planner.join(large, small, 0, 0);
+    EXPECT_NE(nullptr, dynamic_cast<Projection*>(planned.op));
+    EXPECT_EQ(200u, planned.statistics.row_count);
+    ASSERT_EQ(3u, planned.statistics.columns.size());
+    EXPECT_EQ(expected_output, run(*planned.op));
+
+    // The small left input stays the build side.
+    TestTupleSource source_large_2{relation_large};
+    TestTupleSource source_small_2{relation_small};
+    auto large_2 = planner.scan(source_large_2, make_statistics(1000, 2));
+    auto small_2 = planner.scan(source_small_2, make_statistics(2, 1));
+    PlannedOperator planned_2 = planner.join(small_2, large_2, 0, 0);
+    EXPECT_NE(nullptr, dynamic_cast<HashJoin*>(planned_2.op));
+}
+
+
+// NOLINTNEXTLINE
+TEST(PlannerTest, SelectOnNarrowerTypes) {
+    using Type = Register::Type;
+    for (auto type : {Type::INT32, Type::DATE, Type::DECIMAL, Type::DOUBLE}) {
+        Table table{1};
+        for (int32_t i = 0; i < 1000; ++i) {
+            switch (type) {
+                case Type::DECIMAL:
+                    table.insert({Register::from_decimal(i * 100)});
+                    break;
+                case Type::DOUBLE:
+                    table.insert({Register::from_double(i)});
+                    break;
+                default:
+                    table.insert({Register::from_integer(type, i)});
+                    break;
+            }
+        }
+        table.analyze();
+        TableScan scan{table};
+        Planner planner;
+        auto input = planner.scan(scan, table.get_statistics());
+
+        // The INT64 constant is compared with the bounds as a value of the
+        // type of the attribute.
+        PlannedOperator planned = planner.select(input, Select::PredicateAttributeInt64{0, 250, Select::PredicateType::LT});
+        EXPECT_NEAR(250.0, static_cast<double>(planned.statistics.row_count), 25.0);
+        ASSERT_TRUE(planned.statistics.columns[0].max);
+        EXPECT_EQ(type, planned.statistics.columns[0].max->get_type());
+        std::string output = run(*planned.op);
+        EXPECT_EQ(250, std::count(output.begin(), output.end(), '\n'));
+
+        PlannedOperator equal = planner.select(input, Select::PredicateAttributeInt64{0, 2000, Select::PredicateType::EQ});
+        EXPECT_EQ(0u, equal.statistics.row_count);
+    }
+}
+
+}  // namespace
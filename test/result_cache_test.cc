@@ -0,0 +1,148 @@
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include <gtest/gtest.h>
+#include "moderndbs/algebra.h"
+#include "moderndbs/logical_plan.h"
+#include "moderndbs/planner.h"
+#include "moderndbs/result_cache.h"
+#include "moderndbs/table.h"
+
+
+namespace {
+
+using moderndbs::iterator_model::CompactResult;
+using moderndbs::iterator_model::HashAggregation;
+using moderndbs::iterator_model::LogicalAggregate;
+using moderndbs::iterator_model::LogicalNodePtr;
+using moderndbs::iterator_model::LogicalPlanBuilder;
+using moderndbs::iterator_model::Planner;
+using moderndbs::iterator_model::Register;
+using moderndbs::iterator_model::ResultCache;
+using moderndbs::iterator_model::ResultScan;
+using moderndbs::iterator_model::Select;
+using moderndbs::iterator_model::Table;
+using moderndbs::iterator_model::TableScan;
+
+
+/// Builds `SELECT category, SUM(value) FROM table WHERE value >= minimum
+/// GROUP BY category`.
+LogicalNodePtr build_query(TableScan& scan, const Table& table, int64_t minimum) {
+    LogicalPlanBuilder builder;
+    auto plan = builder.scan(scan, table.get_statistics());
+    auto category = plan->columns[0];
+    auto value = plan->columns[1];
+    plan = builder.select(std::move(plan), value, Select::PredicateType::GE, Register::from_int(minimum));
+    return builder.aggregation(
+        std::move(plan), {category}, {LogicalAggregate{HashAggregation::AggrFunc::SUM, value, 0}});
+}
+
+
+/// Returns the sum of the second attribute of all tuples.
+int64_t sum_values(const std::shared_ptr<const CompactResult>& result) {
+    int64_t sum = 0;
+    ResultScan scan{result};
+    scan.open();
+    while (scan.next()) {
+        sum += scan.get_output()[1]->as_int();
+    }
+    scan.close();
+    return sum;
+}
+
+
+// NOLINTNEXTLINE
+TEST(ResultCacheTest, InvalidateOnChange) {
+    Table table{2};
+    for (int64_t i = 0; i < 100; ++i) {
+        table.insert({Register::from_string("category" + std::to_string(i % 3)), Register::from_int(i)});
+    }
+    TableScan scan{table};
+    ResultCache cache{1 << 20};
+
+    auto plan = build_query(scan, table, 0);
+    Planner planner;
+    auto& root = *lower(*plan, planner).op;
+    auto result = cache.execute(*plan, root);
+    EXPECT_EQ(3u, result->get_row_count());
+    EXPECT_EQ(4950, sum_values(result));
+    EXPECT_EQ(result, cache.execute(*plan, root));
+    EXPECT_EQ(1u, cache.get_hit_count());
+    EXPECT_EQ(1u, cache.get_miss_count());
+
+    // A modification of the table invalidates the result.
+    table.insert({Register::from_string("category0"), Register::from_int(50)});
+    auto updated = cache.execute(*plan, root);
+    EXPECT_NE(result, updated);
+    EXPECT_EQ(5000, sum_values(updated));
+    EXPECT_EQ(2u, cache.get_miss_count());
+    EXPECT_EQ(1u, cache.size());
+
+    cache.invalidate(table);
+    EXPECT_EQ(0u, cache.size());
+    EXPECT_EQ(0u, cache.get_used_bytes());
+}
+
+
+// NOLINTNEXTLINE
+TEST(ResultCacheTest, ReusedAddresses) {
+    // The tables and scans of both rounds live at the same addresses and have
+    // the same number of tuples, but different values.
+    std::aligned_storage_t<sizeof(Table), alignof(Table)> table_storage;
+    std::aligned_storage_t<sizeof(TableScan), alignof(TableScan)> scan_storage;
+    ResultCache cache{1 << 20};
+    std::vector<int64_t> sums;
+    for (int64_t round = 0; round < 2; ++round) {
+        auto* table = new (&table_storage) Table{2};
+        for (int64_t i = 0; i < 10; ++i) {
+            table->insert({Register::from_string("category0"), Register::from_int(round * 100 + i)});
+        }
+        auto* scan = new (&scan_storage) TableScan{*table};
+        auto plan = build_query(*scan, *table, 0);
+        Planner planner;
+        sums.push_back(sum_values(cache.execute(*plan, *lower(*plan, planner).op)));
+        scan->~TableScan();
+        table->~Table();
+    }
+    EXPECT_EQ((std::vector<int64_t>{45, 1045}), sums);
+    EXPECT_EQ(2u, cache.get_miss_count());
+}
+
+
+// NOLINTNEXTLINE
+TEST(ResultCacheTest, LeastRecentlyUsedEviction) {
+    Table table{2};
+    for (int64_t i = 0; i < 100; ++i) {
+        table.insert({Register::from_int(i % 10), Register::from_int(i)});
+    }
+    TableScan scan{table};
+    Planner planner;
+    std::vector<LogicalNodePtr> plans;
+    std::vector<moderndbs::iterator_model::Operator*> roots;
+    for (int64_t minimum : {0, 10, 20}) {
+        plans.push_back(build_query(scan, table, minimum));
+        roots.push_back(lower(*plans.back(), planner).op);
+    }
+
+    // The budget fits two of the results.
+    ResultCache sizing{1 << 20};
+    size_t result_size = sizing.execute(*plans[0], *roots[0])->get_size_in_bytes();
+    ResultCache cache{2 * (result_size + 200)};
+
+    auto first = cache.execute(*plans[0], *roots[0]);
+    cache.execute(*plans[1], *roots[1]);
+    EXPECT_EQ(first, cache.execute(*plans[0], *roots[0]));
+    cache.execute(*plans[2], *roots[2]);
+    EXPECT_EQ(2u, cache.size());
+    EXPECT_LE(cache.get_used_bytes(), 2 * (result_size + 200));
+
+    // The second result was used least recently and was evicted.
+    EXPECT_EQ(first, cache.execute(*plans[0], *roots[0]));
+    size_t misses = cache.get_miss_count();
+    cache.execute(*plans[1], *roots[1]);
+    EXPECT_EQ(misses + 1, cache.get_miss_count());
+}
+
+}  // namespace
@@ -0,0 +1,116 @@
+#include <algorithm>
+#include <cstdint>
+#include <set>
+#include <vector>
+#include <gtest/gtest.h>
+#include "moderndbs/algebra.h"
+#include "moderndbs/sample.h"
+#include "moderndbs/table.h"
+
+
+namespace {
+
+using moderndbs::iterator_model::BlockSampleScan;
+using moderndbs::iterator_model::Operator;
+using moderndbs::iterator_model::Register;
+using moderndbs::iterator_model::Sample;
+using moderndbs::iterator_model::Table;
+using moderndbs::iterator_model::TableScan;
+
+
+/// Creates a table with the tuples (0), (1), ..., (row_count - 1).
+Table make_table(int64_t row_count) {
+    Table table{1};
+    for (int64_t i = 0; i < row_count; ++i) {
+        table.insert({Register::from_int(i)});
+    }
+    return table;
+}
+
+
+/// Returns the values of the first attribute of all tuples of `op`.
+std::vector<int64_t> run(Operator& op) {
+    std::vector<int64_t> values;
+    op.open();
+    while (op.next()) {
+        values.push_back(op.get_output()[0]->as_int());
+    }
+    op.close();
+    return values;
+}
+
+
+// NOLINTNEXTLINE
+TEST(SampleTest, Bernoulli) {
+    Table table = make_table(100000);
+    TableScan scan{table};
+    Sample sample{scan, Sample::Bernoulli{0.01}, 42};
+
+    auto values = run(sample);
+    EXPECT_GT(values.size(), 800u);
+    EXPECT_LT(values.size(), 1200u);
+    EXPECT_TRUE(std::is_sorted(values.begin(), values.end()));
+    EXPECT_EQ(values, run(sample));
+
+    TableScan other_scan{table};
+    Sample other_sample{other_scan, Sample::Bernoulli{0.01}, 43};
+    EXPECT_NE(values, run(other_sample));
+
+    TableScan full_scan{table};
+    Sample full_sample{full_scan, Sample::Bernoulli{1.0}};
+    EXPECT_EQ(100000u, run(full_sample).size());
+}
+
+
+// NOLINTNEXTLINE
+TEST(SampleTest, Reservoir) {
+    Table table = make_table(10000);
+    TableScan scan{table};
+    Sample sample{scan, Sample::Reservoir{100}, 7};
+
+    auto values = run(sample);
+    ASSERT_EQ(100u, values.size());
+    std::set<int64_t> distinct(values.begin(), values.end());
+    EXPECT_EQ(100u, distinct.size());
+    EXPECT_LT(*distinct.rbegin(), 10000);
+    // A uniform sample of 100 out of 10000 values contains large values.
+    EXPECT_GT(*distinct.rbegin(), 5000);
+    EXPECT_EQ(values, run(sample));
+
+    Table small_table = make_table(10);
+    TableScan small_scan{small_table};
+    Sample small_sample{small_scan, Sample::Reservoir{100}, 7};
+    auto small_values = run(small_sample);
+    std::sort(small_values.begin(), small_values.end());
+    EXPECT_EQ((std::vector<int64_t>{0, 1, 2, 3, 4, 5, 6, 7, 8, 9}), small_values);
+}
+
+
+// NOLINTNEXTLINE
+TEST(SampleTest, BlockSampleScan) {
+    Table table = make_table(100050);
+    BlockSampleScan scan{table, 0.1, 3, 100};
+
+    auto values = run(scan);
+    EXPECT_GT(values.size(), 8000u);
+    EXPECT_LT(values.size(), 12000u);
+    EXPECT_EQ(values, run(scan));
+    // Blocks are taken as a whole.
+    for (size_t i = 0; i < values.size(); ++i) {
+        if (values[i] % 100 != 0 && values[i] != 0) {
+            ASSERT_GT(i, 0u);
+            EXPECT_EQ(values[i - 1] + 1, values[i]);
+        }
+        if (values[i] % 100 != 99 && values[i] != 100049) {
+            ASSERT_LT(i + 1, values.size());
+            EXPECT_EQ(values[i] + 1, values[i + 1]);
+        }
+    }
+
+    BlockSampleScan full_scan{table, 1.0, 3, 100};
+    EXPECT_EQ(100050u, run(full_scan).size());
+    BlockSampleScan empty_scan{table, 0.0, 3, 100};
+    EXPECT_TRUE(run(empty_scan).empty());
+}
+
+}  // namespace
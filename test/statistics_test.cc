@@ -0,0 +1,157 @@
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include "moderndbs/algebra.h"
+#include "moderndbs/sketch.h"
+#include "moderndbs/statistics.h"
+#include "moderndbs/table.h"
+
+
+namespace {
+
+using moderndbs::iterator_model::HyperLogLog;
+using moderndbs::iterator_model::KllSketch;
+using moderndbs::iterator_model::Register;
+using moderndbs::iterator_model::ReservoirSample;
+using moderndbs::iterator_model::SpaceSaving;
+using moderndbs::iterator_model::Table;
+using moderndbs::iterator_model::TableScan;
+using moderndbs::iterator_model::TableStatistics;
+
+
+/// A simple 64 bit hash function for the tests (splitmix64).
+uint64_t hash(uint64_t value) {
+    value += 0x9e3779b97f4a7c15ULL;
+    value = (value ^ (value >> 30U)) * 0xbf58476d1ce4e5b9ULL;
+    value = (value ^ (value >> 27U)) * 0x94d049bb133111ebULL;
+    return value ^ (value >> 31U);
+}
+
+
+// NOLINTNEXTLINE
+TEST(StatisticsTest, HyperLogLog) {
+    HyperLogLog small;
+    for (uint64_t i = 0; i < 100; ++i) {
+        small.add(hash(i % 10));
+    }
+    EXPECT_EQ(10u, small.estimate());
+
+    HyperLogLog left;
+    HyperLogLog right;
+    for (uint64_t i = 0; i < 60000; ++i) {
+        left.add(hash(i));
+        right.add(hash(i + 40000));
+    }
+    left.merge(right);
+    EXPECT_NEAR(100000.0, static_cast<double>(left.estimate()), 5000.0);
+}
+
+
+// NOLINTNEXTLINE
+TEST(StatisticsTest, ReservoirSample) {
+    ReservoirSample left{1000, 1};
+    ReservoirSample right{1000, 2};
+    for (int64_t i = 0; i < 10000; ++i) {
+        left.add(Register::from_int(i));
+    }
+    for (int64_t i = 10000; i < 100000; ++i) {
+        right.add(Register::from_int(i));
+    }
+    EXPECT_EQ(10000u, left.get_count());
+    ASSERT_EQ(1000u, left.get_values().size());
+    int64_t sum = 0;
+    for (auto& value : left.get_values()) {
+        sum += value.as_int();
+    }
+    EXPECT_NEAR(5000.0, static_cast<double>(sum) / 1000.0, 500.0);
+
+    // A tenth of the merged values stands for the left part of the stream.
+    left.merge(right);
+    EXPECT_EQ(100000u, left.get_count());
+    ASSERT_EQ(1000u, left.get_values().size());
+    auto from_left = std::count_if(left.get_values().begin(), left.get_values().end(), [](const Register& value) {
+        return value.as_int() < 10000;
+    });
+    EXPECT_NEAR(100.0, static_cast<double>(from_left), 40.0);
+}
+
+
+// NOLINTNEXTLINE
+TEST(StatisticsTest, SpaceSaving) {
+    // Value 0 occurs in a fifth of the stream, value 1 in a tenth, and all
+    // others once.
+    SpaceSaving left{32};
+    SpaceSaving right{32};
+    for (int64_t i = 0; i < 20000; ++i) {
+        auto& sketch = i < 10000 ? left : right;
+        int64_t value = i % 5 == 0 ? 0 : i % 10 == 1 ? 1 : i + 2;
+        sketch.add(Register::from_int(value));
+    }
+    left.merge(right);
+    auto top = left.get_top(2);
+    ASSERT_EQ(2u, top.size());
+    EXPECT_EQ(0, top[0].value.as_int());
+    EXPECT_EQ(1, top[1].value.as_int());
+    EXPECT_GE(top[0].count, 4000u);
+    EXPECT_LE(top[0].count - top[0].error, 4000u);
+}
+
+
+// NOLINTNEXTLINE
+TEST(StatisticsTest, KllSketch) {
+    KllSketch left{200, 1};
+    KllSketch right{200, 2};
+    for (int64_t i = 0; i < 100000; ++i) {
+        // Interleave the values so that both parts cover the whole range.
+        int64_t value = (i * 7919) % 100000;
+        (i % 3 == 0 ? left : right).add(value);
+    }
+    left.merge(right);
+    EXPECT_EQ(100000u, left.get_count());
+    EXPECT_NEAR(50000.0, static_cast<double>(left.get_quantile(0.5)), 2000.0);
+    EXPECT_NEAR(90000.0, static_cast<double>(left.get_quantile(0.9)), 2000.0);
+    EXPECT_NEAR(0.0, static_cast<double>(left.get_quantile(0.0)), 2000.0);
+    EXPECT_NEAR(99999.0, static_cast<double>(left.get_quantile(1.0)), 2000.0);
+}
+
+
+// NOLINTNEXTLINE
+TEST(StatisticsTest, AnalyzeTable) {
+    Table table{2};
+    for (int64_t i = 0; i < 100000; ++i) {
+        std::string name = "name" + std::to_string(i % 500);
+        name.resize(16, ' ');
+        table.insert({Register::from_int(i), Register::from_string(name)});
+    }
+    EXPECT_EQ(100000u, table.get_statistics().row_count);
+    EXPECT_EQ(0u, table.get_statistics().columns[0].distinct_count);
+
+    table.analyze(4);
+    TableStatistics statistics = table.get_statistics();
+    EXPECT_EQ(100000u, statistics.row_count);
+    ASSERT_EQ(2u, statistics.columns.size());
+    ASSERT_EQ(2u, table.get_synopses().size());
+
+    auto& id = statistics.columns[0];
+    EXPECT_NEAR(100000.0, static_cast<double>(id.distinct_count), 5000.0);
+    EXPECT_EQ(Register::from_int(0), *id.min);
+    EXPECT_EQ(Register::from_int(99999), *id.max);
+    ASSERT_EQ(100u, id.histogram_bounds.size());
+    EXPECT_TRUE(std::is_sorted(id.histogram_bounds.begin(), id.histogram_bounds.end()));
+    EXPECT_EQ(Register::from_int(99999), id.histogram_bounds.back());
+    EXPECT_NEAR(0.25, id.estimate_fraction_below(Register::from_int(25000)), 0.05);
+
+    auto& name = statistics.columns[1];
+    EXPECT_NEAR(500.0, static_cast<double>(name.distinct_count), 25.0);
+
+    // Any operator output can be analyzed as well.
+    TableScan scan{table};
+    TableStatistics scanned = analyze(scan);
+    EXPECT_EQ(100000u, scanned.row_count);
+    EXPECT_EQ(*id.max, *scanned.columns[0].max);
+    EXPECT_NEAR(500.0, static_cast<double>(scanned.columns[1].distinct_count), 25.0);
+}
+
+}  // namespace
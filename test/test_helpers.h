@@ -0,0 +1,51 @@
+#ifndef TEST_TEST_HELPERS_H
+#define TEST_TEST_HELPERS_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "moderndbs/algebra.h"
+#include "moderndbs/statistics.h"
+
+
+namespace moderndbs {
+namespace test {
+
+/// Runs the operator tree and returns its printed output with sorted lines.
+inline std::string run(moderndbs::iterator_model::Operator& op) {
+    std::stringstream output;
+    moderndbs::iterator_model::Print print{op, output};
+    print.open();
+    while (print.next()) {}
+    print.close();
+
+    std::vector<std::string> lines;
+    std::string line;
+    while (std::getline(output, line)) {
+        lines.push_back(line);
+    }
+    std::sort(lines.begin(), lines.end());
+    std::string sorted;
+    for (auto& sorted_line : lines) {
+        sorted += sorted_line + "\n";
+    }
+    return sorted;
+}
+
+
+/// Returns statistics of `row_count` rows whose first attribute is unique.
+inline moderndbs::iterator_model::TableStatistics make_statistics(uint64_t row_count, size_t arity) {
+    moderndbs::iterator_model::TableStatistics statistics;
+    statistics.row_count = row_count;
+    statistics.columns.resize(arity);
+    statistics.columns[0].distinct_count = row_count;
+    return statistics;
+}
+
+}  // namespace test
+}  // namespace moderndbs
+
+#endif
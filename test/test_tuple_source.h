@@ -0,0 +1,102 @@
+#ifndef TEST_TEST_TUPLE_SOURCE_H
+#define TEST_TEST_TUPLE_SOURCE_H
+
+#include <cstdint>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include "moderndbs/algebra.h"
+
+
+namespace moderndbs {
+namespace test {
+
+using moderndbs::iterator_model::Register;
+
+
+inline Register convert_to_register(int64_t value) {
+    return Register::from_int(value);
+}
+
+
+inline Register convert_to_register(int32_t value) {
+    return Register::from_int32(value);
+}
+
+
+inline Register convert_to_register(double value) {
+    return Register::from_double(value);
+}
+
+
+inline Register convert_to_register(const std::string& value) {
+    return Register::from_string(value);
+}
+
+
+template <typename... Ts, size_t... Is>
+void write_to_registers_impl(
+    std::vector<Register>& registers,
+    const std::tuple<Ts...>& tuple,
+    std::index_sequence<Is...>
+) {
+    ((registers[Is] = convert_to_register(std::get<Is>(tuple))),...);
+}
+
+
+template <typename... Ts>
+void write_to_registers(std::vector<Register>& registers, const std::tuple<Ts...>& tuple) {
+    write_to_registers_impl(registers, tuple, std::index_sequence_for<Ts...>{});
+}
+
+
+template <typename... Ts>
+class TestTupleSource
+: public iterator_model::Operator {
+private:
+    const std::vector<std::tuple<Ts...>>& tuples;
+    size_t current_index = 0;
+    std::vector<Register> output_regs;
+
+public:
+    bool opened = false;
+    bool closed = false;
+
+    explicit TestTupleSource(const std::vector<std::tuple<Ts...>>& tuples) : tuples(tuples) {}
+
+    void open() override {
+        output_regs.resize(sizeof...(Ts));
+        schema = {convert_to_register(Ts{}).get_type()...};
+        opened = true;
+    }
+
+    bool next() override {
+        if (current_index < tuples.size()) {
+            write_to_registers(output_regs, tuples[current_index]);
+            ++current_index;
+            return true;
+        } else {
+            return false;
+        }
+    }
+
+    void close() override {
+        output_regs.clear();
+        closed = true;
+    }
+
+    std::vector<Register*> get_output() override {
+        std::vector<Register*> output;
+        output.reserve(sizeof...(Ts));
+        for (auto& reg : output_regs) {
+            output.push_back(&reg);
+        }
+        return output;
+    }
+};
+
+}  // namespace test
+}  // namespace moderndbs
+
+#endif